@@ -0,0 +1,113 @@
+#include "cjson_arena.h"
+#include "cJSON.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "sdkconfig.h"
+#include <inttypes.h>
+#include <stdlib.h>
+
+static const char *TAG = "CJSON_ARENA";
+
+#define CJSON_ARENA_ALIGN 8
+
+#if CONFIG_SCREEN_CJSON_ARENA_SIZE > 0
+
+#if !CONFIG_SCREEN_CJSON_ARENA_PSRAM
+static uint8_t arena_storage[CONFIG_SCREEN_CJSON_ARENA_SIZE]
+    __attribute__((aligned(CJSON_ARENA_ALIGN)));
+#endif
+
+static uint8_t *arena = NULL;
+static size_t arena_used = 0;
+static size_t arena_high_water = 0;
+static uint32_t arena_overflows = 0;
+static uint32_t overflows_logged = 0;
+static volatile TaskHandle_t arena_owner = NULL;
+
+static void *cjson_arena_malloc(size_t size) {
+  if (arena_owner != NULL && arena_owner == xTaskGetCurrentTaskHandle()) {
+    size_t start = (arena_used + CJSON_ARENA_ALIGN - 1) &
+                   ~(size_t)(CJSON_ARENA_ALIGN - 1);
+    if (start + size <= CONFIG_SCREEN_CJSON_ARENA_SIZE) {
+      arena_used = start + size;
+      return arena + start;
+    }
+    arena_overflows++;
+  }
+  return malloc(size);
+}
+
+static void cjson_arena_free(void *ptr) {
+  uint8_t *p = ptr;
+  if (p >= arena && p < arena + CONFIG_SCREEN_CJSON_ARENA_SIZE) {
+    return; // given back by cjson_arena_end()
+  }
+  free(ptr);
+}
+
+void cjson_arena_init(void) {
+#if CONFIG_SCREEN_CJSON_ARENA_PSRAM
+  arena = heap_caps_malloc(CONFIG_SCREEN_CJSON_ARENA_SIZE,
+                           MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+  if (!arena) {
+    ESP_LOGE(TAG, "No PSRAM for the arena, cJSON uses the heap");
+    return;
+  }
+#else
+  arena = arena_storage;
+#endif
+
+  cJSON_Hooks hooks = {
+      .malloc_fn = cjson_arena_malloc,
+      .free_fn = cjson_arena_free,
+  };
+  cJSON_InitHooks(&hooks);
+  ESP_LOGI(TAG, "%d bytes", CONFIG_SCREEN_CJSON_ARENA_SIZE);
+}
+
+/**
+ * @brief Serve the cJSON allocations of the calling task from the arena
+ */
+void cjson_arena_begin(void) {
+  if (arena) {
+    arena_used = 0;
+    arena_owner = xTaskGetCurrentTaskHandle();
+  }
+}
+
+/**
+ * @brief Give the whole arena back
+ */
+void cjson_arena_end(void) {
+  arena_owner = NULL;
+  if (arena_used > arena_high_water) {
+    arena_high_water = arena_used;
+  }
+  arena_used = 0;
+
+  if (arena_overflows != overflows_logged) {
+    overflows_logged = arena_overflows;
+    ESP_LOGW(TAG, "Arena full, %" PRIu32 " allocations went to the heap",
+             arena_overflows);
+  }
+}
+
+void cjson_arena_get_stats(CjsonArenaStats *stats) {
+  stats->size = arena ? CONFIG_SCREEN_CJSON_ARENA_SIZE : 0;
+  stats->high_water = arena_high_water;
+  stats->overflows = arena_overflows;
+}
+
+#else // CONFIG_SCREEN_CJSON_ARENA_SIZE == 0
+
+void cjson_arena_init(void) { ESP_LOGI(TAG, "Disabled"); }
+void cjson_arena_begin(void) {}
+void cjson_arena_end(void) {}
+
+void cjson_arena_get_stats(CjsonArenaStats *stats) {
+  *stats = (CjsonArenaStats){0};
+}
+
+#endif
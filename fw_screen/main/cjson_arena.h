@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Per-message bump allocator for cJSON.
+ *
+ * cjson_arena_init() installs cJSON hooks once. Between cjson_arena_begin()
+ * and cjson_arena_end() every cJSON allocation made by the calling task is
+ * carved from a fixed arena and freeing it is a no-op; cjson_arena_end()
+ * gives the whole arena back in O(1). Allocations from other tasks (the LVGL
+ * buttons build JSON too) and allocations that do not fit go to the heap as
+ * usual, the latter are counted as overflows.
+ *
+ * Everything allocated inside a scope must be freed before it ends.
+ */
+
+void cjson_arena_init(void);
+void cjson_arena_begin(void);
+void cjson_arena_end(void);
+
+typedef struct {
+  size_t size;
+  size_t high_water;  // most bytes used by one message
+  uint32_t overflows; // allocations that went to the heap
+} CjsonArenaStats;
+
+void cjson_arena_get_stats(CjsonArenaStats *stats);
@@ -0,0 +1,111 @@
+#include "clock_format.h"
+#include <time.h>
+
+#define SECONDS_PER_DAY 86400
+
+// Offsets into ClockFormat.text
+#define CLOCK_HOURS 11
+#define CLOCK_MINUTES 14
+#define CLOCK_SECONDS 17
+#define CLOCK_DOT 19
+#define CLOCK_MILLIS 20
+
+static void put_digits(char *dst, uint32_t value, int digits) {
+  while (digits-- > 0) {
+    dst[digits] = '0' + value % 10;
+    value /= 10;
+  }
+}
+
+static int is_dst(uint32_t seconds) {
+  time_t t = seconds;
+  struct tm tm;
+  localtime_r(&t, &tm);
+  return tm.tm_isdst;
+}
+
+/**
+ * @brief First second in [low, high] whose DST state differs from low's
+ *
+ * high must be in the other state. About 17 localtime_r() calls over a day.
+ */
+static uint32_t clock_find_change(uint32_t low, uint32_t high) {
+  int dst = is_dst(low);
+  while (high - low > 1) {
+    uint32_t middle = low + (high - low) / 2;
+    if (is_dst(middle) == dst) {
+      low = middle;
+    } else {
+      high = middle;
+    }
+  }
+  return high;
+}
+
+/**
+ * @brief Run the TZ rules for seconds and cache its local day
+ *
+ * The window is the local day of seconds, cut at a DST change on either
+ * side, which only happens on two days a year.
+ */
+static void clock_load_day(ClockFormat *clock, uint32_t seconds) {
+  time_t t = seconds;
+  struct tm tm;
+  localtime_r(&t, &tm);
+
+  uint32_t time = tm.tm_hour * 3600 + tm.tm_min * 60 + tm.tm_sec;
+  clock->day_start = seconds - time;
+  clock->valid_from = clock->day_start;
+  clock->valid_until = clock->day_start + SECONDS_PER_DAY;
+  if (clock->valid_until <= seconds) {
+    clock->valid_until = seconds + 1; // end of the uint32_t range
+  }
+
+  if (is_dst(clock->valid_from) != tm.tm_isdst) {
+    clock->valid_from = clock_find_change(clock->valid_from, seconds);
+  }
+  if (is_dst(clock->valid_until - 1) != tm.tm_isdst) {
+    clock->valid_until = clock_find_change(seconds, clock->valid_until - 1);
+  }
+
+  strftime(clock->text, sizeof(clock->text), "%Y-%m-%d ", &tm);
+  clock->text[CLOCK_MINUTES - 1] = ':';
+  clock->text[CLOCK_SECONDS - 1] = ':';
+  clock->time = UINT32_MAX; // rewrite every field
+}
+
+/**
+ * @brief Format a timestamp in local time
+ *
+ * @param[in] millis Shown only with show_millis
+ *
+ * @return clock->text, valid until the next call with the same clock
+ */
+const char *clock_format(ClockFormat *clock, uint32_t seconds,
+                         uint16_t millis, bool show_millis) {
+  if (seconds < clock->valid_from || seconds >= clock->valid_until) {
+    clock_load_day(clock, seconds);
+  }
+
+  uint32_t time = seconds - clock->day_start;
+  if (time != clock->time) {
+    uint32_t previous = clock->time;
+    if (time / 3600 != previous / 3600) {
+      put_digits(clock->text + CLOCK_HOURS, time / 3600, 2);
+    }
+    if (time / 60 != previous / 60) {
+      put_digits(clock->text + CLOCK_MINUTES, time / 60 % 60, 2);
+    }
+    put_digits(clock->text + CLOCK_SECONDS, time % 60, 2);
+    clock->time = time;
+  }
+
+  if (show_millis) {
+    clock->text[CLOCK_DOT] = '.';
+    put_digits(clock->text + CLOCK_MILLIS, millis, 3);
+    clock->text[CLOCK_FORMAT_LEN] = '\0';
+  } else {
+    clock->text[CLOCK_DOT] = '\0';
+  }
+  return clock->text;
+}
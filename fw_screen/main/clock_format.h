@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @brief Incremental "YYYY-MM-DD HH:MM:SS[.mmm]" formatter for local time.
+ *
+ * localtime_r() walks the TZ rules on every call, which is most of the cost
+ * of showing a sample's timestamp. The formatter runs it once per local day
+ * instead: it caches the UTC start of the day and the span over which the
+ * cached date and UTC offset hold, the local day cut at a DST change if there
+ * is one that day. Inside that span a timestamp only needs its seconds of the
+ * day split into hours, minutes and seconds, and only the fields that changed
+ * since the previous call are rewritten.
+ *
+ * One ClockFormat per label, zero-initialized. The TZ is expected to be set
+ * once at start up, before the first call.
+ */
+
+// "YYYY-MM-DD HH:MM:SS.mmm"
+#define CLOCK_FORMAT_LEN 23
+
+typedef struct ClockFormat {
+  uint32_t day_start;   // UTC of the cached local midnight
+  uint32_t valid_from;  // UTC, the cached date and offset hold from here
+  uint32_t valid_until; // up to here, exclusive; 0 until the first call
+  uint32_t time;        // seconds of the day in text
+  char text[CLOCK_FORMAT_LEN + 1];
+} ClockFormat;
+
+const char *clock_format(ClockFormat *clock, uint32_t seconds,
+                         uint16_t millis, bool show_millis);
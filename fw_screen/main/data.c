@@ -1,627 +1,433 @@
 #include "data.h"
 #include "cJSON.h"
+#include "cjson_arena.h"
+#include "decimal.h"
 #include "esp_log.h"
-#include "lvgl.h"
-#include "lvgl_ui.h"
-#include "lvgl_utils.h"
+#include "history.h"
+#include "json_keys.h"
+#include "json_scan.h"
+#include "pm_stats.h"
+#include "protocol.h"
+#include "sample_log.h"
+#include "sdkconfig.h"
+#include "snapshot.h"
 #include "string.h"
+#include "transport.h"
+#include "wind_stats.h"
+#include "wind_vector.h"
+#include <math.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#ifdef CONFIG_IDF_TARGET_LINUX
+#include "host_ui.h"
+#else
+#include "lvgl_ui.h"
+#endif
 
 static const char *TAG = "DATA";
 
-AnemometerData anemometerData;
-ParticulateMatterData particulateMatterData;
-ImuData imuData;
-
-void anemometer_data_default(AnemometerData *anm_data) {
-  anm_data->x_vout = 0;
-  anm_data->y_vout = 0;
-  anm_data->z_vout = 0;
+// Working copies, written by the RX task only; frames that omit a field keep
+// its previous value
+static AnemometerData anemometerData;
+static ParticulateMatterData particulateMatterData;
+static ImuData imuData;
+
+// Handed over to the LVGL task
+static AnemometerData anemometer_slots[3];
+static ParticulateMatterData particulate_matter_slots[3];
+static ImuData imu_slots[3];
+static Snapshot anemometer_snapshot = SNAPSHOT_INIT(anemometer_slots);
+static Snapshot particulate_matter_snapshot =
+    SNAPSHOT_INIT(particulate_matter_slots);
+static Snapshot imu_snapshot = SNAPSHOT_INIT(imu_slots);
+
+// Keep in sync with UNITS in server/src/protocol.rs
+static const char *const unit_names[UNIT_COUNT] = {
+    "",   "ug/m3", "#/cm3", "um", "g",     "m/s2",
+    "uT", "dps",   "rad/s", "mg", "gauss",
+};
+
+const char *unit_name(Unit unit) {
+  return unit < UNIT_COUNT ? unit_names[unit] : "";
+}
 
-  anm_data->autocalibrazione_asse_x = false;
-  anm_data->autocalibrazione_asse_y = false;
-  anm_data->autocalibrazione_asse_z = false;
+/**
+ * @brief Intern a unit name, UNIT_NONE for names the firmware does not know
+ */
+Unit unit_lookup(const char *name, size_t len) {
+  for (int unit = UNIT_NONE + 1; unit < UNIT_COUNT; unit++) {
+    if (strncmp(unit_names[unit], name, len) == 0 &&
+        unit_names[unit][len] == '\0') {
+      return unit;
+    }
+  }
+  return UNIT_NONE;
+}
 
-  anm_data->autocalibrazione_misura_x = false;
-  anm_data->autocalibrazione_misura_y = false;
-  anm_data->autocalibrazione_misura_z = false;
+/**
+ * @brief Round to hundredths, saturating at the int16_t range
+ */
+int16_t data_to_centi(float value) {
+  float centi = value * 100.0f;
+  if (!(centi > INT16_MIN)) {
+    return isnan(centi) ? 0 : INT16_MIN;
+  }
+  if (centi >= INT16_MAX) {
+    return INT16_MAX;
+  }
+  return (int16_t)(centi < 0 ? centi - 0.5f : centi + 0.5f);
+}
 
-  anm_data->temp_sonica_x = 0;
-  anm_data->temp_sonica_y = 0;
-  anm_data->temp_sonica_z = 0;
+void anemometer_data_default(AnemometerData *anm_data) {
+  *anm_data = (AnemometerData){0};
 }
 
 void particulate_matter_data_default(ParticulateMatterData *pm_data) {
-  pm_data->timestamp = 0;
-
-  pm_data->mass_density_pm_1_0 = 0;
-  pm_data->mass_density_pm_1_0 = 0;
-  pm_data->mass_density_pm_2_5 = 0;
-  pm_data->mass_density_pm_10 = 0;
-
-  pm_data->particle_count_0_5 = 0;
-  pm_data->particle_count_1_0 = 0;
-  pm_data->particle_count_2_5 = 0;
-  pm_data->particle_count_4_0 = 0;
-  pm_data->particle_count_10 = 0;
-
-  pm_data->particle_size = 0;
+  *pm_data = (ParticulateMatterData){0};
+}
 
-  strcpy(pm_data->mass_density_unit, "");
-  strcpy(pm_data->particle_size_unit, "");
-  strcpy(pm_data->particle_count_unit, "");
+void imu_data_default(ImuData *imu_data) { *imu_data = (ImuData){0}; }
+
+/**
+ * @brief Latest parsed anemometer sample, for the LVGL task
+ *
+ * @param[out] anm_data Valid until the next call
+ *
+ * @return true if a sample arrived since the previous call
+ */
+bool anemometer_data_latest(const AnemometerData **anm_data) {
+  return snapshot_read(&anemometer_snapshot, (const void **)anm_data);
 }
 
-void imu_data_default(ImuData *imu_data) {
-  imu_data->timestamp = 0;
+bool particulate_matter_data_latest(const ParticulateMatterData **pm_data) {
+  return snapshot_read(&particulate_matter_snapshot, (const void **)pm_data);
+}
 
-  imu_data->acc_top_x = 0;
-  imu_data->acc_top_y = 0;
-  imu_data->acc_top_z = 0;
+bool imu_data_latest(const ImuData **imu_data) {
+  return snapshot_read(&imu_snapshot, (const void **)imu_data);
+}
 
-  imu_data->acc_x = 0;
-  imu_data->acc_y = 0;
-  imu_data->acc_z = 0;
+// ----------------------------------------
+// Field descriptors
+// ----------------------------------------
+
+typedef enum {
+  FIELD_NUMBER,    // float
+  FIELD_CENTI,     // int16_t, hundredths
+  FIELD_TIMESTAMP, // uint32_t seconds followed by uint16_t milliseconds
+  FIELD_FLAG,      // bit mask of a uint8_t
+  FIELD_UNIT,      // uint8_t, a Unit
+  FIELD_OBJECT,    // nested object, its fields in nested
+  FIELD_DEVICES,   // array of objects, "dev" picks their table in nested
+} FieldType;
+
+typedef struct FieldTable FieldTable;
+
+typedef struct FieldDesc {
+  JsonKey key;
+  FieldType type;
+  uint16_t offset; // into the destination struct, nested tables included
+  uint8_t mask;    // FIELD_FLAG only
+  FieldTable *nested;
+} FieldDesc;
+
+/*
+ * Keys are mapped to their JsonKey by the perfect hash in json_keys.c and from
+ * there to their field through slot, so a member costs one hash and one verify
+ * whatever the size of the table. slot is filled on first use.
+ */
+struct FieldTable {
+  const char *name; // for diagnostics
+  const FieldDesc *fields;
+  size_t count;                 // at most 32
+  uint8_t slot[JSON_KEY_COUNT]; // field index + 1, 0 for other keys
+  bool indexed;
+};
+
+#define FIELD(key, type, st, member) {key, type, offsetof(st, member), 0, NULL}
+#define TIMESTAMP_FOLLOWS(st)                                                  \
+  _Static_assert(offsetof(st, timestamp_ms) ==                                 \
+                     offsetof(st, timestamp) + sizeof(uint32_t),               \
+                 #st ".timestamp_ms must follow timestamp")
+#define FIELD_FLAG(key, st, member, mask)                                      \
+  {key, FIELD_FLAG, offsetof(st, member), mask, NULL}
+#define FIELD_NESTED(key, type, table) {key, type, 0, 0, table}
+#define FIELD_TABLE(name, fields)                                              \
+  {name, fields, sizeof(fields) / sizeof(fields[0])}
+
+TIMESTAMP_FOLLOWS(AnemometerData);
+TIMESTAMP_FOLLOWS(ParticulateMatterData);
+TIMESTAMP_FOLLOWS(ImuData);
+
+static const FieldDesc anemometer_fields[] = {
+    FIELD(JSON_KEY_TIMESTAMP, FIELD_TIMESTAMP, AnemometerData, timestamp),
+    FIELD(JSON_KEY_X_VOUT, FIELD_NUMBER, AnemometerData, x_vout),
+    FIELD(JSON_KEY_Y_VOUT, FIELD_NUMBER, AnemometerData, y_vout),
+    FIELD(JSON_KEY_Z_VOUT, FIELD_NUMBER, AnemometerData, z_vout),
+    FIELD_FLAG(JSON_KEY_AUTOCALIBRAZIONE_ASSE_X, AnemometerData, flags,
+               ANM_AUTOCAL_ASSE_X),
+    FIELD_FLAG(JSON_KEY_AUTOCALIBRAZIONE_ASSE_Y, AnemometerData, flags,
+               ANM_AUTOCAL_ASSE_Y),
+    FIELD_FLAG(JSON_KEY_AUTOCALIBRAZIONE_ASSE_Z, AnemometerData, flags,
+               ANM_AUTOCAL_ASSE_Z),
+    FIELD_FLAG(JSON_KEY_AUTOCALIBRAZIONE_MISURA_X, AnemometerData, flags,
+               ANM_AUTOCAL_MISURA_X),
+    FIELD_FLAG(JSON_KEY_AUTOCALIBRAZIONE_MISURA_Y, AnemometerData, flags,
+               ANM_AUTOCAL_MISURA_Y),
+    FIELD_FLAG(JSON_KEY_AUTOCALIBRAZIONE_MISURA_Z, AnemometerData, flags,
+               ANM_AUTOCAL_MISURA_Z),
+    FIELD(JSON_KEY_TEMP_SONICA_X, FIELD_CENTI, AnemometerData, temp_sonica_x),
+    FIELD(JSON_KEY_TEMP_SONICA_Y, FIELD_CENTI, AnemometerData, temp_sonica_y),
+    FIELD(JSON_KEY_TEMP_SONICA_Z, FIELD_CENTI, AnemometerData, temp_sonica_z),
+};
+static FieldTable anemometer_table = FIELD_TABLE("ROOT", anemometer_fields);
+
+static const FieldDesc pm_mass_density_fields[] = {
+    FIELD(JSON_KEY_PM1_0, FIELD_NUMBER, ParticulateMatterData,
+          mass_density_pm_1_0),
+    FIELD(JSON_KEY_PM2_5, FIELD_NUMBER, ParticulateMatterData,
+          mass_density_pm_2_5),
+    FIELD(JSON_KEY_PM4_0, FIELD_NUMBER, ParticulateMatterData,
+          mass_density_pm_4_0),
+    FIELD(JSON_KEY_PM10, FIELD_NUMBER, ParticulateMatterData,
+          mass_density_pm_10),
+};
+static FieldTable pm_mass_density_table =
+    FIELD_TABLE("ROOT->sensor_data->mass_density", pm_mass_density_fields);
+
+static const FieldDesc pm_particle_count_fields[] = {
+    FIELD(JSON_KEY_PM0_5, FIELD_NUMBER, ParticulateMatterData,
+          particle_count_0_5),
+    FIELD(JSON_KEY_PM1_0, FIELD_NUMBER, ParticulateMatterData,
+          particle_count_1_0),
+    FIELD(JSON_KEY_PM2_5, FIELD_NUMBER, ParticulateMatterData,
+          particle_count_2_5),
+    FIELD(JSON_KEY_PM4_0, FIELD_NUMBER, ParticulateMatterData,
+          particle_count_4_0),
+    FIELD(JSON_KEY_PM10, FIELD_NUMBER, ParticulateMatterData,
+          particle_count_10),
+};
+static FieldTable pm_particle_count_table =
+    FIELD_TABLE("ROOT->sensor_data->particle_count", pm_particle_count_fields);
+
+static const FieldDesc pm_sensor_data_fields[] = {
+    FIELD_NESTED(JSON_KEY_MASS_DENSITY, FIELD_OBJECT, &pm_mass_density_table),
+    FIELD_NESTED(JSON_KEY_PARTICLE_COUNT, FIELD_OBJECT,
+                 &pm_particle_count_table),
+    FIELD(JSON_KEY_PARTICLE_SIZE, FIELD_NUMBER, ParticulateMatterData,
+          particle_size),
+    FIELD(JSON_KEY_MASS_DENSITY_UNIT, FIELD_UNIT, ParticulateMatterData,
+          mass_density_unit),
+    FIELD(JSON_KEY_PARTICLE_COUNT_UNIT, FIELD_UNIT, ParticulateMatterData,
+          particle_count_unit),
+    FIELD(JSON_KEY_PARTICLE_SIZE_UNIT, FIELD_UNIT, ParticulateMatterData,
+          particle_size_unit),
+};
+static FieldTable pm_sensor_data_table =
+    FIELD_TABLE("ROOT->sensor_data", pm_sensor_data_fields);
+
+static const FieldDesc pm_fields[] = {
+    FIELD(JSON_KEY_TIMESTAMP, FIELD_TIMESTAMP, ParticulateMatterData,
+          timestamp),
+    FIELD_NESTED(JSON_KEY_SENSOR_DATA, FIELD_OBJECT, &pm_sensor_data_table),
+};
+static FieldTable pm_table = FIELD_TABLE("ROOT", pm_fields);
+
+#define IMU_DEVICE_FIELDS(dev)                                                 \
+  {                                                                            \
+    FIELD(JSON_KEY_X, FIELD_NUMBER, ImuData, dev##_x),                         \
+        FIELD(JSON_KEY_Y, FIELD_NUMBER, ImuData, dev##_y),                     \
+        FIELD(JSON_KEY_Z, FIELD_NUMBER, ImuData, dev##_z),                     \
+        FIELD(JSON_KEY_UNIT, FIELD_UNIT, ImuData, dev##_unit),                 \
+  }
 
-  imu_data->mag_x = 0;
-  imu_data->mag_y = 0;
-  imu_data->mag_z = 0;
+static const FieldDesc imu_acc_top_fields[] = IMU_DEVICE_FIELDS(acc_top);
+static const FieldDesc imu_acc_fields[] = IMU_DEVICE_FIELDS(acc);
+static const FieldDesc imu_mag_fields[] = IMU_DEVICE_FIELDS(mag);
+static const FieldDesc imu_gyr_fields[] = IMU_DEVICE_FIELDS(gyr);
+static FieldTable imu_acc_top_table =
+    FIELD_TABLE("ROOT->sensor_data[acctop]", imu_acc_top_fields);
+static FieldTable imu_acc_table =
+    FIELD_TABLE("ROOT->sensor_data[acc]", imu_acc_fields);
+static FieldTable imu_mag_table =
+    FIELD_TABLE("ROOT->sensor_data[mag]", imu_mag_fields);
+static FieldTable imu_gyr_table =
+    FIELD_TABLE("ROOT->sensor_data[gyr]", imu_gyr_fields);
+
+static const FieldDesc imu_device_fields[] = {
+    FIELD_NESTED(JSON_KEY_ACCTOP, FIELD_OBJECT, &imu_acc_top_table),
+    FIELD_NESTED(JSON_KEY_ACC, FIELD_OBJECT, &imu_acc_table),
+    FIELD_NESTED(JSON_KEY_MAG, FIELD_OBJECT, &imu_mag_table),
+    FIELD_NESTED(JSON_KEY_GYR, FIELD_OBJECT, &imu_gyr_table),
+};
+static FieldTable imu_device_table =
+    FIELD_TABLE("ROOT->sensor_data[]->dev", imu_device_fields);
+
+static const FieldDesc imu_fields[] = {
+    FIELD(JSON_KEY_TIMESTAMP, FIELD_TIMESTAMP, ImuData, timestamp),
+    FIELD_NESTED(JSON_KEY_SENSOR_DATA, FIELD_DEVICES, &imu_device_table),
+};
+static FieldTable imu_table = FIELD_TABLE("ROOT", imu_fields);
+
+static const FieldDesc *field_lookup(FieldTable *table, JsonKey key) {
+  if (!table->indexed) {
+    for (size_t i = 0; i < table->count; i++) {
+      table->slot[table->fields[i].key] = i + 1;
+    }
+    table->indexed = true;
+  }
 
-  imu_data->gyr_x = 0;
-  imu_data->gyr_y = 0;
-  imu_data->gyr_z = 0;
+  uint8_t slot = table->slot[key];
+  return slot ? &table->fields[slot - 1] : NULL;
+}
 
-  strcpy(imu_data->acc_top_unit, "");
-  strcpy(imu_data->acc_unit, "");
-  strcpy(imu_data->mag_unit, "");
-  strcpy(imu_data->gyr_unit, "");
+static void field_store_flag(const FieldDesc *field, void *dst, bool value) {
+  uint8_t *flags = (uint8_t *)dst + field->offset;
+  *flags = value ? *flags | field->mask : *flags & ~field->mask;
 }
 
-bool parse_anemometer_data(cJSON *root, AnemometerData *anm_data) {
+/**
+ * @brief Split a fractional epoch timestamp, the same way the bridge does
+ */
+static void field_store_timestamp(uint8_t *ptr, double timestamp) {
+  // Negative, NaN and out of range timestamps saturate before any conversion
+  if (!(timestamp > 0)) {
+    timestamp = 0;
+  } else if (timestamp > UINT32_MAX) {
+    timestamp = UINT32_MAX;
+  }
+  double seconds = floor(timestamp);
+  double millis = (timestamp - seconds) * 1000;
 
-  // ----------------------------------------
-  // Timestamp
-  // ----------------------------------------
-  cJSON *cjson_timestamp = cJSON_GetObjectItem(root, "timestamp");
-
-  if (cJSON_IsNumber(cjson_timestamp)) {
-    anm_data->timestamp = (double)cjson_timestamp->valuedouble;
-  } else {
-    ESP_LOGI(TAG, "ROOT->timestamp: NOT FOUND");
-  }
-
-  // ----------------------------------------
-  // v_out
-  // ----------------------------------------
-  cJSON *cjson_x_vout = cJSON_GetObjectItem(root, "x_vout");
-  if (cJSON_IsNumber(cjson_x_vout)) {
-    anm_data->x_vout = (double)cjson_x_vout->valuedouble;
-  } else {
-    ESP_LOGI(TAG, "ROOT->x_vout: NOT FOUND");
-  }
-
-  cJSON *cjson_y_vout = cJSON_GetObjectItem(root, "y_vout");
-  if (cJSON_IsNumber(cjson_y_vout)) {
-    anm_data->y_vout = (double)cjson_y_vout->valuedouble;
-  } else {
-    ESP_LOGI(TAG, "ROOT->y_vout: NOT FOUND");
-  }
-
-  cJSON *cjson_z_vout = cJSON_GetObjectItem(root, "z_vout");
-  if (cJSON_IsNumber(cjson_z_vout)) {
-    anm_data->z_vout = (double)cjson_z_vout->valuedouble;
-  } else {
-    ESP_LOGI(TAG, "ROOT->z_vout: NOT FOUND");
-  }
-
-  // ----------------------------------------
-  // Axis Autocalibration
-  // ----------------------------------------
-  cJSON *cjson_autocalibrazione_asse_x =
-      cJSON_GetObjectItem(root, "autocalibrazione_asse_x");
-  if (cJSON_IsBool(cjson_autocalibrazione_asse_x)) {
-    anm_data->autocalibrazione_asse_x =
-        cJSON_IsTrue(cjson_autocalibrazione_asse_x);
-  } else {
-    ESP_LOGI(TAG, "ROOT->autocalibrazione_asse_x: NOT FOUND");
-  }
-
-  cJSON *cjson_autocalibrazione_asse_y =
-      cJSON_GetObjectItem(root, "autocalibrazione_asse_y");
-  if (cJSON_IsBool(cjson_autocalibrazione_asse_y)) {
-    anm_data->autocalibrazione_asse_y =
-        cJSON_IsTrue(cjson_autocalibrazione_asse_y);
-  } else {
-    ESP_LOGI(TAG, "ROOT->autocalibrazione_asse_y: NOT FOUND");
-  }
-
-  cJSON *cjson_autocalibrazione_asse_z =
-      cJSON_GetObjectItem(root, "autocalibrazione_asse_z");
-  if (cJSON_IsBool(cjson_autocalibrazione_asse_z)) {
-    anm_data->autocalibrazione_asse_z =
-        cJSON_IsTrue(cjson_autocalibrazione_asse_z);
-  } else {
-    ESP_LOGI(TAG, "ROOT->autocalibrazione_asse_z: NOT FOUND");
-  }
-
-  // ----------------------------------------
-  // Measure Autocalibration
-  // ----------------------------------------
-  cJSON *cjson_autocalibrazione_misura_x =
-      cJSON_GetObjectItem(root, "autocalibrazione_misura_x");
-  if (cJSON_IsBool(cjson_autocalibrazione_misura_x)) {
-    anm_data->autocalibrazione_misura_x =
-        cJSON_IsTrue(cjson_autocalibrazione_misura_x);
-  } else {
-    ESP_LOGI(TAG, "ROOT->autocalibrazione_misura_x: NOT FOUND");
-  }
-
-  cJSON *cjson_autocalibrazione_misura_y =
-      cJSON_GetObjectItem(root, "autocalibrazione_misura_y");
-  if (cJSON_IsBool(cjson_autocalibrazione_misura_y)) {
-    anm_data->autocalibrazione_misura_y =
-        cJSON_IsTrue(cjson_autocalibrazione_misura_y);
-  } else {
-    ESP_LOGI(TAG, "ROOT->autocalibrazione_misura_y: NOT FOUND");
-  }
-
-  cJSON *cjson_autocalibrazione_misura_z =
-      cJSON_GetObjectItem(root, "autocalibrazione_misura_z");
-  if (cJSON_IsBool(cjson_autocalibrazione_misura_z)) {
-    anm_data->autocalibrazione_misura_z =
-        cJSON_IsTrue(cjson_autocalibrazione_misura_z);
-  } else {
-    ESP_LOGI(TAG, "ROOT->autocalibrazione_misura_z: NOT FOUND");
-  }
-
-  // ----------------------------------------
-  // Sonic Temperature
-  // ----------------------------------------
-  cJSON *cjson_temp_sonica_x = cJSON_GetObjectItem(root, "temp_sonica_x");
-  if (cJSON_IsNumber(cjson_temp_sonica_x)) {
-    anm_data->temp_sonica_x = (double)cjson_temp_sonica_x->valuedouble;
-  } else {
-    ESP_LOGI(TAG, "ROOT->temp_sonica_x: NOT FOUND");
-  }
-
-  cJSON *cjson_temp_sonica_y = cJSON_GetObjectItem(root, "temp_sonica_y");
-  if (cJSON_IsNumber(cjson_temp_sonica_y)) {
-    anm_data->temp_sonica_y = (double)cjson_temp_sonica_y->valuedouble;
-  } else {
-    ESP_LOGI(TAG, "ROOT->temp_sonica_y: NOT FOUND");
-  }
-
-  cJSON *cjson_temp_sonica_z = cJSON_GetObjectItem(root, "temp_sonica_z");
-  if (cJSON_IsNumber(cjson_temp_sonica_z)) {
-    anm_data->temp_sonica_z = (double)cjson_temp_sonica_z->valuedouble;
-  } else {
-    ESP_LOGI(TAG, "ROOT->temp_sonica_z: NOT FOUND");
-  }
-
-  ESP_LOGI(TAG, "ANEMOMETER DATA PARSED OK.");
-  return true;
+  *(uint32_t *)ptr = seconds;
+  *(uint16_t *)(ptr + sizeof(uint32_t)) = millis < 999 ? millis : 999;
 }
 
-bool parse_particulate_matter_data(cJSON *root,
-                                   ParticulateMatterData *sps_data) {
+static void field_log_missing(const FieldTable *table, uint32_t found) {
+  for (size_t i = 0; i < table->count; i++) {
+    if (!(found & (1u << i))) {
+      ESP_LOGD(TAG, "%s->%s: NOT FOUND", table->name,
+               json_key_name(table->fields[i].key));
+    }
+  }
+}
 
-  // ----------------------------------------
-  // Timestamp
-  // ----------------------------------------
-  cJSON *cjson_timestamp = cJSON_GetObjectItem(root, "timestamp");
-
-  if (cJSON_IsNumber(cjson_timestamp)) {
-    particulateMatterData.timestamp = (double)cjson_timestamp->valuedouble;
-  } else {
-    ESP_LOGW(TAG, "ROOT->timestamp: NOT FOUND");
-  }
-
-  // ----------------------------------------
-  // sensor_data
-  // ----------------------------------------
-  cJSON *cjson_sensor_data = cJSON_GetObjectItem(root, "sensor_data");
-
-  if (!cJSON_IsObject(cjson_sensor_data)) {
-    ESP_LOGI(TAG, "ROOT->sensor_data: NOT FOUND");
-  } else {
-    // ----------------------------------------
-    // sensor_data -> mass_density
-    // ----------------------------------------
-    cJSON *cjson_mass_density =
-        cJSON_GetObjectItem(cjson_sensor_data, "mass_density");
-
-    if (!cJSON_IsObject(cjson_mass_density)) {
-      ESP_LOGI(TAG, "ROOT->sensor_data->mass_density: NOT FOUND");
-    } else {
-      // ----------------------------------------
-      // sensor_data -> mass_density -> pm 1.0
-      // ----------------------------------------
-      cJSON *cjson_md_pm1_0 = cJSON_GetObjectItem(cjson_mass_density, "pm1.0");
-      if (cJSON_IsNumber(cjson_md_pm1_0)) {
-        particulateMatterData.mass_density_pm_1_0 =
-            (double)cjson_md_pm1_0->valuedouble;
-      } else {
-        ESP_LOGI(TAG, "ROOT->sensor_data->mass_density->pm1.0: NOT FOUND");
-      }
+// ----------------------------------------
+// cJSON path
+// ----------------------------------------
 
-      // ----------------------------------------
-      // sensor_data -> mass_density -> pm 2.5
-      // ----------------------------------------
-      cJSON *cjson_md_pm2_5 = cJSON_GetObjectItem(cjson_mass_density, "pm2.5");
-      if (cJSON_IsNumber(cjson_md_pm2_5)) {
-        particulateMatterData.mass_density_pm_2_5 =
-            (double)cjson_md_pm2_5->valuedouble;
-      } else {
-        ESP_LOGI(TAG, "ROOT->sensor_data->mass_density->pm2.5: NOT FOUND");
-      }
+static void cjson_fill(const cJSON *object, FieldTable *table, void *dst);
 
-      // ----------------------------------------
-      // sensor_data -> mass_density -> pm 4.0
-      // ----------------------------------------
-      cJSON *cjson_md_pm4_0 = cJSON_GetObjectItem(cjson_mass_density, "pm4.0");
-      if (cJSON_IsNumber(cjson_md_pm4_0)) {
-        particulateMatterData.mass_density_pm_4_0 =
-            (double)cjson_md_pm4_0->valuedouble;
-      } else {
-        ESP_LOGI(TAG, "ROOT->sensor_data->mass_density->pm4.0: NOT FOUND");
-      }
+static bool cjson_store(const cJSON *item, const FieldDesc *field,
+                        void *dst) {
+  uint8_t *ptr = (uint8_t *)dst + field->offset;
 
-      // ----------------------------------------
-      // sensor_data -> mass_density -> pm 10
-      // ----------------------------------------
-      cJSON *cjson_md_pm10 = cJSON_GetObjectItem(cjson_mass_density, "pm10");
-      if (cJSON_IsNumber(cjson_md_pm10)) {
-        particulateMatterData.mass_density_pm_10 =
-            (double)cjson_md_pm10->valuedouble;
-      } else {
-        ESP_LOGI(TAG, "ROOT->sensor_data->mass_density->pm10: NOT FOUND");
-      }
+  switch (field->type) {
+  case FIELD_NUMBER:
+    if (!cJSON_IsNumber(item)) {
+      return false;
     }
+    *(float *)ptr = item->valuedouble;
+    return true;
 
-    // ----------------------------------------
-    // sensor_data -> particle_count
-    // ----------------------------------------
-    cJSON *cjson_particle_count =
-        cJSON_GetObjectItem(cjson_sensor_data, "particle_count");
-
-    if (!cJSON_IsObject(cjson_particle_count)) {
-      ESP_LOGI(TAG, "ROOT->sensor_data->particle_count: NOT FOUND");
-    } else {
-      // ----------------------------------------
-      // sensor_data -> particle_count -> pm0.5
-      // ----------------------------------------
-      cJSON *cjson_pc_pm0_5 =
-          cJSON_GetObjectItem(cjson_particle_count, "pm0.5");
-      if (cJSON_IsNumber(cjson_pc_pm0_5)) {
-        particulateMatterData.particle_count_0_5 =
-            (double)cjson_pc_pm0_5->valuedouble;
-      } else {
-        ESP_LOGI(TAG, "ROOT->sensor_data->particle_count->pm0.5: NOT FOUND");
-      }
-
-      // ----------------------------------------
-      // sensor_data -> particle_count -> pm1.0
-      // ----------------------------------------
-      cJSON *cjson_pc_pm1_0 =
-          cJSON_GetObjectItem(cjson_particle_count, "pm1.0");
-      if (cJSON_IsNumber(cjson_pc_pm1_0)) {
-        particulateMatterData.particle_count_1_0 =
-            (double)cjson_pc_pm1_0->valuedouble;
-      } else {
-        ESP_LOGI(TAG, "ROOT->sensor_data->particle_count->pm1.0: NOT FOUND");
-      }
+  case FIELD_CENTI:
+    if (!cJSON_IsNumber(item)) {
+      return false;
+    }
+    *(int16_t *)ptr = data_to_centi(item->valuedouble);
+    return true;
 
-      // ----------------------------------------
-      // sensor_data -> particle_count -> pm2.5
-      // ----------------------------------------
-      cJSON *cjson_pc_pm2_5 =
-          cJSON_GetObjectItem(cjson_particle_count, "pm2.5");
-      if (cJSON_IsNumber(cjson_pc_pm2_5)) {
-        particulateMatterData.particle_count_2_5 =
-            (double)cjson_pc_pm2_5->valuedouble;
-      } else {
-        ESP_LOGI(TAG, "ROOT->sensor_data->particle_count->pm2.5: NOT FOUND");
-      }
+  case FIELD_TIMESTAMP:
+    if (!cJSON_IsNumber(item)) {
+      return false;
+    }
+    field_store_timestamp(ptr, item->valuedouble);
+    return true;
 
-      // ----------------------------------------
-      // sensor_data -> particle_count -> pm4.0
-      // ----------------------------------------
-      cJSON *cjson_pc_pm4_0 =
-          cJSON_GetObjectItem(cjson_particle_count, "pm4.0");
-      if (cJSON_IsNumber(cjson_pc_pm4_0)) {
-        particulateMatterData.particle_count_4_0 =
-            (double)cjson_pc_pm4_0->valuedouble;
-      } else {
-        ESP_LOGI(TAG, "ROOT->sensor_data->particle_count->pm4.0: NOT FOUND");
-      }
+  case FIELD_FLAG:
+    if (!cJSON_IsBool(item)) {
+      return false;
+    }
+    field_store_flag(field, dst, cJSON_IsTrue(item));
+    return true;
 
-      // ----------------------------------------
-      // sensor_data -> particle_count -> pm10
-      // ----------------------------------------
-      cJSON *cjson_pc_pm10 = cJSON_GetObjectItem(cjson_particle_count, "pm10");
-      if (cJSON_IsNumber(cjson_pc_pm10)) {
-        particulateMatterData.particle_count_10 =
-            (double)cjson_pc_pm10->valuedouble;
-      } else {
-        ESP_LOGI(TAG, "ROOT->sensor_data->particle_count->pm10: NOT FOUND");
-      }
+  case FIELD_UNIT:
+    if (!cJSON_IsString(item)) {
+      return false;
     }
+    *ptr = unit_lookup(item->valuestring, strlen(item->valuestring));
+    return true;
 
-    // ----------------------------------------
-    // sensor_data -> particle_size
-    // ----------------------------------------
-    cJSON *cjson_particle_size =
-        cJSON_GetObjectItem(cjson_sensor_data, "particle_size");
-    if (cJSON_IsNumber(cjson_particle_size)) {
-      particulateMatterData.particle_size =
-          (double)cjson_particle_size->valuedouble;
-    } else {
-      ESP_LOGI(TAG, "ROOT->particle_size: NOT FOUND");
+  case FIELD_OBJECT:
+    if (!cJSON_IsObject(item)) {
+      return false;
     }
+    cjson_fill(item, field->nested, dst);
+    return true;
 
-    // ----------------------------------------
-    // sensor_data -> mass_density_unit
-    // ----------------------------------------
-    cJSON *cjson_mass_density_unit =
-        cJSON_GetObjectItem(cjson_sensor_data, "mass_density_unit");
-    if (cJSON_IsString(cjson_mass_density_unit)) {
-      strcpy(particulateMatterData.mass_density_unit,
-             cjson_mass_density_unit->valuestring);
-    } else {
-      ESP_LOGI(TAG, "ROOT->mass_density_unit: NOT FOUND");
+  case FIELD_DEVICES: {
+    if (!cJSON_IsArray(item)) {
+      return false;
     }
-    // ----------------------------------------
-    // sensor_data -> particle_count_unit
-    // ----------------------------------------
-    cJSON *cjson_particle_count_unit =
-        cJSON_GetObjectItem(cjson_sensor_data, "particle_count_unit");
-    if (cJSON_IsString(cjson_particle_count_unit)) {
-      strcpy(particulateMatterData.particle_count_unit,
-             cjson_particle_count_unit->valuestring);
-    } else {
-      ESP_LOGI(TAG, "ROOT->particle_count_unit: NOT FOUND");
+    const cJSON *element;
+    cJSON_ArrayForEach(element, item) {
+      const cJSON *dev = cJSON_GetObjectItem(element, "dev");
+      if (!cJSON_IsString(dev)) {
+        ESP_LOGD(TAG, "%s: NOT FOUND", field->nested->name);
+        continue;
+      }
+      const FieldDesc *device = field_lookup(
+          field->nested,
+          json_key_lookup(dev->valuestring, strlen(dev->valuestring)));
+      if (device) {
+        cjson_fill(element, device->nested, dst);
+      }
     }
+    return true;
+  }
+  }
+  return false;
+}
 
-    // ----------------------------------------
-    // sensor_data -> particle_size_unit
-    // ----------------------------------------
-    cJSON *cjson_particle_size_unit =
-        cJSON_GetObjectItem(cjson_sensor_data, "particle_size_unit");
-    if (cJSON_IsString(cjson_particle_size_unit)) {
-      strcpy(particulateMatterData.particle_size_unit,
-             cjson_particle_size_unit->valuestring);
-    } else {
-      ESP_LOGI(TAG, "ROOT->particle_size_unit: NOT FOUND");
+/**
+ * @brief Fill dst from the members of object in a single pass
+ *
+ * Members missing from the object leave their field untouched.
+ */
+static void cjson_fill(const cJSON *object, FieldTable *table, void *dst) {
+  uint32_t found = 0;
+  const cJSON *child;
+
+  cJSON_ArrayForEach(child, object) {
+    if (!child->string) {
+      continue;
+    }
+    const FieldDesc *field = field_lookup(
+        table, json_key_lookup(child->string, strlen(child->string)));
+    if (field && cjson_store(child, field, dst)) {
+      found |= 1u << (field - table->fields);
     }
   }
+  field_log_missing(table, found);
+}
 
-  ESP_LOGI(TAG, "SPS DATA PARSED OK.");
+bool parse_anemometer_data(cJSON *root, AnemometerData *anm_data) {
+  cjson_fill(root, &anemometer_table, anm_data);
+  ESP_LOGD(TAG, "ANEMOMETER DATA PARSED OK.");
   return true;
 }
 
-bool parse_imu_data(cJSON *root, ImuData *imu_data) {
-
-  // ----------------------------------------
-  // timestamp
-  // ----------------------------------------
-  cJSON *cjson_timestamp = cJSON_GetObjectItem(root, "timestamp");
-  if (cJSON_IsNumber(cjson_timestamp)) {
-    imu_data->timestamp = (double)cjson_timestamp->valuedouble;
-  } else {
-    ESP_LOGI(TAG, "ROOT->timestamp: NOT FOUND");
-  }
-
-  // ----------------------------------------
-  // sensor_data
-  // ----------------------------------------
-  cJSON *cjson_sensor_data_array = cJSON_GetObjectItem(root, "sensor_data");
-  if (!cJSON_IsArray(cjson_sensor_data_array)) {
-    ESP_LOGI(TAG, "ROOT->sensor_data: NOT FOUND");
-  } else {
-    int sensor_data_array_size = cJSON_GetArraySize(cjson_sensor_data_array);
-
-    for (size_t index = 0; index < sensor_data_array_size; index++) {
-      cJSON *cjson_sensor_data =
-          cJSON_GetArrayItem(cjson_sensor_data_array, index);
-
-      if (!cJSON_IsObject(cjson_sensor_data)) {
-        ESP_LOGI(TAG, "ROOT->sensor_data[%d]: NOT FOUND", index);
-      } else {
-        // ----------------------------------------
-        // sensor_data[] -> dev
-        // ----------------------------------------
-        cJSON *dev = cJSON_GetObjectItem(cjson_sensor_data, "dev");
-        if (!cJSON_IsString(dev)) {
-          ESP_LOGI(TAG, "ROOT->sensor_data[%d]->dev: NOT FOUND", index);
-
-        } else {
-          // ----------------------------------------
-          // sensor_data[] -> dev[acctop]
-          // ----------------------------------------
-          if (strcmp(dev->valuestring, "acctop") == 0) {
-
-            // ----------------------------------------
-            // sensor_data[] -> dev[acctop] -> unit
-            // ----------------------------------------
-            cJSON *cjson_acctop_unit =
-                cJSON_GetObjectItem(cjson_sensor_data, "unit");
-            if (cJSON_IsString(cjson_acctop_unit)) {
-              strcpy(imu_data->acc_top_unit, cjson_acctop_unit->valuestring);
-            } else {
-              ESP_LOGI(TAG, "ROOT->sensor_data[%d]->acctop: unit NOT FOUND",
-                       index);
-            }
-
-            // ----------------------------------------
-            // sensor_data[] -> dev[acctop] -> x
-            // ----------------------------------------
-            cJSON *cjson_acctop_x = cJSON_GetObjectItem(cjson_sensor_data, "x");
-            if (cJSON_IsNumber(cjson_acctop_x)) {
-              imu_data->acc_top_x = cjson_acctop_x->valuedouble;
-            } else {
-              ESP_LOGI(TAG, "ROOT->sensor_data[%d]->acctop: x NOT FOUND",
-                       index);
-            }
-
-            // ----------------------------------------
-            // sensor_data[] -> dev[acctop] -> y
-            // ----------------------------------------
-            cJSON *cjson_acctop_y = cJSON_GetObjectItem(cjson_sensor_data, "y");
-            if (cJSON_IsNumber(cjson_acctop_y)) {
-              imu_data->acc_top_y = cjson_acctop_y->valuedouble;
-            } else {
-              ESP_LOGI(TAG, "ROOT->sensor_data[%d]->acctop: y NOT FOUND",
-                       index);
-            }
-
-            // ----------------------------------------
-            // sensor_data[] -> dev[acctop] -> z
-            // ----------------------------------------
-            cJSON *cjson_acctop_z = cJSON_GetObjectItem(cjson_sensor_data, "z");
-            if (cJSON_IsNumber(cjson_acctop_z)) {
-              imu_data->acc_top_z = cjson_acctop_z->valuedouble;
-            } else {
-              ESP_LOGI(TAG, "ROOT->sensor_data[%d]->acctop: z NOT FOUND",
-                       index);
-            }
-
-          } else if (strcmp(dev->valuestring, "acc") == 0) {
-            // ----------------------------------------
-            // sensor_data[] -> dev[acc] -> unit
-            // ----------------------------------------
-            cJSON *cjson_acc_unit =
-                cJSON_GetObjectItem(cjson_sensor_data, "unit");
-            if (cJSON_IsString(cjson_acc_unit)) {
-              strcpy(imu_data->acc_unit, cjson_acc_unit->valuestring);
-            } else {
-              ESP_LOGI(TAG, "ROOT->sensor_data[%d]->acc: unit NOT FOUND",
-                       index);
-            }
-
-            // ----------------------------------------
-            // sensor_data[] -> dev[acc] -> x
-            // ----------------------------------------
-            cJSON *cjson_acc_x = cJSON_GetObjectItem(cjson_sensor_data, "x");
-            if (cJSON_IsNumber(cjson_acc_x)) {
-              imu_data->acc_x = (double)cjson_acc_x->valuedouble;
-            } else {
-              ESP_LOGI(TAG, "ROOT->sensor_data[%d]->acc: x NOT FOUND", index);
-            }
-
-            // ----------------------------------------
-            // sensor_data[] -> dev[acc] -> y
-            // ----------------------------------------
-            cJSON *cjson_acc_y = cJSON_GetObjectItem(cjson_sensor_data, "y");
-            if (cJSON_IsNumber(cjson_acc_y)) {
-              imu_data->acc_y = (double)cjson_acc_y->valuedouble;
-            } else {
-              ESP_LOGI(TAG, "ROOT->sensor_data[%d]->acc: y NOT FOUND", index);
-            }
-
-            // ----------------------------------------
-            // sensor_data[] -> dev[acc] -> z
-            // ----------------------------------------
-            cJSON *cjson_acc_z = cJSON_GetObjectItem(cjson_sensor_data, "z");
-            if (cJSON_IsNumber(cjson_acc_z)) {
-              imu_data->acc_z = (double)cjson_acc_z->valuedouble;
-            } else {
-              ESP_LOGI(TAG, "ROOT->sensor_data[%d]->acc: z NOT FOUND", index);
-            }
-
-          } else if (strcmp(dev->valuestring, "mag") == 0) {
-            // ----------------------------------------
-            // sensor_data[] -> dev[mag] -> unit
-            // ----------------------------------------
-            cJSON *cjson_mag_unit =
-                cJSON_GetObjectItem(cjson_sensor_data, "unit");
-
-            if (cJSON_IsString(cjson_mag_unit)) {
-              strcpy(imu_data->mag_unit, cjson_mag_unit->valuestring);
-            } else {
-              ESP_LOGI(TAG, "ROOT->sensor_data[%d]->mag: unit NOT FOUND",
-                       index);
-            }
-
-            // ----------------------------------------
-            // sensor_data[] -> dev[mag] -> x
-            // ----------------------------------------
-            cJSON *cjson_mag_x = cJSON_GetObjectItem(cjson_sensor_data, "x");
-            if (cJSON_IsNumber(cjson_mag_x)) {
-              imu_data->mag_x = (double)cjson_mag_x->valuedouble;
-            } else {
-              ESP_LOGI(TAG, "ROOT->sensor_data[%d]->mag: x NOT FOUND", index);
-            }
-
-            // ----------------------------------------
-            // sensor_data[] -> dev[mag] -> y
-            // ----------------------------------------
-            cJSON *cjson_mag_y = cJSON_GetObjectItem(cjson_sensor_data, "y");
-            if (cJSON_IsNumber(cjson_mag_y)) {
-              imu_data->mag_y = (double)cjson_mag_y->valuedouble;
-            } else {
-              ESP_LOGI(TAG, "ROOT->sensor_data[%d]->mag: y NOT FOUND", index);
-            }
-
-            // ----------------------------------------
-            // sensor_data[] -> dev[mag] -> z
-            // ----------------------------------------
-            cJSON *cjson_mag_z = cJSON_GetObjectItem(cjson_sensor_data, "z");
-            if (cJSON_IsNumber(cjson_mag_z)) {
-              imu_data->mag_z = (double)cjson_mag_z->valuedouble;
-            } else {
-              ESP_LOGI(TAG, "ROOT->sensor_data[%d]->mag: z NOT FOUND", index);
-            }
-
-          } else if (strcmp(dev->valuestring, "gyr") == 0) {
-            // ----------------------------------------
-            // sensor_data[] -> dev[gyr] -> unit
-            // ----------------------------------------
-            cJSON *cjson_gyr_unit =
-                cJSON_GetObjectItem(cjson_sensor_data, "unit");
-
-            if (cJSON_IsString(cjson_gyr_unit)) {
-              strcpy(imu_data->gyr_unit, cjson_gyr_unit->valuestring);
-            } else {
-              ESP_LOGI(TAG, "ROOT->sensor_data[%d]->gyr: unit NOT FOUND",
-                       index);
-              strcpy(imu_data->gyr_unit, "");
-            }
-
-            // ----------------------------------------
-            // sensor_data[] -> dev[gyr] -> x
-            // ----------------------------------------
-            cJSON *cjson_gyr_x = cJSON_GetObjectItem(cjson_sensor_data, "x");
-            if (cJSON_IsNumber(cjson_gyr_x)) {
-              imu_data->gyr_x = (double)cjson_gyr_x->valuedouble;
-            } else {
-              ESP_LOGI(TAG, "ROOT->sensor_data[%d]->gyr: x NOT FOUND", index);
-            }
-
-            // ----------------------------------------
-            // sensor_data[] -> dev[gyr] -> y
-            // ----------------------------------------
-            cJSON *cjson_gyr_y = cJSON_GetObjectItem(cjson_sensor_data, "y");
-            if (cJSON_IsNumber(cjson_gyr_y)) {
-              imu_data->gyr_y = (double)cjson_gyr_y->valuedouble;
-            } else {
-              ESP_LOGI(TAG, "ROOT->sensor_data[%d]->gyr: y NOT FOUND", index);
-            }
-
-            // ----------------------------------------
-            // sensor_data[] -> dev[gyr] -> z
-            // ----------------------------------------
-            cJSON *cjson_gyr_z = cJSON_GetObjectItem(cjson_sensor_data, "z");
-            if (cJSON_IsNumber(cjson_gyr_z)) {
-              imu_data->gyr_z = (double)cjson_gyr_z->valuedouble;
-            } else {
-              ESP_LOGI(TAG, "ROOT->sensor_data[%d]->gyr: z NOT FOUND", index);
-            }
-          }
-        }
-      }
-    }
-  }
+bool parse_particulate_matter_data(cJSON *root,
+                                   ParticulateMatterData *sps_data) {
+  cjson_fill(root, &pm_table, sps_data);
+  ESP_LOGD(TAG, "SPS DATA PARSED OK.");
+  return true;
+}
 
-  ESP_LOGI(TAG, "IMU DATA PARSED OK.");
+bool parse_imu_data(cJSON *root, ImuData *imu_data) {
+  cjson_fill(root, &imu_table, imu_data);
+  ESP_LOGD(TAG, "IMU DATA PARSED OK.");
   return true;
 }
 
@@ -638,6 +444,25 @@ bool parse_status_data(cJSON *root) {
   return true;
 }
 
+/**
+ * @brief Export command from the host: stream the logged samples of
+ * [from, to], seconds since the epoch, both optional
+ */
+static bool parse_log_export(cJSON *root) {
+  cJSON *from = cJSON_GetObjectItem(root, "from");
+  cJSON *to = cJSON_GetObjectItem(root, "to");
+
+  if ((from && !cJSON_IsNumber(from)) || (to && !cJSON_IsNumber(to))) {
+    ESP_LOGI(TAG, "ROOT->from/to: NOT A NUMBER.");
+    return false;
+  }
+
+  sample_log_export(from && from->valuedouble > 0 ? from->valuedouble : 0,
+                    to && to->valuedouble < UINT32_MAX ? to->valuedouble
+                                                       : UINT32_MAX);
+  return true;
+}
+
 ParseReturnCode parse_data(cJSON *json, AnemometerData *anm_data,
                            ParticulateMatterData *pm_data, ImuData *imu_data) {
   static const char *TAG = "PARSE_DATA";
@@ -651,47 +476,447 @@ ParseReturnCode parse_data(cJSON *json, AnemometerData *anm_data,
     return PRC_PARSING_ERROR;
   }
 
-  if (strcmp(topic->valuestring, "anm") == 0) {
+  switch (json_key_lookup(topic->valuestring, strlen(topic->valuestring))) {
+  case JSON_KEY_ANM:
     if (parse_anemometer_data(json, anm_data))
       return PRC_UPDATED_ANEMOMETER;
-  }
-
-  if (strcmp(topic->valuestring, "sps") == 0) {
+    break;
+  case JSON_KEY_SPS:
     if (parse_particulate_matter_data(json, pm_data))
       return PRC_UPDATE_PARTICULATE_MATTER;
-  }
-
-  if (strcmp(topic->valuestring, "imu") == 0) {
+    break;
+  case JSON_KEY_IMU:
     if (parse_imu_data(json, imu_data))
       return PRC_UPDATE_IMU;
-  }
-
-  if (strcmp(topic->valuestring, "status") == 0) {
+    break;
+  case JSON_KEY_STATUS:
     if (parse_status_data(json))
       return PRC_STATUS;
-  }
-
-  if (strcmp(topic->valuestring, "type") == 0) {
+    break;
+  case JSON_KEY_HELLO:
+    transport_handle_hello(json);
+    return PRC_LINK;
+  case JSON_KEY_LOG_EXPORT:
+    if (parse_log_export(json))
+      return PRC_LINK;
+    break;
+  case JSON_KEY_TYPE:
     ESP_LOGI(TAG, "COMMAND");
+    break;
+  default:
+    break;
   }
 
   ESP_LOGI(TAG, "Unknown topic: %s", topic->valuestring);
   return PRC_PARSING_ERROR;
 }
 
-void on_json_received(cJSON *json) {
+// ----------------------------------------
+// Scanner path: frames are parsed in place, without a cJSON tree
+// ----------------------------------------
+
+static bool scan_fill(JsonScanner *scanner, FieldTable *table, void *dst);
+
+/**
+ * @brief Key of a string token, JSON_KEY_NONE for unknown or escaped strings
+ */
+static JsonKey scan_key(const JsonToken *token) {
+  if (token->type != JSON_SCAN_STRING || token->escaped) {
+    return JSON_KEY_NONE;
+  }
+  return json_key_lookup(token->start, token->len);
+}
+
+/**
+ * @brief One element of a FIELD_DEVICES array
+ *
+ * "dev" may come after the values, so it is looked up with a shallow scan
+ * before the element is filled.
+ */
+static bool scan_device(const JsonToken *element, FieldTable *devices,
+                        void *dst) {
+  JsonScanner scanner;
+  JsonToken key;
+  JsonToken value;
+  const FieldDesc *device = NULL;
+
+  if (!json_scan_enter(&scanner, element)) {
+    return true; // not an object, skipped like the cJSON path does
+  }
+  while (json_scan_member(&scanner, &key, &value)) {
+    if (scan_key(&key) == JSON_KEY_DEV) {
+      device = field_lookup(devices, scan_key(&value));
+    }
+  }
+  if (scanner.error) {
+    return false;
+  }
+  if (!device) {
+    return true;
+  }
+
+  json_scan_enter(&scanner, element);
+  return scan_fill(&scanner, device->nested, dst);
+}
+
+/**
+ * @brief Store one scanned value
+ *
+ * @param[out] ok Cleared when a nested container is malformed
+ *
+ * @return true if the value had the type of the field
+ */
+static bool scan_store(const JsonToken *value, const FieldDesc *field,
+                       void *dst, bool *ok) {
+  uint8_t *ptr = (uint8_t *)dst + field->offset;
+  JsonScanner nested;
+  double timestamp;
+  int32_t centi;
+  bool flag;
+  char unit[8];
+
+  switch (field->type) {
+  case FIELD_NUMBER:
+    return value->type == JSON_SCAN_NUMBER &&
+           decimal_parse_float(value->start, value->len, (float *)ptr);
+
+  case FIELD_CENTI:
+    if (value->type != JSON_SCAN_NUMBER ||
+        !decimal_parse_fixed(value->start, value->len, 2, &centi)) {
+      return false;
+    }
+    *(int16_t *)ptr = centi < INT16_MIN   ? INT16_MIN
+                      : centi > INT16_MAX ? INT16_MAX
+                                          : centi;
+    return true;
+
+  case FIELD_TIMESTAMP:
+    if (!json_scan_number(value, &timestamp)) {
+      return false;
+    }
+    field_store_timestamp(ptr, timestamp);
+    return true;
+
+  case FIELD_FLAG:
+    if (!json_scan_bool(value, &flag)) {
+      return false;
+    }
+    field_store_flag(field, dst, flag);
+    return true;
+
+  case FIELD_UNIT:
+    if (!json_scan_string(value, unit, sizeof(unit))) {
+      return false;
+    }
+    *ptr = unit_lookup(unit, strlen(unit));
+    return true;
+
+  case FIELD_OBJECT:
+    if (value->type != JSON_SCAN_OBJECT) {
+      return false;
+    }
+    json_scan_enter(&nested, value);
+    *ok &= scan_fill(&nested, field->nested, dst);
+    return true;
+
+  case FIELD_DEVICES: {
+    if (value->type != JSON_SCAN_ARRAY) {
+      return false;
+    }
+    JsonToken element;
+    json_scan_enter(&nested, value);
+    while (json_scan_element(&nested, &element)) {
+      *ok &= scan_device(&element, field->nested, dst);
+    }
+    *ok &= !nested.error;
+    return true;
+  }
+  }
+  return false;
+}
+
+/**
+ * @brief Fill dst from the members the scanner walks, in a single pass
+ *
+ * @return false on malformed input
+ */
+static bool scan_fill(JsonScanner *scanner, FieldTable *table, void *dst) {
+  JsonToken key;
+  JsonToken value;
+  uint32_t found = 0;
+  bool ok = true;
+
+  while (json_scan_member(scanner, &key, &value)) {
+    const FieldDesc *field = field_lookup(table, scan_key(&key));
+    if (field && scan_store(&value, field, dst, &ok)) {
+      found |= 1u << (field - table->fields);
+    }
+  }
+  field_log_missing(table, found);
+  return ok && !scanner->error;
+}
+
+static bool scan_status_data(JsonScanner *root) {
+  JsonToken key;
+  JsonToken value;
+  char msg[256];
+
+  while (json_scan_member(root, &key, &value)) {
+    if (scan_key(&key) == JSON_KEY_MSG &&
+        json_scan_string(&value, msg, sizeof(msg))) {
+      add_text_to_status_list(msg);
+      return true;
+    }
+  }
+  return false;
+}
+
+static ParseReturnCode parse_json_fallback(const char *frame, size_t len,
+                                           AnemometerData *anm_data,
+                                           ParticulateMatterData *pm_data,
+                                           ImuData *imu_data) {
+  cjson_arena_begin();
+  cJSON *json = cJSON_ParseWithLength(frame, len);
+  if (!json) {
+    cjson_arena_end();
+    ESP_LOGW(TAG, "Invalid JSON frame (%u bytes)", (unsigned)len);
+    return PRC_PARSING_ERROR;
+  }
+  ParseReturnCode code = parse_data(json, anm_data, pm_data, imu_data);
+  cJSON_Delete(json);
+  cjson_arena_end();
+  return code;
+}
+
+/**
+ * @brief Parse a JSON frame in place
+ *
+ * Sensor samples and status messages are scanned straight from the frame into
+ * the data structures: no heap allocation and one pass over the members once
+ * the topic is known (the bridge serializes keys alphabetically, so "topic"
+ * usually comes last and is looked up first with a shallow scan). Other
+ * topics (hello, commands) and anything the scanner rejects go through
+ * cJSON and parse_data().
+ *
+ * @param[in] frame JSON document, NUL-terminated
+ * @param[in] len   Document length, without the terminator
+ */
+ParseReturnCode parse_json_frame(const char *frame, size_t len,
+                                 AnemometerData *anm_data,
+                                 ParticulateMatterData *pm_data,
+                                 ImuData *imu_data) {
+  JsonScanner root;
+  JsonToken key;
+  JsonToken value;
+  JsonToken topic = {0};
+
+  json_scan_object(&root, frame, len);
+  while (json_scan_member(&root, &key, &value)) {
+    if (scan_key(&key) == JSON_KEY_TOPIC) {
+      topic = value;
+    }
+  }
+  if (root.error || topic.type != JSON_SCAN_STRING) {
+    return parse_json_fallback(frame, len, anm_data, pm_data, imu_data);
+  }
+
+  json_scan_object(&root, frame, len);
+  switch (scan_key(&topic)) {
+  case JSON_KEY_ANM:
+    if (scan_fill(&root, &anemometer_table, anm_data))
+      return PRC_UPDATED_ANEMOMETER;
+    break;
+  case JSON_KEY_SPS:
+    if (scan_fill(&root, &pm_table, pm_data))
+      return PRC_UPDATE_PARTICULATE_MATTER;
+    break;
+  case JSON_KEY_IMU:
+    if (scan_fill(&root, &imu_table, imu_data))
+      return PRC_UPDATE_IMU;
+    break;
+  case JSON_KEY_STATUS:
+    if (scan_status_data(&root))
+      return PRC_STATUS;
+    break;
+  default:
+    break;
+  }
+
+  return parse_json_fallback(frame, len, anm_data, pm_data, imu_data);
+}
+
+/**
+ * @brief Record a batched sample the caller will not see
+ *
+ * on_parse_result() records the last sample of a batch with the others.
+ */
+static void record_batched(uint8_t type, const AnemometerData *anm_data,
+                           const ParticulateMatterData *pm_data,
+                           const ImuData *imu_data) {
+  switch (type) {
+  case FRAME_ANEMOMETER:
+    history_record_anemometer(anm_data);
+    wind_stats_add(anm_data);
+    sample_log_anemometer(anm_data);
+    break;
+  case FRAME_PARTICULATE_MATTER:
+    history_record_particulate_matter(pm_data);
+    pm_stats_add(pm_data);
+    sample_log_particulate_matter(pm_data);
+    break;
+  case FRAME_IMU:
+    history_record_imu(imu_data);
+    sample_log_imu(imu_data);
+    break;
+  }
+}
+
+/**
+ * @brief Ingest a batch of anemometer samples, WIND_VECTOR_CHUNK at a time
+ *
+ * Each chunk is decoded first so that the wind vectors of all its samples
+ * are derived in one call. Each sample starts from the one before it, the
+ * first from anm_data, and the last sample is left in anm_data.
+ */
+static void parse_anemometer_batch(const uint8_t *sample, size_t sample_len,
+                                   uint8_t count, AnemometerData *anm_data) {
+  AnemometerData chunk[WIND_VECTOR_CHUNK];
+
+  for (size_t first = 0; first < count; first += WIND_VECTOR_CHUNK) {
+    size_t n = count - first < WIND_VECTOR_CHUNK ? count - first
+                                                 : WIND_VECTOR_CHUNK;
+    for (size_t i = 0; i < n; i++, sample += sample_len) {
+      // Fields a sample omits keep their previous value
+      chunk[i] = i ? chunk[i - 1] : *anm_data;
+      proto_decode_anemometer(sample, sample_len, &chunk[i]);
+    }
+    wind_vector_compute(chunk, n);
+    for (size_t i = 0; i < n; i++) {
+      if (first + i + 1 < count) {
+        record_batched(FRAME_ANEMOMETER, &chunk[i], NULL, NULL);
+      }
+    }
+    *anm_data = chunk[n - 1];
+  }
+}
+
+/**
+ * @brief Ingest every sample of a batch, in order, in a single pass
+ *
+ * The caller refreshes the UI once for the whole batch; every sample goes to
+ * the history and the wind statistics.
+ */
+static ParseReturnCode parse_binary_batch(const uint8_t *payload, size_t len,
+                                          AnemometerData *anm_data,
+                                          ParticulateMatterData *pm_data,
+                                          ImuData *imu_data) {
+  uint8_t type;
+  uint8_t count;
+  const uint8_t *sample;
+
+  if (!proto_unpack_batch(payload, len, &type, &count, &sample) ||
+      count == 0) {
+    return PRC_PARSING_ERROR;
+  }
+
+  size_t sample_len = proto_sample_len(type);
+  if (type == FRAME_ANEMOMETER) {
+    parse_anemometer_batch(sample, sample_len, count, anm_data);
+    return PRC_UPDATED_ANEMOMETER;
+  }
+
+  for (uint8_t i = 0; i < count; i++, sample += sample_len) {
+    switch (type) {
+    case FRAME_PARTICULATE_MATTER:
+      proto_decode_particulate_matter(sample, sample_len, pm_data);
+      break;
+    case FRAME_IMU:
+      proto_decode_imu(sample, sample_len, imu_data);
+      break;
+    }
+    if (i + 1 < count) {
+      record_batched(type, anm_data, pm_data, imu_data);
+    }
+  }
+
+  return type == FRAME_PARTICULATE_MATTER ? PRC_UPDATE_PARTICULATE_MATTER
+                                          : PRC_UPDATE_IMU;
+}
+
+ParseReturnCode parse_binary_data(uint8_t *frame, size_t len,
+                                  AnemometerData *anm_data,
+                                  ParticulateMatterData *pm_data,
+                                  ImuData *imu_data) {
+  static const char *TAG = "PARSE_DATA";
 
-  switch (parse_data(json, &anemometerData, &particulateMatterData, &imuData)) {
+  uint8_t type;
+  uint8_t *payload;
+  size_t payload_len;
+
+  if (!proto_unpack_frame(frame, len, &type, &payload, &payload_len)) {
+    return PRC_PARSING_ERROR;
+  }
+
+  switch (type) {
+  case FRAME_ANEMOMETER:
+    if (proto_decode_anemometer(payload, payload_len, anm_data))
+      return PRC_UPDATED_ANEMOMETER;
+    break;
+  case FRAME_PARTICULATE_MATTER:
+    if (proto_decode_particulate_matter(payload, payload_len, pm_data))
+      return PRC_UPDATE_PARTICULATE_MATTER;
+    break;
+  case FRAME_IMU:
+    if (proto_decode_imu(payload, payload_len, imu_data))
+      return PRC_UPDATE_IMU;
+    break;
+  case FRAME_BATCH:
+    return parse_binary_batch(payload, payload_len, anm_data, pm_data,
+                              imu_data);
+  case FRAME_STATUS:
+    add_text_to_status_list((const char *)payload);
+    return PRC_STATUS;
+  case FRAME_JSON:
+    return parse_json_frame((const char *)payload, payload_len, anm_data,
+                            pm_data, imu_data);
+  default:
+    ESP_LOGI(TAG, "Unknown frame type: 0x%02x", type);
+    break;
+  }
+
+  return PRC_PARSING_ERROR;
+}
+
+/**
+ * @brief Publish what a frame updated
+ *
+ * Runs in the RX task and never touches LVGL: the UI picks the samples up
+ * through the *_data_latest() functions, and they are appended to the
+ * history and the sample log. Anemometer samples get their wind vector first,
+ * and also feed the wind statistics; SPS30 samples feed the PM averages.
+ */
+static ParseReturnCode on_parse_result(ParseReturnCode code) {
+  switch (code) {
   case PRC_UPDATED_ANEMOMETER:
-    lvgl_update_anemometer_data(&anemometerData);
+    wind_vector_compute(&anemometerData, 1);
+    snapshot_publish(&anemometer_snapshot, &anemometerData);
+    history_record_anemometer(&anemometerData);
+    wind_stats_add(&anemometerData);
+    sample_log_anemometer(&anemometerData);
     break;
   case PRC_UPDATE_PARTICULATE_MATTER:
-    lvgl_update_particulate_matter_data(&particulateMatterData);
+    snapshot_publish(&particulate_matter_snapshot, &particulateMatterData);
+    history_record_particulate_matter(&particulateMatterData);
+    pm_stats_add(&particulateMatterData);
+    sample_log_particulate_matter(&particulateMatterData);
     break;
   case PRC_UPDATE_IMU:
-    lvgl_update_imu_data(&imuData);
+    snapshot_publish(&imu_snapshot, &imuData);
+    history_record_imu(&imuData);
+    sample_log_imu(&imuData);
     break;
   case PRC_STATUS:
+  case PRC_LINK:
     break;
   case PRC_PARSING_ERROR:
     ESP_LOGW(TAG, "Failed to parse data");
@@ -701,4 +926,20 @@ void on_json_received(cJSON *json) {
     ESP_LOGE(TAG, "WTF!");
     break;
   }
-}
\ No newline at end of file
+  return code;
+}
+
+ParseReturnCode on_json_received(cJSON *json) {
+  return on_parse_result(
+      parse_data(json, &anemometerData, &particulateMatterData, &imuData));
+}
+
+ParseReturnCode on_binary_received(uint8_t *frame, size_t len) {
+  return on_parse_result(parse_binary_data(frame, len, &anemometerData,
+                                           &particulateMatterData, &imuData));
+}
+
+ParseReturnCode on_json_frame_received(const char *frame, size_t len) {
+  return on_parse_result(parse_json_frame(frame, len, &anemometerData,
+                                          &particulateMatterData, &imuData));
+}
@@ -2,90 +2,128 @@
 
 #include "cJSON.h"
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
+/*
+ * Samples are converted once, when they are parsed: measurements are floats,
+ * the sonic temperatures hundredths of a degree, units interned to a Unit and
+ * the calibration flags packed into one byte. The UI and everything that keeps
+ * or aggregates samples works on these compact structs.
+ */
+
+// Measurement units, numbered like the unit codes of the binary protocol
+typedef enum {
+  UNIT_NONE,
+  UNIT_UG_M3,   // ug/m3
+  UNIT_PER_CM3, // #/cm3
+  UNIT_UM,      // um
+  UNIT_G,       // g
+  UNIT_M_S2,    // m/s2
+  UNIT_UT,      // uT
+  UNIT_DPS,     // dps
+  UNIT_RAD_S,   // rad/s
+  UNIT_MG,      // mg
+  UNIT_GAUSS,   // gauss
+  UNIT_COUNT,
+} Unit;
+
+// AnemometerData.flags, same bits as the binary frame
+#define ANM_AUTOCAL_ASSE_X (1u << 0)
+#define ANM_AUTOCAL_ASSE_Y (1u << 1)
+#define ANM_AUTOCAL_ASSE_Z (1u << 2)
+#define ANM_AUTOCAL_MISURA_X (1u << 3)
+#define ANM_AUTOCAL_MISURA_Y (1u << 4)
+#define ANM_AUTOCAL_MISURA_Z (1u << 5)
+
 typedef struct AnemometerData {
-  uint32_t timestamp;
-
-  double x_vout;
-  bool autocalibrazione_asse_x;
-  bool autocalibrazione_misura_x;
-  double temp_sonica_x;
-
-  double y_vout;
-  bool autocalibrazione_asse_y;
-  bool autocalibrazione_misura_y;
-  double temp_sonica_y;
-
-  double z_vout;
-  bool autocalibrazione_asse_z;
-  bool autocalibrazione_misura_z;
-  double temp_sonica_z;
-} AnemometerData;
+  uint32_t timestamp;    // seconds since the epoch
+  uint16_t timestamp_ms; // right after timestamp, see FIELD_TIMESTAMP
+
+  float x_vout;
+  float y_vout;
+  float z_vout;
+
+  // Not sent by the bridge, see wind_vector_compute()
+  float speed;     // horizontal, m/s
+  float speed_3d;  // m/s
+  float direction; // degrees, where the wind blows from
+
+  int16_t temp_sonica_x; // 0.01 C
+  int16_t temp_sonica_y;
+  int16_t temp_sonica_z;
 
-extern AnemometerData anemometerData;
+  uint8_t flags; // ANM_*
+} AnemometerData;
 
 typedef struct ParticulateMatterData {
-  uint32_t timestamp;
+  uint32_t timestamp;    // seconds since the epoch
+  uint16_t timestamp_ms; // right after timestamp, see FIELD_TIMESTAMP
 
-  double mass_density_pm_1_0;
-  double mass_density_pm_2_5;
-  double mass_density_pm_4_0;
-  double mass_density_pm_10;
+  float mass_density_pm_1_0;
+  float mass_density_pm_2_5;
+  float mass_density_pm_4_0;
+  float mass_density_pm_10;
 
-  double particle_count_0_5;
-  double particle_count_1_0;
-  double particle_count_2_5;
-  double particle_count_4_0;
-  double particle_count_10;
+  float particle_count_0_5;
+  float particle_count_1_0;
+  float particle_count_2_5;
+  float particle_count_4_0;
+  float particle_count_10;
 
-  double particle_size;
+  float particle_size;
 
-  char mass_density_unit[8];
-  char particle_count_unit[8];
-  char particle_size_unit[8];
+  uint8_t mass_density_unit; // Unit
+  uint8_t particle_count_unit;
+  uint8_t particle_size_unit;
 } ParticulateMatterData;
 
-extern ParticulateMatterData particulateMatterData;
-
 typedef struct ImuData {
-  double timestamp;
+  uint32_t timestamp;    // seconds since the epoch
+  uint16_t timestamp_ms; // right after timestamp, see FIELD_TIMESTAMP
 
-  double acc_top_x;
-  double acc_top_y;
-  double acc_top_z;
-  char acc_top_unit[8];
+  float acc_top_x;
+  float acc_top_y;
+  float acc_top_z;
 
-  double acc_x;
-  double acc_y;
-  double acc_z;
-  char acc_unit[8];
+  float acc_x;
+  float acc_y;
+  float acc_z;
 
-  double mag_x;
-  double mag_y;
-  double mag_z;
-  char mag_unit[8];
+  float mag_x;
+  float mag_y;
+  float mag_z;
 
-  double gyr_x;
-  double gyr_y;
-  double gyr_z;
-  char gyr_unit[8];
+  float gyr_x;
+  float gyr_y;
+  float gyr_z;
 
+  uint8_t acc_top_unit; // Unit
+  uint8_t acc_unit;
+  uint8_t mag_unit;
+  uint8_t gyr_unit;
 } ImuData;
 
-extern ImuData imuData;
-
 typedef enum {
   PRC_PARSING_ERROR,
   PRC_UPDATED_ANEMOMETER,
   PRC_UPDATE_PARTICULATE_MATTER,
   PRC_UPDATE_IMU,
   PRC_STATUS,
+  PRC_LINK,
 } ParseReturnCode;
 
+const char *unit_name(Unit unit);
+Unit unit_lookup(const char *name, size_t len);
+int16_t data_to_centi(float value);
+
 void anemometer_data_default(AnemometerData *anm_data);
 void particulate_matter_data_default(ParticulateMatterData *pm_data);
 void imu_data_default(ImuData *imu_data);
+
+bool anemometer_data_latest(const AnemometerData **anm_data);
+bool particulate_matter_data_latest(const ParticulateMatterData **pm_data);
+bool imu_data_latest(const ImuData **imu_data);
 bool parse_anemometer_data(cJSON *root, AnemometerData *anm_data);
 bool parse_particulate_matter_data(cJSON *root,
                                    ParticulateMatterData *sps_data);
@@ -94,4 +132,16 @@ bool parse_imu_data(cJSON *root, ImuData *imu_data);
 ParseReturnCode parse_data(cJSON *json, AnemometerData *anm_data,
                            ParticulateMatterData *pm_data, ImuData *imu_data);
 
-void on_json_received(cJSON *json);
\ No newline at end of file
+ParseReturnCode parse_json_frame(const char *frame, size_t len,
+                                 AnemometerData *anm_data,
+                                 ParticulateMatterData *pm_data,
+                                 ImuData *imu_data);
+
+ParseReturnCode parse_binary_data(uint8_t *frame, size_t len,
+                                  AnemometerData *anm_data,
+                                  ParticulateMatterData *pm_data,
+                                  ImuData *imu_data);
+
+ParseReturnCode on_json_received(cJSON *json);
+ParseReturnCode on_binary_received(uint8_t *frame, size_t len);
+ParseReturnCode on_json_frame_received(const char *frame, size_t len);
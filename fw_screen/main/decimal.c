@@ -0,0 +1,357 @@
+#include "decimal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Longest number the strtod() fallback copies to terminate it
+#define DECIMAL_FALLBACK_MAX 64
+
+/*
+ * Powers of ten that are exact in binary. A mantissa that fits the
+ * significand multiplied or divided by one of them is correctly rounded, so
+ * the fast paths below give the same result as strtod() / strtof().
+ */
+static const double pow10_double[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+static const float pow10_float[] = {
+    1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f,
+};
+static const uint32_t pow10_u32[] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000,
+};
+static const uint64_t pow10_u64[] = {
+    1ull,
+    10ull,
+    100ull,
+    1000ull,
+    10000ull,
+    100000ull,
+    1000000ull,
+    10000000ull,
+    100000000ull,
+    1000000000ull,
+    10000000000ull,
+    100000000000ull,
+    1000000000000ull,
+    10000000000000ull,
+    100000000000000ull,
+    1000000000000000ull,
+    10000000000000000ull,
+    100000000000000000ull,
+    1000000000000000000ull,
+    10000000000000000000ull,
+};
+
+typedef struct {
+  uint64_t mantissa;
+  int exponent; // value = mantissa * 10^exponent
+  bool negative;
+  bool exact; // mantissa holds every significant digit
+} DecimalParts;
+
+static bool decimal_split(const char *str, size_t len, DecimalParts *parts) {
+  const char *p = str;
+  const char *end = str + len;
+  int digits = 0;
+  int significant = 0;
+
+  *parts = (DecimalParts){.exact = true};
+
+  if (p < end && (*p == '-' || *p == '+')) {
+    parts->negative = *p++ == '-';
+  }
+
+  for (bool fraction = false; p < end; p++) {
+    if (*p == '.' && !fraction) {
+      fraction = true;
+      continue;
+    }
+    if (*p < '0' || *p > '9') {
+      break;
+    }
+    digits++;
+    if (significant == 0 && *p == '0') {
+      parts->exponent -= fraction;
+      continue;
+    }
+    if (significant < 19) {
+      parts->mantissa = parts->mantissa * 10 + (*p - '0');
+      parts->exponent -= fraction;
+      significant++;
+    } else {
+      parts->exact &= *p == '0';
+      parts->exponent += !fraction;
+    }
+  }
+  if (digits == 0) {
+    return false;
+  }
+
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    bool negative = false;
+    int exponent = 0;
+
+    p++;
+    if (p < end && (*p == '-' || *p == '+')) {
+      negative = *p++ == '-';
+    }
+    if (p == end || *p < '0' || *p > '9') {
+      return false;
+    }
+    for (; p < end && *p >= '0' && *p <= '9'; p++) {
+      if (exponent < 10000) {
+        exponent = exponent * 10 + (*p - '0');
+      }
+    }
+    parts->exponent += negative ? -exponent : exponent;
+  }
+  return p == end;
+}
+
+/**
+ * @brief Slow path, str is not NUL-terminated
+ */
+static bool decimal_strtod(const char *str, size_t len, double *value) {
+  char buffer[DECIMAL_FALLBACK_MAX];
+  if (len >= sizeof(buffer)) {
+    return false;
+  }
+  memcpy(buffer, str, len);
+  buffer[len] = '\0';
+
+  char *end;
+  double result = strtod(buffer, &end);
+  if (end != buffer + len) {
+    return false;
+  }
+  *value = result;
+  return true;
+}
+
+static bool decimal_strtof(const char *str, size_t len, float *value) {
+  char buffer[DECIMAL_FALLBACK_MAX];
+  if (len >= sizeof(buffer)) {
+    return false;
+  }
+  memcpy(buffer, str, len);
+  buffer[len] = '\0';
+
+  char *end;
+  float result = strtof(buffer, &end);
+  if (end != buffer + len) {
+    return false;
+  }
+  *value = result;
+  return true;
+}
+
+/**
+ * @brief Convert a decimal number, value is left untouched on failure
+ *
+ * @param[in] str Number, does not need to be NUL-terminated
+ * @param[in] len Length of the number, trailing characters are an error
+ */
+bool decimal_parse(const char *str, size_t len, double *value) {
+  DecimalParts parts;
+  if (!decimal_split(str, len, &parts)) {
+    return false;
+  }
+
+  if (parts.exact && parts.mantissa <= (1ull << 53) &&
+      parts.exponent >= -22 && parts.exponent <= 22) {
+    double result = (double)parts.mantissa;
+    if (parts.exponent < 0) {
+      result /= pow10_double[-parts.exponent];
+    } else {
+      result *= pow10_double[parts.exponent];
+    }
+    *value = parts.negative ? -result : result;
+    return true;
+  }
+  return decimal_strtod(str, len, value);
+}
+
+/**
+ * @brief Single-precision decimal_parse(), rounded once like strtof()
+ */
+bool decimal_parse_float(const char *str, size_t len, float *value) {
+  DecimalParts parts;
+  if (!decimal_split(str, len, &parts)) {
+    return false;
+  }
+
+  if (parts.exact && parts.mantissa <= (1u << 24) &&
+      parts.exponent >= -10 && parts.exponent <= 10) {
+    float result = (float)parts.mantissa;
+    if (parts.exponent < 0) {
+      result /= pow10_float[-parts.exponent];
+    } else {
+      result *= pow10_float[parts.exponent];
+    }
+    *value = parts.negative ? -result : result;
+    return true;
+  }
+  return decimal_strtof(str, len, value);
+}
+
+/**
+ * @brief Convert a decimal number to a scaled integer, value * 10^frac
+ *
+ * Digits beyond frac are rounded half away from zero, without going through
+ * floating point.
+ *
+ * @return false on malformed input or if the result does not fit an int32_t;
+ *         value is left untouched
+ */
+bool decimal_parse_fixed(const char *str, size_t len, uint8_t frac,
+                         int32_t *value) {
+  DecimalParts parts;
+  if (!decimal_split(str, len, &parts)) {
+    return false;
+  }
+
+  uint64_t limit = (uint64_t)INT32_MAX + parts.negative;
+  uint64_t magnitude = parts.mantissa;
+  int shift = parts.exponent + frac;
+
+  if (shift >= 0) {
+    for (; shift > 0 && magnitude != 0; shift--) {
+      if (magnitude > limit / 10) {
+        return false;
+      }
+      magnitude *= 10;
+    }
+  } else if (shift < -19) {
+    magnitude = 0;
+  } else {
+    uint64_t divisor = pow10_u64[-shift];
+    uint64_t rest = magnitude % divisor;
+    magnitude /= divisor;
+    if (rest >= divisor - rest) {
+      magnitude++;
+    }
+  }
+
+  if (magnitude > limit) {
+    return false;
+  }
+  *value = parts.negative ? (int32_t)-(int64_t)magnitude : (int32_t)magnitude;
+  return true;
+}
+
+static size_t decimal_write(char *dst, size_t size, bool negative,
+                            uint32_t integer, uint32_t fraction,
+                            uint8_t frac) {
+  char buffer[24];
+  char *p = buffer + sizeof(buffer);
+
+  if (size == 0) {
+    return 0;
+  }
+
+  for (uint8_t i = 0; i < frac; i++) {
+    *--p = '0' + fraction % 10;
+    fraction /= 10;
+  }
+  if (frac > 0) {
+    *--p = '.';
+  }
+  do {
+    *--p = '0' + integer % 10;
+    integer /= 10;
+  } while (integer > 0);
+  if (negative) {
+    *--p = '-';
+  }
+
+  size_t len = buffer + sizeof(buffer) - p;
+  if (len > size - 1) {
+    len = size - 1;
+  }
+  memcpy(dst, p, len);
+  dst[len] = '\0';
+  return len;
+}
+
+/**
+ * @brief Format a scaled integer, value / 10^frac with frac decimals
+ *
+ * The output is truncated to size - 1 bytes and always NUL-terminated.
+ *
+ * @return Number of characters written, without the terminator
+ */
+size_t decimal_format(char *dst, size_t size, int32_t value, uint8_t frac) {
+  if (frac > DECIMAL_MAX_FRAC) {
+    frac = DECIMAL_MAX_FRAC;
+  }
+
+  uint32_t magnitude = value < 0 ? -(uint32_t)value : (uint32_t)value;
+  return decimal_write(dst, size, value < 0, magnitude / pow10_u32[frac],
+                       magnitude % pow10_u32[frac], frac);
+}
+
+/**
+ * @brief Format a float with frac decimals, like "%.*f"
+ *
+ * The float is split into its binary mantissa and exponent and the fraction
+ * is scaled in 64-bit integer arithmetic, so the digits are exact and exact
+ * ties round to even as in printf. Values of 2^32 and above, infinities and
+ * NaN go through snprintf().
+ *
+ * @return Number of characters written, without the terminator
+ */
+size_t decimal_format_float(char *dst, size_t size, float value,
+                            uint8_t frac) {
+  if (frac > DECIMAL_MAX_FRAC) {
+    frac = DECIMAL_MAX_FRAC;
+  }
+
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  bool negative = bits >> 31;
+  int exponent = (bits >> 23) & 0xff;
+  uint64_t mantissa = bits & 0x7fffff;
+
+  if (exponent == 0) {
+    exponent = 1; // subnormal
+  } else {
+    mantissa |= 0x800000;
+  }
+
+  // value = mantissa * 2^-shift
+  int shift = 150 - exponent;
+  uint32_t integer = 0;
+  uint32_t fraction = 0;
+  uint32_t scale = pow10_u32[frac];
+
+  if (shift < -8) {
+    // 2^32 and above, infinities and NaN
+    int len = snprintf(dst, size, "%.*f", frac, (double)value);
+    if (len < 0 || size == 0) {
+      return 0;
+    }
+    return (size_t)len < size ? (size_t)len : size - 1;
+  } else if (shift <= 0) {
+    integer = mantissa << -shift;
+  } else if (shift < 64) {
+    uint64_t mask = (1ull << shift) - 1;
+    uint64_t scaled = (mantissa & mask) * scale; // below 2^44
+    uint64_t rest = scaled & mask;
+    uint64_t half = 1ull << (shift - 1);
+
+    integer = mantissa >> shift;
+    fraction = scaled >> shift;
+    uint32_t last = frac ? fraction : integer; // holds the last digit
+    if (rest > half || (rest == half && (last & 1))) {
+      fraction++;
+    }
+    if (fraction >= scale) {
+      fraction -= scale;
+      integer++;
+    }
+  } // else below 2^-40, which rounds to zero
+
+  return decimal_write(dst, size, negative, integer, fraction, frac);
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Decimal number parsing and formatting without double-precision math.
+ *
+ * The bridge sends plain decimals with a handful of fractional digits and the
+ * UI shows them with a fixed precision per field. Both directions are done in
+ * integer arithmetic on the mantissa: parsing ends with a single floating
+ * point multiply or divide, formatting uses none at all. Anything outside the
+ * fast paths (more than 19 significant digits, large exponents, values of 2^32
+ * and above) falls back to strtod() / snprintf(), and both directions give
+ * the same result as the C library.
+ *
+ * tools/bench_decimal.c compares both against the C library on the host.
+ */
+
+// Largest precision decimal_format() and decimal_format_float() accept
+#define DECIMAL_MAX_FRAC 6
+
+bool decimal_parse(const char *str, size_t len, double *value);
+bool decimal_parse_float(const char *str, size_t len, float *value);
+bool decimal_parse_fixed(const char *str, size_t len, uint8_t frac,
+                         int32_t *value);
+
+size_t decimal_format(char *dst, size_t size, int32_t value, uint8_t frac);
+size_t decimal_format_float(char *dst, size_t size, float value, uint8_t frac);
@@ -0,0 +1,337 @@
+#include "history.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <inttypes.h>
+#include <string.h>
+
+#if CONFIG_SCREEN_HISTORY
+
+static const char *TAG = "HISTORY";
+
+#define HISTORY_MAX_CHANNELS HISTORY_IMU_CHANNELS
+
+// Bucket in a tier ring, followed by min[channels], max[], mean[]
+typedef struct {
+  uint32_t start;
+  uint32_t count;
+} HistoryBucket;
+
+typedef struct {
+  uint8_t *entries;
+  size_t entry_size;
+  uint32_t capacity;
+  uint32_t head; // next entry to write
+  uint32_t count;
+} HistoryRing;
+
+typedef struct {
+  const char *name;
+  size_t sample_size;
+  size_t channels;
+  uint32_t raw_capacity;
+  void (*extract)(const void *sample, float *values);
+
+  SemaphoreHandle_t lock;
+  HistoryRing raw;
+  HistoryRing tiers[HISTORY_TIER_COUNT];
+} HistorySeries;
+
+static const uint32_t tier_span[HISTORY_TIER_COUNT] = {1, 60, 15 * 60};
+static const uint32_t tier_capacity[HISTORY_TIER_COUNT] = {
+    CONFIG_SCREEN_HISTORY_SECOND_BUCKETS,
+    CONFIG_SCREEN_HISTORY_MINUTE_BUCKETS,
+    CONFIG_SCREEN_HISTORY_QUARTER_BUCKETS,
+};
+
+static void anemometer_extract(const void *sample, float *values) {
+  const AnemometerData *anm_data = sample;
+  values[0] = anm_data->x_vout;
+  values[1] = anm_data->y_vout;
+  values[2] = anm_data->z_vout;
+  values[3] = anm_data->speed;
+  values[4] = anm_data->speed_3d;
+  values[5] = anm_data->temp_sonica_x / 100.0f;
+  values[6] = anm_data->temp_sonica_y / 100.0f;
+  values[7] = anm_data->temp_sonica_z / 100.0f;
+}
+
+static void particulate_matter_extract(const void *sample, float *values) {
+  const ParticulateMatterData *pm_data = sample;
+  memcpy(values, &pm_data->mass_density_pm_1_0,
+         HISTORY_PARTICULATE_MATTER_CHANNELS * sizeof(float));
+}
+
+static void imu_extract(const void *sample, float *values) {
+  const ImuData *imu_data = sample;
+  memcpy(values, &imu_data->acc_top_x, HISTORY_IMU_CHANNELS * sizeof(float));
+}
+
+// The memcpy() extractors rely on the channels being consecutive floats
+_Static_assert(offsetof(ParticulateMatterData, particle_size) -
+                       offsetof(ParticulateMatterData, mass_density_pm_1_0) ==
+                   (HISTORY_PARTICULATE_MATTER_CHANNELS - 1) * sizeof(float),
+               "ParticulateMatterData channels are not consecutive");
+_Static_assert(offsetof(ImuData, gyr_z) - offsetof(ImuData, acc_top_x) ==
+                   (HISTORY_IMU_CHANNELS - 1) * sizeof(float),
+               "ImuData channels are not consecutive");
+// history_raw() reads the timestamp of a sample at its start
+_Static_assert(offsetof(AnemometerData, timestamp) == 0 &&
+                   offsetof(ParticulateMatterData, timestamp) == 0 &&
+                   offsetof(ImuData, timestamp) == 0,
+               "timestamp must be the first member");
+
+#define RAW_CAPACITY(rate_hz) (CONFIG_SCREEN_HISTORY_RAW_SECONDS * (rate_hz))
+
+static HistorySeries series[HISTORY_SENSOR_COUNT] = {
+    [HISTORY_ANEMOMETER] = {"anemometer", sizeof(AnemometerData),
+                            HISTORY_ANEMOMETER_CHANNELS,
+                            RAW_CAPACITY(CONFIG_SCREEN_HISTORY_RAW_RATE_HZ),
+                            anemometer_extract},
+    [HISTORY_PARTICULATE_MATTER] = {"sps30", sizeof(ParticulateMatterData),
+                                    HISTORY_PARTICULATE_MATTER_CHANNELS,
+                                    RAW_CAPACITY(1), // measures at 1 Hz
+                                    particulate_matter_extract},
+    [HISTORY_IMU] = {"imu", sizeof(ImuData), HISTORY_IMU_CHANNELS,
+                     RAW_CAPACITY(CONFIG_SCREEN_HISTORY_RAW_RATE_HZ),
+                     imu_extract},
+};
+
+static bool ring_alloc(HistoryRing *ring, size_t entry_size,
+                       uint32_t capacity) {
+  ring->entries = heap_caps_malloc((size_t)capacity * entry_size,
+                                   MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+  ring->entry_size = entry_size;
+  ring->capacity = capacity;
+  ring->head = 0;
+  ring->count = 0;
+  return ring->entries != NULL;
+}
+
+static uint8_t *ring_at(const HistoryRing *ring, uint32_t index) {
+  // index 0 is the oldest entry
+  uint32_t slot = ring->head + ring->capacity - ring->count + index;
+  return ring->entries + (size_t)(slot % ring->capacity) * ring->entry_size;
+}
+
+static uint8_t *ring_push(HistoryRing *ring) {
+  uint8_t *entry = ring->entries + (size_t)ring->head * ring->entry_size;
+  ring->head = (ring->head + 1) % ring->capacity;
+  if (ring->count < ring->capacity) {
+    ring->count++;
+  }
+  return entry;
+}
+
+/**
+ * @brief First entry whose time is at least from, entries are sorted
+ */
+static uint32_t ring_lower_bound(const HistoryRing *ring, size_t time_offset,
+                                 uint32_t from) {
+  uint32_t low = 0;
+  uint32_t high = ring->count;
+  while (low < high) {
+    uint32_t middle = low + (high - low) / 2;
+    uint32_t time;
+    memcpy(&time, ring_at(ring, middle) + time_offset, sizeof(time));
+    if (time < from) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  return low;
+}
+
+static void tier_add(HistoryRing *ring, uint32_t span, size_t channels,
+                     uint32_t timestamp, const float *values) {
+  uint32_t start = timestamp - timestamp % span;
+  HistoryBucket *bucket = NULL;
+
+  if (ring->count > 0) {
+    bucket = (HistoryBucket *)ring_at(ring, ring->count - 1);
+    if (start > bucket->start) {
+      bucket = NULL;
+    }
+  }
+
+  if (!bucket) {
+    bucket = (HistoryBucket *)ring_push(ring);
+    bucket->start = start;
+    bucket->count = 0;
+  }
+
+  float *min = (float *)(bucket + 1);
+  float *max = min + channels;
+  float *mean = max + channels;
+  bucket->count++;
+  for (size_t i = 0; i < channels; i++) {
+    if (bucket->count == 1) {
+      min[i] = max[i] = mean[i] = values[i];
+      continue;
+    }
+    min[i] = values[i] < min[i] ? values[i] : min[i];
+    max[i] = values[i] > max[i] ? values[i] : max[i];
+    mean[i] += (values[i] - mean[i]) / bucket->count;
+  }
+}
+
+/**
+ * @brief Allocate every ring, once at start up
+ *
+ * A series whose rings do not fit is left disabled and logged.
+ */
+void history_init(void) {
+  for (size_t s = 0; s < HISTORY_SENSOR_COUNT; s++) {
+    HistorySeries *h = &series[s];
+    size_t bucket_size =
+        sizeof(HistoryBucket) + 3 * h->channels * sizeof(float);
+    bool ok = ring_alloc(&h->raw, h->sample_size, h->raw_capacity);
+    size_t bytes = (size_t)h->raw_capacity * h->sample_size;
+
+    for (size_t t = 0; t < HISTORY_TIER_COUNT; t++) {
+      ok &= ring_alloc(&h->tiers[t], bucket_size, tier_capacity[t]);
+      bytes += (size_t)tier_capacity[t] * bucket_size;
+    }
+
+    if (!ok) {
+      ESP_LOGE(TAG, "No PSRAM for the %s history (%u bytes)", h->name,
+               (unsigned)bytes);
+      heap_caps_free(h->raw.entries);
+      for (size_t t = 0; t < HISTORY_TIER_COUNT; t++) {
+        heap_caps_free(h->tiers[t].entries);
+      }
+      continue;
+    }
+    h->lock = xSemaphoreCreateMutex();
+    ESP_LOGI(TAG, "%s: %" PRIu32 " samples, %u bytes", h->name,
+             h->raw_capacity, (unsigned)bytes);
+  }
+}
+
+static void history_record(HistorySensor sensor, const void *sample,
+                           uint32_t timestamp) {
+  HistorySeries *h = &series[sensor];
+  float values[HISTORY_MAX_CHANNELS];
+
+  if (!h->lock) {
+    return;
+  }
+  h->extract(sample, values);
+
+  xSemaphoreTake(h->lock, portMAX_DELAY);
+  memcpy(ring_push(&h->raw), sample, h->sample_size);
+  for (size_t t = 0; t < HISTORY_TIER_COUNT; t++) {
+    tier_add(&h->tiers[t], tier_span[t], h->channels, timestamp, values);
+  }
+  xSemaphoreGive(h->lock);
+}
+
+void history_record_anemometer(const AnemometerData *anm_data) {
+  history_record(HISTORY_ANEMOMETER, anm_data, anm_data->timestamp);
+}
+
+void history_record_particulate_matter(const ParticulateMatterData *pm_data) {
+  history_record(HISTORY_PARTICULATE_MATTER, pm_data, pm_data->timestamp);
+}
+
+void history_record_imu(const ImuData *imu_data) {
+  history_record(HISTORY_IMU, imu_data, imu_data->timestamp);
+}
+
+/**
+ * @brief Copy the newest sample of a sensor, in O(1)
+ *
+ * @param[out] sample The sensor's struct, e.g. AnemometerData
+ *
+ * @return false if nothing was recorded yet
+ */
+bool history_latest(HistorySensor sensor, void *sample) {
+  HistorySeries *h = &series[sensor];
+  bool found = false;
+
+  if (!h->lock) {
+    return false;
+  }
+  xSemaphoreTake(h->lock, portMAX_DELAY);
+  if (h->raw.count > 0) {
+    memcpy(sample, ring_at(&h->raw, h->raw.count - 1), h->sample_size);
+    found = true;
+  }
+  xSemaphoreGive(h->lock);
+  return found;
+}
+
+/**
+ * @brief Copy the raw samples with a timestamp in [from, to], oldest first
+ *
+ * Assumes sample timestamps do not go backwards; the start is found by
+ * bisection.
+ *
+ * @return Number of samples copied, at most max
+ */
+size_t history_raw(HistorySensor sensor, uint32_t from, uint32_t to,
+                   void *samples, size_t max) {
+  HistorySeries *h = &series[sensor];
+  size_t copied = 0;
+
+  if (!h->lock) {
+    return 0;
+  }
+  xSemaphoreTake(h->lock, portMAX_DELAY);
+  for (uint32_t i = ring_lower_bound(&h->raw, 0, from);
+       i < h->raw.count && copied < max; i++) {
+    const uint8_t *sample = ring_at(&h->raw, i);
+    uint32_t timestamp;
+    memcpy(&timestamp, sample, sizeof(timestamp));
+    if (timestamp > to) {
+      break;
+    }
+    memcpy((uint8_t *)samples + copied * h->sample_size, sample,
+           h->sample_size);
+    copied++;
+  }
+  xSemaphoreGive(h->lock);
+  return copied;
+}
+
+/**
+ * @brief Copy one channel of the buckets starting in [from, to], oldest first
+ *
+ * @param[in] channel See HISTORY_*_CHANNELS
+ *
+ * @return Number of points copied, at most max
+ */
+size_t history_buckets(HistorySensor sensor, HistoryTier tier, size_t channel,
+                       uint32_t from, uint32_t to, HistoryPoint *points,
+                       size_t max) {
+  HistorySeries *h = &series[sensor];
+  HistoryRing *ring = &h->tiers[tier];
+  size_t copied = 0;
+
+  if (!h->lock || channel >= h->channels) {
+    return 0;
+  }
+  xSemaphoreTake(h->lock, portMAX_DELAY);
+  for (uint32_t i = ring_lower_bound(ring, offsetof(HistoryBucket, start),
+                                     from);
+       i < ring->count && copied < max; i++) {
+    const HistoryBucket *bucket = (const HistoryBucket *)ring_at(ring, i);
+    const float *min = (const float *)(bucket + 1);
+    if (bucket->start > to) {
+      break;
+    }
+    points[copied++] = (HistoryPoint){
+        .start = bucket->start,
+        .count = bucket->count,
+        .min = min[channel],
+        .max = min[h->channels + channel],
+        .mean = min[2 * h->channels + channel],
+    };
+  }
+  xSemaphoreGive(h->lock);
+  return copied;
+}
+
+#endif
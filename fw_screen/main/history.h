@@ -0,0 +1,96 @@
+#pragma once
+
+#include "data.h"
+#include "sdkconfig.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Bounded per-sensor sample history in PSRAM.
+ *
+ * Each sensor keeps a ring of its raw samples, as parsed, and three rings of
+ * buckets with the min, max and mean of every channel over 1 s, 1 min and
+ * 15 min. Buckets are updated in place as samples arrive, so recording is
+ * O(1) and the tiers never need a pass over the raw samples. Every ring is
+ * sized from Kconfig and allocated once by history_init(); when full the
+ * oldest entry is overwritten.
+ *
+ * Buckets follow the sample timestamps, which come from the bridge clock: a
+ * sample older than the current bucket is folded into it, gaps in the data
+ * leave no empty buckets. The RX task records, any task can query.
+ *
+ * Without CONFIG_SCREEN_HISTORY every call is a no-op that finds nothing.
+ */
+
+typedef enum {
+  HISTORY_ANEMOMETER,
+  HISTORY_PARTICULATE_MATTER,
+  HISTORY_IMU,
+  HISTORY_SENSOR_COUNT,
+} HistorySensor;
+
+typedef enum {
+  HISTORY_TIER_SECOND,
+  HISTORY_TIER_MINUTE,
+  HISTORY_TIER_QUARTER, // 15 minutes
+  HISTORY_TIER_COUNT,
+} HistoryTier;
+
+/*
+ * Channels of each sensor, in the order of their struct members. The
+ * anemometer temperatures are in degrees, not hundredths. The wind direction
+ * has no bucket channel, a mean of angles would be wrong across north; it is
+ * in the raw samples.
+ */
+#define HISTORY_ANEMOMETER_CHANNELS 8 // x/y/z_vout, speed, speed_3d, temp x/y/z
+#define HISTORY_PARTICULATE_MATTER_CHANNELS 10 // mass density, count, size
+#define HISTORY_IMU_CHANNELS 12                // acc_top, acc, mag, gyr x/y/z
+
+typedef struct HistoryPoint {
+  uint32_t start; // bucket start, seconds since the epoch
+  uint32_t count; // samples in the bucket
+  float min;
+  float max;
+  float mean;
+} HistoryPoint;
+
+#if CONFIG_SCREEN_HISTORY
+
+void history_init(void);
+
+void history_record_anemometer(const AnemometerData *anm_data);
+void history_record_particulate_matter(const ParticulateMatterData *pm_data);
+void history_record_imu(const ImuData *imu_data);
+
+bool history_latest(HistorySensor sensor, void *sample);
+size_t history_raw(HistorySensor sensor, uint32_t from, uint32_t to,
+                   void *samples, size_t max);
+size_t history_buckets(HistorySensor sensor, HistoryTier tier, size_t channel,
+                       uint32_t from, uint32_t to, HistoryPoint *points,
+                       size_t max);
+
+#else
+
+static inline void history_init(void) {}
+
+static inline void history_record_anemometer(const AnemometerData *anm_data) {}
+static inline void
+history_record_particulate_matter(const ParticulateMatterData *pm_data) {}
+static inline void history_record_imu(const ImuData *imu_data) {}
+
+static inline bool history_latest(HistorySensor sensor, void *sample) {
+  return false;
+}
+static inline size_t history_raw(HistorySensor sensor, uint32_t from,
+                                 uint32_t to, void *samples, size_t max) {
+  return 0;
+}
+static inline size_t history_buckets(HistorySensor sensor, HistoryTier tier,
+                                     size_t channel, uint32_t from,
+                                     uint32_t to, HistoryPoint *points,
+                                     size_t max) {
+  return 0;
+}
+
+#endif
@@ -0,0 +1,58 @@
+#include "data.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "host_ui.h"
+#include "transport.h"
+#include <inttypes.h>
+
+static const char *TAG = "HOST";
+
+/*
+ * Linux target entry point: the data link without the display, to run the
+ * bridge against and measure the ingest path on a workstation.
+ */
+void app_main(void) {
+  TransportStats last = {0};
+
+  transport_init();
+
+  while (1) {
+    vTaskDelay(pdMS_TO_TICKS(1000));
+
+    const AnemometerData *anm_data;
+    const ParticulateMatterData *pm_data;
+    const ImuData *imu_data;
+    const WindStats *wind_stats;
+    const PmStats *pm_stats;
+    if (anemometer_data_latest(&anm_data)) {
+      lvgl_update_anemometer_data(anm_data);
+    }
+    if (wind_stats_latest(&wind_stats)) {
+      lvgl_update_wind_stats(wind_stats);
+    }
+    if (particulate_matter_data_latest(&pm_data)) {
+      lvgl_update_particulate_matter_data(pm_data);
+    }
+    if (pm_stats_latest(&pm_stats)) {
+      lvgl_update_pm_stats(pm_stats);
+    }
+    if (imu_data_latest(&imu_data)) {
+      lvgl_update_imu_data(imu_data);
+    }
+
+    TransportStats stats;
+    transport_get_stats(&stats);
+    if (stats.rx_bytes == last.rx_bytes) {
+      continue;
+    }
+    ESP_LOGI(TAG,
+             "rx %" PRIu32 " B/s, %" PRIu32 " frames/s, invalid %" PRIu32
+             ", oversized %" PRIu32 ", superseded %" PRIu32
+             ", tx dropped %" PRIu32 " B",
+             stats.rx_bytes - last.rx_bytes, stats.frames - last.frames,
+             stats.invalid_frames, stats.oversized_frames,
+             stats.superseded_frames, stats.tx_dropped);
+    last = stats;
+  }
+}
@@ -0,0 +1,41 @@
+#include "host_ui.h"
+#include "esp_log.h"
+#include <inttypes.h>
+
+static const char *TAG = "HOST_UI";
+
+void lvgl_update_anemometer_data(const AnemometerData *anm_data) {
+  ESP_LOGD(TAG, "anm %" PRIu32 " x=%.3f y=%.3f z=%.3f speed=%.2f dir=%.0f",
+           anm_data->timestamp, anm_data->x_vout, anm_data->y_vout,
+           anm_data->z_vout, anm_data->speed, anm_data->direction);
+}
+
+void lvgl_update_wind_stats(const WindStats *stats) {
+  ESP_LOGD(TAG,
+           "wind %" PRIu32 " 2m=%.2f+/-%.2f gust=%.2f ti=%.2f 10m=%.2f+/-%.2f "
+           "ti=%.2f",
+           stats->timestamp, stats->short_window.mean, stats->short_window.std,
+           stats->short_window.gust, stats->short_window.turbulence,
+           stats->long_window.mean, stats->long_window.std,
+           stats->long_window.turbulence);
+}
+
+void lvgl_update_particulate_matter_data(const ParticulateMatterData *pm_data) {
+  ESP_LOGD(TAG, "sps %" PRIu32 " pm2.5=%.2f pm10=%.2f", pm_data->timestamp,
+           pm_data->mass_density_pm_2_5, pm_data->mass_density_pm_10);
+}
+
+void lvgl_update_pm_stats(const PmStats *stats) {
+  ESP_LOGD(TAG, "pm %" PRIu32 " 1h=%.1f/%.1f 24h=%.1f/%.1f aqi=%u",
+           stats->timestamp, stats->hour.pm_2_5, stats->hour.pm_10,
+           stats->day.pm_2_5, stats->day.pm_10, stats->aqi);
+}
+
+void lvgl_update_imu_data(const ImuData *imu_data) {
+  ESP_LOGD(TAG, "imu %" PRIu32 " acc=%.3f,%.3f,%.3f", imu_data->timestamp,
+           imu_data->acc_x, imu_data->acc_y, imu_data->acc_z);
+}
+
+void add_text_to_status_list(const char *text) {
+  ESP_LOGI(TAG, "status: %s", text);
+}
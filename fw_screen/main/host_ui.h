@@ -0,0 +1,18 @@
+#pragma once
+
+#include "data.h"
+#include "pm_stats.h"
+#include "wind_stats.h"
+
+/*
+ * Headless stand-ins for the lvgl_ui.h entry points, for the linux target
+ * build: host_main.c feeds them the published snapshots the way the LVGL
+ * refresh timer does.
+ */
+
+void lvgl_update_anemometer_data(const AnemometerData *anm_data);
+void lvgl_update_wind_stats(const WindStats *stats);
+void lvgl_update_particulate_matter_data(const ParticulateMatterData *pm_data);
+void lvgl_update_pm_stats(const PmStats *stats);
+void lvgl_update_imu_data(const ImuData *imu_data);
+void add_text_to_status_list(const char *text);
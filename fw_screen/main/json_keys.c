@@ -0,0 +1,140 @@
+// Generated by tools/gen_json_keys.py, do not edit.
+#include "json_keys.h"
+#include <stdint.h>
+#include <string.h>
+
+#define JSON_KEY_BUCKETS 22
+
+static const uint16_t displacement[JSON_KEY_BUCKETS] = {
+    7, 1, 6, 1, 2, 4, 59, 0,
+    5, 0, 5, 9, 1, 13, 0, 3,
+    0, 11, 41, 32, 12, 8,
+};
+
+static const JsonKey slots[JSON_KEY_COUNT - 1] = {
+    JSON_KEY_PARTICLE_SIZE_UNIT,
+    JSON_KEY_MAG,
+    JSON_KEY_Y,
+    JSON_KEY_STATUS,
+    JSON_KEY_TEMP_SONICA_Y,
+    JSON_KEY_TIMESTAMP,
+    JSON_KEY_AUTOCALIBRAZIONE_MISURA_X,
+    JSON_KEY_AUTOCALIBRAZIONE_MISURA_Y,
+    JSON_KEY_GYR,
+    JSON_KEY_Y_VOUT,
+    JSON_KEY_IMU,
+    JSON_KEY_UNIT,
+    JSON_KEY_X_VOUT,
+    JSON_KEY_TOPIC,
+    JSON_KEY_PARTICLE_COUNT,
+    JSON_KEY_AUTOCALIBRAZIONE_MISURA_Z,
+    JSON_KEY_TEMP_SONICA_X,
+    JSON_KEY_AUTOCALIBRAZIONE_ASSE_Y,
+    JSON_KEY_PM0_5,
+    JSON_KEY_PM10,
+    JSON_KEY_AUTOCALIBRAZIONE_ASSE_X,
+    JSON_KEY_TEMP_SONICA_Z,
+    JSON_KEY_MASS_DENSITY_UNIT,
+    JSON_KEY_TYPE,
+    JSON_KEY_MSG,
+    JSON_KEY_ANM,
+    JSON_KEY_PM1_0,
+    JSON_KEY_Z_VOUT,
+    JSON_KEY_Z,
+    JSON_KEY_PARTICLE_SIZE,
+    JSON_KEY_PM4_0,
+    JSON_KEY_SENSOR_DATA,
+    JSON_KEY_SPS,
+    JSON_KEY_DEV,
+    JSON_KEY_ACC,
+    JSON_KEY_PARTICLE_COUNT_UNIT,
+    JSON_KEY_AUTOCALIBRAZIONE_ASSE_Z,
+    JSON_KEY_PM2_5,
+    JSON_KEY_MASS_DENSITY,
+    JSON_KEY_ACCTOP,
+    JSON_KEY_HELLO,
+    JSON_KEY_LOG_EXPORT,
+    JSON_KEY_X,
+};
+
+static const char *const names[JSON_KEY_COUNT] = {
+    "",
+    "anm",
+    "sps",
+    "imu",
+    "status",
+    "hello",
+    "log_export",
+    "acctop",
+    "acc",
+    "mag",
+    "gyr",
+    "topic",
+    "type",
+    "msg",
+    "timestamp",
+    "sensor_data",
+    "x_vout",
+    "y_vout",
+    "z_vout",
+    "autocalibrazione_asse_x",
+    "autocalibrazione_asse_y",
+    "autocalibrazione_asse_z",
+    "autocalibrazione_misura_x",
+    "autocalibrazione_misura_y",
+    "autocalibrazione_misura_z",
+    "temp_sonica_x",
+    "temp_sonica_y",
+    "temp_sonica_z",
+    "mass_density",
+    "particle_count",
+    "particle_size",
+    "mass_density_unit",
+    "particle_count_unit",
+    "particle_size_unit",
+    "pm0.5",
+    "pm1.0",
+    "pm2.5",
+    "pm4.0",
+    "pm10",
+    "dev",
+    "unit",
+    "x",
+    "y",
+    "z",
+};
+
+static uint32_t json_key_hash(const char *key, size_t len, uint32_t seed) {
+  uint32_t h = 2166136261u ^ seed;
+  for (size_t i = 0; i < len; i++) {
+    h ^= (uint8_t)key[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+/**
+ * @brief Map a key to its JsonKey with one hash, one displacement and one
+ *        verify
+ *
+ * @param[in] key Key bytes, not NUL-terminated
+ * @param[in] len Key length
+ *
+ * @return JSON_KEY_NONE for keys the firmware does not know
+ */
+JsonKey json_key_lookup(const char *key, size_t len) {
+  uint32_t bucket = json_key_hash(key, len, 0) % JSON_KEY_BUCKETS;
+  uint32_t slot =
+      json_key_hash(key, len, displacement[bucket]) % (JSON_KEY_COUNT - 1);
+
+  JsonKey found = slots[slot];
+  const char *name = names[found];
+  if (strncmp(name, key, len) != 0 || name[len] != '\0') {
+    return JSON_KEY_NONE;
+  }
+  return found;
+}
+
+const char *json_key_name(JsonKey key) {
+  return key < JSON_KEY_COUNT ? names[key] : "";
+}
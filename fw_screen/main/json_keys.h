@@ -0,0 +1,55 @@
+// Generated by tools/gen_json_keys.py, do not edit.
+#pragma once
+
+#include <stddef.h>
+
+typedef enum {
+  JSON_KEY_NONE,
+  JSON_KEY_ANM, // "anm"
+  JSON_KEY_SPS, // "sps"
+  JSON_KEY_IMU, // "imu"
+  JSON_KEY_STATUS, // "status"
+  JSON_KEY_HELLO, // "hello"
+  JSON_KEY_LOG_EXPORT, // "log_export"
+  JSON_KEY_ACCTOP, // "acctop"
+  JSON_KEY_ACC, // "acc"
+  JSON_KEY_MAG, // "mag"
+  JSON_KEY_GYR, // "gyr"
+  JSON_KEY_TOPIC, // "topic"
+  JSON_KEY_TYPE, // "type"
+  JSON_KEY_MSG, // "msg"
+  JSON_KEY_TIMESTAMP, // "timestamp"
+  JSON_KEY_SENSOR_DATA, // "sensor_data"
+  JSON_KEY_X_VOUT, // "x_vout"
+  JSON_KEY_Y_VOUT, // "y_vout"
+  JSON_KEY_Z_VOUT, // "z_vout"
+  JSON_KEY_AUTOCALIBRAZIONE_ASSE_X, // "autocalibrazione_asse_x"
+  JSON_KEY_AUTOCALIBRAZIONE_ASSE_Y, // "autocalibrazione_asse_y"
+  JSON_KEY_AUTOCALIBRAZIONE_ASSE_Z, // "autocalibrazione_asse_z"
+  JSON_KEY_AUTOCALIBRAZIONE_MISURA_X, // "autocalibrazione_misura_x"
+  JSON_KEY_AUTOCALIBRAZIONE_MISURA_Y, // "autocalibrazione_misura_y"
+  JSON_KEY_AUTOCALIBRAZIONE_MISURA_Z, // "autocalibrazione_misura_z"
+  JSON_KEY_TEMP_SONICA_X, // "temp_sonica_x"
+  JSON_KEY_TEMP_SONICA_Y, // "temp_sonica_y"
+  JSON_KEY_TEMP_SONICA_Z, // "temp_sonica_z"
+  JSON_KEY_MASS_DENSITY, // "mass_density"
+  JSON_KEY_PARTICLE_COUNT, // "particle_count"
+  JSON_KEY_PARTICLE_SIZE, // "particle_size"
+  JSON_KEY_MASS_DENSITY_UNIT, // "mass_density_unit"
+  JSON_KEY_PARTICLE_COUNT_UNIT, // "particle_count_unit"
+  JSON_KEY_PARTICLE_SIZE_UNIT, // "particle_size_unit"
+  JSON_KEY_PM0_5, // "pm0.5"
+  JSON_KEY_PM1_0, // "pm1.0"
+  JSON_KEY_PM2_5, // "pm2.5"
+  JSON_KEY_PM4_0, // "pm4.0"
+  JSON_KEY_PM10, // "pm10"
+  JSON_KEY_DEV, // "dev"
+  JSON_KEY_UNIT, // "unit"
+  JSON_KEY_X, // "x"
+  JSON_KEY_Y, // "y"
+  JSON_KEY_Z, // "z"
+  JSON_KEY_COUNT,
+} JsonKey;
+
+JsonKey json_key_lookup(const char *key, size_t len);
+const char *json_key_name(JsonKey key);
@@ -0,0 +1,374 @@
+#include "json_scan.h"
+#include "decimal.h"
+#include <string.h>
+
+// Nesting handled by json_scan_skip_container, one bit per level
+#define JSON_SCAN_MAX_DEPTH 32
+
+static void json_scan_ws(JsonScanner *scanner) {
+  while (scanner->pos < scanner->end &&
+         (*scanner->pos == ' ' || *scanner->pos == '\t' ||
+          *scanner->pos == '\n' || *scanner->pos == '\r')) {
+    scanner->pos++;
+  }
+}
+
+static bool json_scan_fail(JsonScanner *scanner) {
+  scanner->error = true;
+  scanner->done = true;
+  return false;
+}
+
+/**
+ * @brief Scan a string, pos on the opening quote
+ */
+static bool json_scan_string_token(JsonScanner *scanner, JsonToken *token) {
+  const char *p = scanner->pos + 1;
+  bool escaped = false;
+
+  while (p < scanner->end && *p != '"') {
+    if ((unsigned char)*p < 0x20) {
+      return false;
+    }
+    if (*p == '\\') {
+      escaped = true;
+      p++;
+    }
+    p++;
+  }
+  if (p >= scanner->end) {
+    return false;
+  }
+
+  token->type = JSON_SCAN_STRING;
+  token->start = scanner->pos + 1;
+  token->len = p - token->start;
+  token->escaped = escaped;
+  scanner->pos = p + 1;
+  return true;
+}
+
+static bool json_scan_number_token(JsonScanner *scanner, JsonToken *token) {
+  const char *p = scanner->pos;
+  bool digits = false;
+
+  while (p < scanner->end) {
+    char c = *p;
+    if (c >= '0' && c <= '9') {
+      digits = true;
+    } else if (c != '-' && c != '+' && c != '.' && c != 'e' && c != 'E') {
+      break;
+    }
+    p++;
+  }
+  if (!digits) {
+    return false;
+  }
+
+  token->type = JSON_SCAN_NUMBER;
+  token->start = scanner->pos;
+  token->len = p - scanner->pos;
+  token->escaped = false;
+  scanner->pos = p;
+  return true;
+}
+
+static bool json_scan_literal(JsonScanner *scanner, JsonToken *token,
+                              const char *literal, JsonScanType type) {
+  size_t len = strlen(literal);
+  if ((size_t)(scanner->end - scanner->pos) < len ||
+      memcmp(scanner->pos, literal, len) != 0) {
+    return false;
+  }
+
+  token->type = type;
+  token->start = scanner->pos;
+  token->len = len;
+  token->escaped = false;
+  scanner->pos += len;
+  return true;
+}
+
+/**
+ * @brief Find the end of an object or array, pos on its opening bracket
+ */
+static bool json_scan_skip_container(JsonScanner *scanner, JsonToken *token) {
+  const char *start = scanner->pos;
+  uint32_t objects = 0; // bit n set: level n is an object
+  int depth = 0;
+
+  while (scanner->pos < scanner->end) {
+    char c = *scanner->pos;
+    if (c == '"') {
+      JsonToken string;
+      if (!json_scan_string_token(scanner, &string)) {
+        return false;
+      }
+      continue;
+    }
+
+    if (c == '{' || c == '[') {
+      if (depth == JSON_SCAN_MAX_DEPTH) {
+        return false;
+      }
+      if (c == '{') {
+        objects |= 1u << depth;
+      } else {
+        objects &= ~(1u << depth);
+      }
+      depth++;
+    } else if (c == '}' || c == ']') {
+      if (depth == 0 || (c == '}') != ((objects >> (depth - 1)) & 1)) {
+        return false;
+      }
+      if (--depth == 0) {
+        scanner->pos++;
+        token->type = *start == '{' ? JSON_SCAN_OBJECT : JSON_SCAN_ARRAY;
+        token->start = start;
+        token->len = scanner->pos - start;
+        token->escaped = false;
+        return true;
+      }
+    }
+    scanner->pos++;
+  }
+  return false;
+}
+
+static bool json_scan_value(JsonScanner *scanner, JsonToken *token) {
+  if (scanner->pos >= scanner->end) {
+    return false;
+  }
+
+  switch (*scanner->pos) {
+  case '"':
+    return json_scan_string_token(scanner, token);
+  case '{':
+  case '[':
+    return json_scan_skip_container(scanner, token);
+  case 't':
+    return json_scan_literal(scanner, token, "true", JSON_SCAN_TRUE);
+  case 'f':
+    return json_scan_literal(scanner, token, "false", JSON_SCAN_FALSE);
+  case 'n':
+    return json_scan_literal(scanner, token, "null", JSON_SCAN_NULL);
+  default:
+    return json_scan_number_token(scanner, token);
+  }
+}
+
+/**
+ * @brief Move to the next member or element
+ *
+ * @return false at the closing bracket or on malformed input
+ */
+static bool json_scan_next(JsonScanner *scanner) {
+  if (scanner->done) {
+    return false;
+  }
+
+  json_scan_ws(scanner);
+  if (scanner->pos >= scanner->end) {
+    return json_scan_fail(scanner);
+  }
+  if (*scanner->pos == scanner->close) {
+    scanner->pos++;
+    scanner->done = true;
+    return false;
+  }
+
+  if (!scanner->first) {
+    if (*scanner->pos != ',') {
+      return json_scan_fail(scanner);
+    }
+    scanner->pos++;
+    json_scan_ws(scanner);
+  }
+  scanner->first = false;
+  return true;
+}
+
+/**
+ * @brief Start scanning the top-level object of a frame
+ *
+ * @param[in] json Frame, does not need to be NUL-terminated
+ * @param[in] len  Frame length
+ *
+ * @return false if the frame is not an object
+ */
+bool json_scan_object(JsonScanner *scanner, const char *json, size_t len) {
+  *scanner = (JsonScanner){
+      .pos = json,
+      .end = json + len,
+      .close = '}',
+      .first = true,
+  };
+
+  json_scan_ws(scanner);
+  if (scanner->pos >= scanner->end || *scanner->pos != '{') {
+    return json_scan_fail(scanner);
+  }
+  scanner->pos++;
+  return true;
+}
+
+/**
+ * @brief Start scanning an object or array token returned by another scanner
+ */
+bool json_scan_enter(JsonScanner *scanner, const JsonToken *container) {
+  if (container->type != JSON_SCAN_OBJECT &&
+      container->type != JSON_SCAN_ARRAY) {
+    *scanner = (JsonScanner){.done = true, .error = true};
+    return false;
+  }
+
+  *scanner = (JsonScanner){
+      .pos = container->start + 1,
+      .end = container->start + container->len,
+      .close = container->type == JSON_SCAN_OBJECT ? '}' : ']',
+      .first = true,
+  };
+  return true;
+}
+
+/**
+ * @brief Next member of an object
+ *
+ * @return false after the last member; check error to tell the end of the
+ *         object from malformed input
+ */
+bool json_scan_member(JsonScanner *scanner, JsonToken *key, JsonToken *value) {
+  if (!json_scan_next(scanner)) {
+    return false;
+  }
+
+  if (scanner->pos >= scanner->end || *scanner->pos != '"' ||
+      !json_scan_string_token(scanner, key)) {
+    return json_scan_fail(scanner);
+  }
+
+  json_scan_ws(scanner);
+  if (scanner->pos >= scanner->end || *scanner->pos != ':') {
+    return json_scan_fail(scanner);
+  }
+  scanner->pos++;
+  json_scan_ws(scanner);
+
+  if (!json_scan_value(scanner, value)) {
+    return json_scan_fail(scanner);
+  }
+  return true;
+}
+
+/**
+ * @brief Next element of an array
+ */
+bool json_scan_element(JsonScanner *scanner, JsonToken *value) {
+  if (!json_scan_next(scanner)) {
+    return false;
+  }
+
+  if (!json_scan_value(scanner, value)) {
+    return json_scan_fail(scanner);
+  }
+  return true;
+}
+
+/**
+ * @brief Compare a string token with a C string
+ *
+ * Strings with escapes never match, which is fine for keys and topics.
+ */
+bool json_scan_eq(const JsonToken *token, const char *str) {
+  size_t len = strlen(str);
+  return token->type == JSON_SCAN_STRING && !token->escaped &&
+         token->len == len && memcmp(token->start, str, len) == 0;
+}
+
+/**
+ * @brief Convert a number token, value is left untouched on failure
+ */
+bool json_scan_number(const JsonToken *token, double *value) {
+  if (token->type != JSON_SCAN_NUMBER) {
+    return false;
+  }
+
+  return decimal_parse(token->start, token->len, value);
+}
+
+/**
+ * @brief Convert a boolean token, value is left untouched on failure
+ */
+bool json_scan_bool(const JsonToken *token, bool *value) {
+  if (token->type != JSON_SCAN_TRUE && token->type != JSON_SCAN_FALSE) {
+    return false;
+  }
+  *value = token->type == JSON_SCAN_TRUE;
+  return true;
+}
+
+/**
+ * @brief Copy a string token, decoding escapes
+ *
+ * The copy is truncated to size - 1 bytes and always NUL-terminated. \\u
+ * escapes outside ASCII are replaced by '?'.
+ *
+ * @return false if the token is not a string; dst is left untouched
+ */
+bool json_scan_string(const JsonToken *token, char *dst, size_t size) {
+  if (token->type != JSON_SCAN_STRING || size == 0) {
+    return false;
+  }
+
+  const char *src = token->start;
+  const char *end = token->start + token->len;
+  size_t len = 0;
+
+  while (src < end && len < size - 1) {
+    char c = *src++;
+    if (c == '\\' && src < end) {
+      c = *src++;
+      switch (c) {
+      case 'b':
+        c = '\b';
+        break;
+      case 'f':
+        c = '\f';
+        break;
+      case 'n':
+        c = '\n';
+        break;
+      case 'r':
+        c = '\r';
+        break;
+      case 't':
+        c = '\t';
+        break;
+      case 'u': {
+        unsigned code = 0;
+        int digits = 0;
+        for (; digits < 4 && src < end; digits++, src++) {
+          char h = *src;
+          code <<= 4;
+          if (h >= '0' && h <= '9') {
+            code |= h - '0';
+          } else if (h >= 'a' && h <= 'f') {
+            code |= h - 'a' + 10;
+          } else if (h >= 'A' && h <= 'F') {
+            code |= h - 'A' + 10;
+          } else {
+            break;
+          }
+        }
+        c = (digits == 4 && code > 0 && code < 0x80) ? (char)code : '?';
+        break;
+      }
+      default: // '"', '\\' and '/' stand for themselves
+        break;
+      }
+    }
+    dst[len++] = c;
+  }
+  dst[len] = '\0';
+  return true;
+}
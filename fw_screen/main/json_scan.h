@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Allocation-free JSON scanner working in place on a frame.
+ *
+ * Tokens point into the scanned buffer, nothing is copied or allocated. A
+ * JsonScanner walks the members of one object (or the elements of one array)
+ * in document order; nested objects and arrays are returned as a single token
+ * spanning both brackets, which json_scan_enter() turns into a scanner of
+ * their own. Numbers, booleans and strings are only converted when the caller
+ * asks for them, so skipped members cost a scan and nothing else.
+ *
+ * Malformed input stops the scanner and sets its error flag; callers fall back
+ * to cJSON for anything the scanner rejects.
+ */
+
+typedef enum {
+  JSON_SCAN_NONE,
+  JSON_SCAN_STRING,
+  JSON_SCAN_NUMBER,
+  JSON_SCAN_TRUE,
+  JSON_SCAN_FALSE,
+  JSON_SCAN_NULL,
+  JSON_SCAN_OBJECT,
+  JSON_SCAN_ARRAY,
+} JsonScanType;
+
+typedef struct JsonToken {
+  JsonScanType type;
+  const char *start; // strings: after the opening quote, containers: bracket
+  size_t len;        // strings: without quotes, containers: with brackets
+  bool escaped;      // string contains backslash escapes
+} JsonToken;
+
+typedef struct JsonScanner {
+  const char *pos;
+  const char *end;
+  char close; // '}' or ']'
+  bool first;
+  bool done;
+  bool error;
+} JsonScanner;
+
+bool json_scan_object(JsonScanner *scanner, const char *json, size_t len);
+bool json_scan_enter(JsonScanner *scanner, const JsonToken *container);
+
+bool json_scan_member(JsonScanner *scanner, JsonToken *key, JsonToken *value);
+bool json_scan_element(JsonScanner *scanner, JsonToken *value);
+
+bool json_scan_eq(const JsonToken *token, const char *str);
+bool json_scan_number(const JsonToken *token, double *value);
+bool json_scan_bool(const JsonToken *token, bool *value);
+bool json_scan_string(const JsonToken *token, char *dst, size_t size);
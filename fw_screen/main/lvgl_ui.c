@@ -1,8 +1,13 @@
 #include "lvgl_ui.h"
+#include "clock_format.h"
 #include "data.h"
+#include "decimal.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
 #include "lvgl.h"
-#include "tusb_cdc.h"
-#include <time.h>
+#include "sdkconfig.h"
+#include "transport.h"
+#include <string.h>
 
 WindLabels windLabels;
 ParticulateMatterLabels particulateMatterLabels;
@@ -12,160 +17,266 @@ static lv_obj_t *status_container;
 static lv_obj_t *status_labels[MAX_MESSAGES];
 static int status_msg_count = 0;
 
+typedef struct {
+  char text[STATUS_TEXT_MAX];
+} StatusText;
+
+// Status messages posted by other tasks, shown by status_refresh
+static QueueHandle_t status_queue;
+
+#define LABEL_BUFFER_SIZE 64
+
+#ifdef CONFIG_SCREEN_UI_CLOCK_MILLIS
+#define CLOCK_MILLIS true
+#else
+#define CLOCK_MILLIS false
+#endif
+
+static size_t label_append(char *buffer, size_t len, const char *str) {
+  while (*str && len < LABEL_BUFFER_SIZE - 1) {
+    buffer[len++] = *str++;
+  }
+  buffer[len] = '\0';
+  return len;
+}
+
+/**
+ * @brief Set the label text only if it changed
+ *
+ * lv_label_set_text() reallocates the text and invalidates the label even
+ * when the text is the same, which costs a redraw and a flush of its area.
+ * Most fields only change in their last digits or not at all between two
+ * samples, so comparing at display precision skips most of them.
+ */
+static void label_set_text(lv_obj_t *label, const char *text) {
+  if (strcmp(lv_label_get_text(label), text) != 0) {
+    lv_label_set_text(label, text);
+  }
+}
+
+/**
+ * @brief Set a label to "<prefix><number> <unit>"
+ */
+static void label_set_number(lv_obj_t *label, const char *prefix,
+                             const char *number, const char *unit) {
+  char buffer[LABEL_BUFFER_SIZE];
+  size_t len = label_append(buffer, 0, prefix);
+  len = label_append(buffer, len, number);
+  len = label_append(buffer, len, " ");
+  label_append(buffer, len, unit);
+  label_set_text(label, buffer);
+}
+
+/**
+ * @brief Show value with frac decimals
+ *
+ * Same text as snprintf("%.*f"), without going through the double-precision
+ * printf machinery.
+ */
+static void label_set_value(lv_obj_t *label, const char *prefix, float value,
+                            uint8_t frac, const char *unit) {
+  char number[24];
+  decimal_format_float(number, sizeof(number), value, frac);
+  label_set_number(label, prefix, number, unit);
+}
+
+/**
+ * @brief Show a value kept in hundredths
+ */
+static void label_set_centi(lv_obj_t *label, const char *prefix, int16_t value,
+                            const char *unit) {
+  char number[8];
+  decimal_format(number, sizeof(number), value, 2);
+  label_set_number(label, prefix, number, unit);
+}
+
 void lvgl_update_anemometer_data(const AnemometerData *anm_data) {
-  if (lvgl_lock(-1)) {
-    static char buffer[64];
+  static char buffer[64];
 
-    time_t timestamp = anm_data->timestamp;
-    struct tm timeinfo;
-    localtime_r(&timestamp, &timeinfo);
-    char time_buffer[64];
-    strftime(time_buffer, sizeof(time_buffer), "%Y-%m-%d %H:%M:%S", &timeinfo);
-    snprintf(buffer, 64, "%s", time_buffer);
-    lv_label_set_text(windLabels.timestamp, buffer);
+  static ClockFormat clock;
+  label_set_text(windLabels.timestamp,
+                 clock_format(&clock, anm_data->timestamp,
+                              anm_data->timestamp_ms, CLOCK_MILLIS));
 
-    snprintf(buffer, 64, "X Vento: %.03f m/s", anm_data->x_vout);
-    lv_label_set_text(windLabels.x_vout, buffer);
+  label_set_value(windLabels.speed, "Velocita: ", anm_data->speed, 2, "m/s");
+  label_set_value(windLabels.speed_3d, "Velocita 3D: ", anm_data->speed_3d, 2,
+                  "m/s");
+  label_set_value(windLabels.direction, "Direzione: ", anm_data->direction, 0,
+                  "deg");
 
-    snprintf(buffer, 64, "X Cal Asse: %s",
-             anm_data->autocalibrazione_asse_x ? "True" : "False");
-    lv_label_set_text(windLabels.autocalibrazione_asse_x, buffer);
+  label_set_value(windLabels.x_vout, "X Vento: ", anm_data->x_vout, 3, "m/s");
 
-    snprintf(buffer, 64, "X Cal Misura: %s",
-             anm_data->autocalibrazione_misura_x ? "True" : "False");
-    lv_label_set_text(windLabels.autocalibrazione_misura_x, buffer);
+  snprintf(buffer, 64, "X Cal Asse: %s",
+           (anm_data->flags & ANM_AUTOCAL_ASSE_X) ? "True" : "False");
+  label_set_text(windLabels.autocalibrazione_asse_x, buffer);
 
-    snprintf(buffer, 64, "X Temp Sonica: %.02f C", anm_data->temp_sonica_x);
-    lv_label_set_text(windLabels.temp_sonica_x, buffer);
+  snprintf(buffer, 64, "X Cal Misura: %s",
+           (anm_data->flags & ANM_AUTOCAL_MISURA_X) ? "True" : "False");
+  label_set_text(windLabels.autocalibrazione_misura_x, buffer);
 
-    snprintf(buffer, 64, "Y Vento: %.03f m/s", anm_data->y_vout);
-    lv_label_set_text(windLabels.y_vout, buffer);
+  label_set_centi(windLabels.temp_sonica_x, "X Temp Sonica: ",
+                  anm_data->temp_sonica_x, "C");
 
-    snprintf(buffer, 64, "Y Cal Asse: %s",
-             anm_data->autocalibrazione_asse_y ? "True" : "False");
-    lv_label_set_text(windLabels.autocalibrazione_asse_y, buffer);
+  label_set_value(windLabels.y_vout, "Y Vento: ", anm_data->y_vout, 3, "m/s");
 
-    snprintf(buffer, 64, "Y Cal Misura: %s",
-             anm_data->autocalibrazione_misura_y ? "True" : "False");
-    lv_label_set_text(windLabels.autocalibrazione_misura_y, buffer);
+  snprintf(buffer, 64, "Y Cal Asse: %s",
+           (anm_data->flags & ANM_AUTOCAL_ASSE_Y) ? "True" : "False");
+  label_set_text(windLabels.autocalibrazione_asse_y, buffer);
 
-    snprintf(buffer, 64, "Y Temp Sonica: %.02f C", anm_data->temp_sonica_y);
-    lv_label_set_text(windLabels.temp_sonica_y, buffer);
+  snprintf(buffer, 64, "Y Cal Misura: %s",
+           (anm_data->flags & ANM_AUTOCAL_MISURA_Y) ? "True" : "False");
+  label_set_text(windLabels.autocalibrazione_misura_y, buffer);
 
-    snprintf(buffer, 64, "Z Vento: %.03f m/s", anm_data->z_vout);
-    lv_label_set_text(windLabels.z_vout, buffer);
+  label_set_centi(windLabels.temp_sonica_y, "Y Temp Sonica: ",
+                  anm_data->temp_sonica_y, "C");
 
-    snprintf(buffer, 64, "Z Cal Asse: %s",
-             anm_data->autocalibrazione_asse_z ? "True" : "False");
-    lv_label_set_text(windLabels.autocalibrazione_asse_z, buffer);
+  label_set_value(windLabels.z_vout, "Z Vento: ", anm_data->z_vout, 3, "m/s");
 
-    snprintf(buffer, 64, "Z Cal Misura: %s",
-             anm_data->autocalibrazione_misura_z ? "True" : "False");
-    lv_label_set_text(windLabels.autocalibrazione_misura_z, buffer);
+  snprintf(buffer, 64, "Z Cal Asse: %s",
+           (anm_data->flags & ANM_AUTOCAL_ASSE_Z) ? "True" : "False");
+  label_set_text(windLabels.autocalibrazione_asse_z, buffer);
 
-    snprintf(buffer, 64, "Z Temp Sonica: %.02f C", anm_data->temp_sonica_z);
-    lv_label_set_text(windLabels.temp_sonica_z, buffer);
+  snprintf(buffer, 64, "Z Cal Misura: %s",
+           (anm_data->flags & ANM_AUTOCAL_MISURA_Z) ? "True" : "False");
+  label_set_text(windLabels.autocalibrazione_misura_z, buffer);
 
-    ESP_LOGI("UART", "WIND UPDATED");
+  label_set_centi(windLabels.temp_sonica_z, "Z Temp Sonica: ",
+                  anm_data->temp_sonica_z, "C");
 
-    lvgl_unlock();
-  }
+  ESP_LOGI("UART", "WIND UPDATED");
 }
 
-void lvgl_update_particulate_matter_data(const ParticulateMatterData *pm_data) {
+static void label_set_wind_window(lv_obj_t *mean, lv_obj_t *gust,
+                                  lv_obj_t *range, lv_obj_t *turbulence,
+                                  const char *span, const WindWindow *window) {
+  char buffer[LABEL_BUFFER_SIZE];
+  char first[24];
+  char second[24];
+
+  decimal_format_float(first, sizeof(first), window->mean, 2);
+  decimal_format_float(second, sizeof(second), window->std, 2);
+  snprintf(buffer, sizeof(buffer), "Media %s: %s +/- %s m/s", span, first,
+           second);
+  label_set_text(mean, buffer);
+
+  decimal_format_float(first, sizeof(first), window->gust, 2);
+  snprintf(buffer, sizeof(buffer), "Raffica %s: %s m/s", span, first);
+  label_set_text(gust, buffer);
+
+  decimal_format_float(first, sizeof(first), window->min, 2);
+  decimal_format_float(second, sizeof(second), window->max, 2);
+  snprintf(buffer, sizeof(buffer), "Min/Max %s: %s / %s m/s", span, first,
+           second);
+  label_set_text(range, buffer);
+
+  decimal_format_float(first, sizeof(first), window->turbulence, 2);
+  snprintf(buffer, sizeof(buffer), "Turbolenza %s: %s", span, first);
+  label_set_text(turbulence, buffer);
+}
 
-  if (lvgl_lock(-1)) {
-    static char buffer[64];
+void lvgl_update_wind_stats(const WindStats *stats) {
+  label_set_wind_window(windLabels.mean_2m, windLabels.gust_2m,
+                        windLabels.range_2m, windLabels.turbulence_2m, "2m",
+                        &stats->short_window);
+  label_set_wind_window(windLabels.mean_10m, windLabels.gust_10m,
+                        windLabels.range_10m, windLabels.turbulence_10m, "10m",
+                        &stats->long_window);
+}
 
-    time_t timestamp = pm_data->timestamp;
-    struct tm timeinfo;
-    localtime_r(&timestamp, &timeinfo);
-    char time_buffer[64];
-    strftime(time_buffer, sizeof(time_buffer), "%Y-%m-%d %H:%M:%S", &timeinfo);
-    snprintf(buffer, 64, "%s", time_buffer);
-    lv_label_set_text(particulateMatterLabels.timestamp, buffer);
+void lvgl_update_particulate_matter_data(const ParticulateMatterData *pm_data) {
 
-    snprintf(buffer, 64, "Mass PM1.0 %.02f %s", pm_data->mass_density_pm_1_0,
-             pm_data->mass_density_unit);
-    lv_label_set_text(particulateMatterLabels.mass_density_pm_1_0, buffer);
+  static ClockFormat clock;
+  label_set_text(particulateMatterLabels.timestamp,
+                 clock_format(&clock, pm_data->timestamp,
+                              pm_data->timestamp_ms, CLOCK_MILLIS));
 
-    snprintf(buffer, 64, "Mass PM2.5 %.02f %s", pm_data->mass_density_pm_2_5,
-             pm_data->mass_density_unit);
-    lv_label_set_text(particulateMatterLabels.mass_density_pm_2_5, buffer);
+  label_set_value(particulateMatterLabels.mass_density_pm_1_0, "Mass PM1.0 ",
+                  pm_data->mass_density_pm_1_0, 2,
+                  unit_name(pm_data->mass_density_unit));
 
-    snprintf(buffer, 64, "Mass PM4.0 %.02f %s", pm_data->mass_density_pm_4_0,
-             pm_data->mass_density_unit);
-    lv_label_set_text(particulateMatterLabels.mass_density_pm_4_0, buffer);
+  label_set_value(particulateMatterLabels.mass_density_pm_2_5, "Mass PM2.5 ",
+                  pm_data->mass_density_pm_2_5, 2,
+                  unit_name(pm_data->mass_density_unit));
 
-    snprintf(buffer, 64, "Mass PM10 %.02f %s", pm_data->mass_density_pm_10,
-             pm_data->mass_density_unit);
-    lv_label_set_text(particulateMatterLabels.mass_density_pm_10, buffer);
+  label_set_value(particulateMatterLabels.mass_density_pm_4_0, "Mass PM4.0 ",
+                  pm_data->mass_density_pm_4_0, 2,
+                  unit_name(pm_data->mass_density_unit));
 
-    snprintf(buffer, 64, "PM0.5 %.02f %s", pm_data->particle_count_0_5,
-             pm_data->particle_count_unit);
-    lv_label_set_text(particulateMatterLabels.particle_count_0_5, buffer);
+  label_set_value(particulateMatterLabels.mass_density_pm_10, "Mass PM10 ",
+                  pm_data->mass_density_pm_10, 2,
+                  unit_name(pm_data->mass_density_unit));
 
-    snprintf(buffer, 64, "PM1.0 %.02f %s", pm_data->particle_count_1_0,
-             pm_data->particle_count_unit);
-    lv_label_set_text(particulateMatterLabels.particle_count_1_0, buffer);
+  label_set_value(particulateMatterLabels.particle_count_0_5, "PM0.5 ",
+                  pm_data->particle_count_0_5, 2,
+                  unit_name(pm_data->particle_count_unit));
 
-    snprintf(buffer, 64, "PM2.5 %.02f %s", pm_data->particle_count_2_5,
-             pm_data->particle_count_unit);
-    lv_label_set_text(particulateMatterLabels.particle_count_2_5, buffer);
+  label_set_value(particulateMatterLabels.particle_count_1_0, "PM1.0 ",
+                  pm_data->particle_count_1_0, 2,
+                  unit_name(pm_data->particle_count_unit));
 
-    snprintf(buffer, 64, "PM4.0 %.02f %s", pm_data->particle_count_4_0,
-             pm_data->particle_count_unit);
-    lv_label_set_text(particulateMatterLabels.particle_count_4_0, buffer);
+  label_set_value(particulateMatterLabels.particle_count_2_5, "PM2.5 ",
+                  pm_data->particle_count_2_5, 2,
+                  unit_name(pm_data->particle_count_unit));
 
-    snprintf(buffer, 64, "PM10 %.02f %s", pm_data->particle_count_10,
-             pm_data->particle_count_unit);
-    lv_label_set_text(particulateMatterLabels.particle_count_10, buffer);
+  label_set_value(particulateMatterLabels.particle_count_4_0, "PM4.0 ",
+                  pm_data->particle_count_4_0, 2,
+                  unit_name(pm_data->particle_count_unit));
 
-    snprintf(buffer, 64, "P. Size: %.03f %s", pm_data->particle_size,
-             pm_data->particle_size_unit);
-    lv_label_set_text(particulateMatterLabels.particle_size, buffer);
+  label_set_value(particulateMatterLabels.particle_count_10, "PM10 ",
+                  pm_data->particle_count_10, 2,
+                  unit_name(pm_data->particle_count_unit));
 
-    lvgl_unlock();
-  }
+  label_set_value(particulateMatterLabels.particle_size, "P. Size: ",
+                  pm_data->particle_size, 3,
+                  unit_name(pm_data->particle_size_unit));
 
   ESP_LOGI("UART", "PARTICULATE MATTER UPDATED");
 }
 
+static void label_set_pm_window(lv_obj_t *label, const char *span,
+                                const PmWindow *window) {
+  char buffer[LABEL_BUFFER_SIZE];
+  char pm_2_5[24];
+  char pm_10[24];
+
+  decimal_format_float(pm_2_5, sizeof(pm_2_5), window->pm_2_5, 1);
+  decimal_format_float(pm_10, sizeof(pm_10), window->pm_10, 1);
+  snprintf(buffer, sizeof(buffer), "Media %s: PM2.5 %s PM10 %s ug/m3", span,
+           pm_2_5, pm_10);
+  label_set_text(label, buffer);
+}
+
+void lvgl_update_pm_stats(const PmStats *stats) {
+  char buffer[LABEL_BUFFER_SIZE];
+
+  label_set_pm_window(particulateMatterLabels.average_1h, "1h", &stats->hour);
+  label_set_pm_window(particulateMatterLabels.average_24h, "24h", &stats->day);
+
+  snprintf(buffer, sizeof(buffer), "AQI 24h: %u %s", stats->aqi,
+           aqi_category_name(stats->aqi_category));
+  label_set_text(particulateMatterLabels.aqi, buffer);
+}
+
 void lvgl_update_imu_data(const ImuData *imu_data) {
 
-  if (lvgl_lock(-1)) {
-    static char buffer[64];
-
-    time_t timestamp = imu_data->timestamp;
-    struct tm timeinfo;
-    localtime_r(&timestamp, &timeinfo);
-    char time_buffer[64];
-    strftime(time_buffer, sizeof(time_buffer), "%Y-%m-%d %H:%M:%S", &timeinfo);
-    snprintf(buffer, 64, "%s", time_buffer);
-    lv_label_set_text(imuLabels.timestamp, buffer);
-
-    snprintf(buffer, 64, "Acc TOP X: %.02f %s", imu_data->acc_top_x,
-             imu_data->acc_top_unit);
-    lv_label_set_text(imuLabels.acc_top_x, buffer);
-    snprintf(buffer, 64, "Acc TOP Y: %.02f %s", imu_data->acc_top_y,
-             imu_data->acc_top_unit);
-    lv_label_set_text(imuLabels.acc_top_y, buffer);
-    snprintf(buffer, 64, "Acc TOP Z: %.02f %s", imu_data->acc_top_z,
-             imu_data->acc_top_unit);
-    lv_label_set_text(imuLabels.acc_top_z, buffer);
-
-    snprintf(buffer, 64, "MAG X: %.02f %s", imu_data->mag_x,
-             imu_data->mag_unit);
-    lv_label_set_text(imuLabels.mag_x, buffer);
-    snprintf(buffer, 64, "MAG Y: %.02f %s", imu_data->mag_y,
-             imu_data->mag_unit);
-    lv_label_set_text(imuLabels.mag_y, buffer);
-    snprintf(buffer, 64, "MAG Z: %.02f %s", imu_data->mag_z,
-             imu_data->mag_unit);
-    lv_label_set_text(imuLabels.mag_z, buffer);
-
-    lvgl_unlock();
-  }
+  static ClockFormat clock;
+  label_set_text(imuLabels.timestamp,
+                 clock_format(&clock, imu_data->timestamp,
+                              imu_data->timestamp_ms, CLOCK_MILLIS));
+
+  label_set_value(imuLabels.acc_top_x, "Acc TOP X: ", imu_data->acc_top_x, 2,
+                  unit_name(imu_data->acc_top_unit));
+  label_set_value(imuLabels.acc_top_y, "Acc TOP Y: ", imu_data->acc_top_y, 2,
+                  unit_name(imu_data->acc_top_unit));
+  label_set_value(imuLabels.acc_top_z, "Acc TOP Z: ", imu_data->acc_top_z, 2,
+                  unit_name(imu_data->acc_top_unit));
+
+  label_set_value(imuLabels.mag_x, "MAG X: ", imu_data->mag_x, 2,
+                  unit_name(imu_data->mag_unit));
+  label_set_value(imuLabels.mag_y, "MAG Y: ", imu_data->mag_y, 2,
+                  unit_name(imu_data->mag_unit));
+  label_set_value(imuLabels.mag_z, "MAG Z: ", imu_data->mag_z, 2,
+                  unit_name(imu_data->mag_unit));
 
   ESP_LOGI("UART", "PARTICULATE MATTER UPDATED");
 }
@@ -178,7 +289,7 @@ static void btn_power_off_handler(lv_event_t *e) {
     cJSON *json = cJSON_CreateObject();
     cJSON_AddStringToObject(json, "type", "command");
     cJSON_AddStringToObject(json, "command", "poweroff");
-    tusb_json_write(json);
+    transport_json_write(json);
     cJSON_Delete(json);
   }
 }
@@ -191,7 +302,7 @@ static void btn_measure_start_handler(lv_event_t *e) {
     cJSON *json = cJSON_CreateObject();
     cJSON_AddStringToObject(json, "type", "command");
     cJSON_AddStringToObject(json, "command", "start");
-    tusb_json_write(json);
+    transport_json_write(json);
     cJSON_Delete(json);
   }
 }
@@ -204,7 +315,7 @@ static void btn_measure_stop_handler(lv_event_t *e) {
     cJSON *json = cJSON_CreateObject();
     cJSON_AddStringToObject(json, "type", "command");
     cJSON_AddStringToObject(json, "command", "stop");
-    tusb_json_write(json);
+    transport_json_write(json);
     cJSON_Delete(json);
   }
 }
@@ -217,36 +328,139 @@ static void btn_restart_handler(lv_event_t *e) {
     cJSON *json = cJSON_CreateObject();
     cJSON_AddStringToObject(json, "type", "command");
     cJSON_AddStringToObject(json, "command", "restart");
-    tusb_json_write(json);
+    transport_json_write(json);
     cJSON_Delete(json);
   }
 }
 
+/**
+ * @brief Queue a status message, from any task
+ *
+ * Never takes the LVGL mutex. When the queue is full the oldest pending
+ * message is dropped: only the last MAX_MESSAGES are shown anyway.
+ */
 void add_text_to_status_list(const char *text) {
-  if (lvgl_lock(-1)) {
-    /* Create a new label */
-    lv_obj_t *label = lv_label_create(status_container);
-    lv_label_set_text(label, text);
+  StatusText status;
+
+  if (!status_queue) {
+    return; // UI not built yet
+  }
+
+  snprintf(status.text, sizeof(status.text), "%s", text);
+  while (xQueueSend(status_queue, &status, 0) != pdTRUE) {
+    StatusText dropped;
+    xQueueReceive(status_queue, &dropped, 0);
+  }
+}
+
+static void status_list_append(const char *text) {
+  /* Create a new label */
+  lv_obj_t *label = lv_label_create(status_container);
+  lv_label_set_text(label, text);
+
+  /* Track messages */
+  if (status_msg_count < MAX_MESSAGES) {
+    status_labels[status_msg_count++] = label;
+  } else {
+    /* Remove oldest (which is visually at the top because of reversed layout)
+     */
+    lv_obj_del(status_labels[0]);
 
-    /* Track messages */
-    if (status_msg_count < MAX_MESSAGES) {
-      status_labels[status_msg_count++] = label;
-    } else {
-      /* Remove oldest (which is visually at the top because of reversed layout)
-       */
-      lv_obj_del(status_labels[0]);
+    /* Shift pointers */
+    for (int i = 1; i < MAX_MESSAGES; i++)
+      status_labels[i - 1] = status_labels[i];
+
+    status_labels[MAX_MESSAGES - 1] = label;
+  }
 
-      /* Shift pointers */
-      for (int i = 1; i < MAX_MESSAGES; i++)
-        status_labels[i - 1] = status_labels[i];
+  /* Ensure bottom message stays visible */
+  lv_obj_scroll_to_view(label, LV_ANIM_OFF);
+}
+
+/*
+ * Tab refreshers: LVGL timers, so they run in the LVGL task with the LVGL
+ * mutex already held. Each one picks up the latest sample the RX task
+ * published and redraws its tab only if a new one came in, so the UI work
+ * rate is set by the timer period and not by the data rate: a burst of
+ * frames between two ticks costs a single redraw.
+ *
+ * Hidden tabs are not redrawn at all. Their snapshot is left unread, which
+ * keeps it marked as fresh, and tabview_changed() runs the refresher of the
+ * tab being shown once to catch up.
+ */
+
+#define REFRESH_PERIOD_MS(hz) (1000 / (hz))
+
+// Tabview pages, in creation order
+typedef enum {
+  UI_TAB_WIND,
+  UI_TAB_SPS30,
+  UI_TAB_IMU,
+  UI_TAB_CMD,
+} UiTab;
+
+static uint16_t active_tab;
+
+static void wind_refresh(lv_timer_t *timer) {
+  const AnemometerData *anm_data;
+  const WindStats *stats;
+  if (active_tab != UI_TAB_WIND) {
+    return;
+  }
+  if (anemometer_data_latest(&anm_data)) {
+    lvgl_update_anemometer_data(anm_data);
+  }
+  if (wind_stats_latest(&stats)) {
+    lvgl_update_wind_stats(stats);
+  }
+}
 
-      status_labels[MAX_MESSAGES - 1] = label;
-    }
+static void sps30_refresh(lv_timer_t *timer) {
+  const ParticulateMatterData *pm_data;
+  const PmStats *stats;
+  if (active_tab != UI_TAB_SPS30) {
+    return;
+  }
+  if (particulate_matter_data_latest(&pm_data)) {
+    lvgl_update_particulate_matter_data(pm_data);
+  }
+  if (pm_stats_latest(&stats)) {
+    lvgl_update_pm_stats(stats);
+  }
+}
 
-    /* Ensure bottom message stays visible */
-    lv_obj_scroll_to_view(label, LV_ANIM_OFF);
+static void imu_refresh(lv_timer_t *timer) {
+  const ImuData *imu_data;
+  if (active_tab != UI_TAB_IMU) {
+    return;
+  }
+  if (imu_data_latest(&imu_data)) {
+    lvgl_update_imu_data(imu_data);
+  }
+}
 
-    lvgl_unlock();
+static void status_refresh(lv_timer_t *timer) {
+  StatusText status;
+  while (xQueueReceive(status_queue, &status, 0) == pdTRUE) {
+    status_list_append(status.text);
+  }
+}
+
+static void tabview_changed(lv_event_t *e) {
+  active_tab = lv_tabview_get_tab_act(lv_event_get_target(e));
+
+  switch (active_tab) {
+  case UI_TAB_WIND:
+    wind_refresh(NULL);
+    break;
+  case UI_TAB_SPS30:
+    sps30_refresh(NULL);
+    break;
+  case UI_TAB_IMU:
+    imu_refresh(NULL);
+    break;
+  default:
+    break;
   }
 }
 
@@ -290,6 +504,43 @@ void lvgl_anemometer_ui_init(lv_obj_t *parent) {
 
   windLabels.timestamp = lv_label_create(time_container);
 
+  lv_obj_t *vector_container = lv_obj_create(tab_wind);
+  lv_obj_set_width(vector_container, lv_pct(100));      // Full width
+  lv_obj_set_height(vector_container, LV_SIZE_CONTENT); // Height fits content
+  lv_obj_set_flex_flow(vector_container, LV_FLEX_FLOW_COLUMN);
+  lv_obj_set_flex_align(vector_container, LV_FLEX_ALIGN_START,
+                        LV_FLEX_ALIGN_START, LV_FLEX_ALIGN_START);
+  lv_obj_set_style_pad_all(vector_container, 8, 0); // Internal padding
+  lv_obj_set_style_pad_column(vector_container, 10, 0);
+  lv_obj_set_style_pad_row(vector_container, 5,
+                           0); // Space between rows if wrapped
+  lv_obj_set_scroll_dir(vector_container, LV_DIR_NONE);
+
+  windLabels.speed = lv_label_create(vector_container);
+  windLabels.speed_3d = lv_label_create(vector_container);
+  windLabels.direction = lv_label_create(vector_container);
+
+  lv_obj_t *stats_container = lv_obj_create(tab_wind);
+  lv_obj_set_width(stats_container, lv_pct(100));      // Full width
+  lv_obj_set_height(stats_container, LV_SIZE_CONTENT); // Height fits content
+  lv_obj_set_flex_flow(stats_container, LV_FLEX_FLOW_COLUMN);
+  lv_obj_set_flex_align(stats_container, LV_FLEX_ALIGN_START,
+                        LV_FLEX_ALIGN_START, LV_FLEX_ALIGN_START);
+  lv_obj_set_style_pad_all(stats_container, 8, 0); // Internal padding
+  lv_obj_set_style_pad_column(stats_container, 10, 0);
+  lv_obj_set_style_pad_row(stats_container, 5,
+                           0); // Space between rows if wrapped
+  lv_obj_set_scroll_dir(stats_container, LV_DIR_NONE);
+
+  windLabels.mean_2m = lv_label_create(stats_container);
+  windLabels.gust_2m = lv_label_create(stats_container);
+  windLabels.range_2m = lv_label_create(stats_container);
+  windLabels.turbulence_2m = lv_label_create(stats_container);
+  windLabels.mean_10m = lv_label_create(stats_container);
+  windLabels.gust_10m = lv_label_create(stats_container);
+  windLabels.range_10m = lv_label_create(stats_container);
+  windLabels.turbulence_10m = lv_label_create(stats_container);
+
   lv_obj_t *x_container = lv_obj_create(tab_wind);
   lv_obj_set_width(x_container, lv_pct(100));      // Full width
   lv_obj_set_height(x_container, LV_SIZE_CONTENT); // Height fits content
@@ -338,9 +589,13 @@ void lvgl_anemometer_ui_init(lv_obj_t *parent) {
   windLabels.autocalibrazione_misura_z = lv_label_create(z_container);
   windLabels.temp_sonica_z = lv_label_create(z_container);
 
-  anemometer_data_default(&anemometerData);
+  AnemometerData anm_data;
+  anemometer_data_default(&anm_data);
 
-  lvgl_update_anemometer_data(&anemometerData);
+  lvgl_update_anemometer_data(&anm_data);
+
+  WindStats wind_stats = {0};
+  lvgl_update_wind_stats(&wind_stats);
 
   // -------------------------------
   // TAB SPS
@@ -363,6 +618,22 @@ void lvgl_anemometer_ui_init(lv_obj_t *parent) {
 
   particulateMatterLabels.timestamp = lv_label_create(tstamp_container);
 
+  lv_obj_t *avg_container = lv_obj_create(tab_sps);
+  lv_obj_set_width(avg_container, lv_pct(100));      // Full width
+  lv_obj_set_height(avg_container, LV_SIZE_CONTENT); // Height fits content
+  lv_obj_set_flex_flow(avg_container, LV_FLEX_FLOW_COLUMN);
+  lv_obj_set_flex_align(avg_container, LV_FLEX_ALIGN_START, LV_FLEX_ALIGN_START,
+                        LV_FLEX_ALIGN_START);
+  lv_obj_set_style_pad_all(avg_container, 8, 0); // Internal padding
+  lv_obj_set_style_pad_column(avg_container, 10, 0);
+  lv_obj_set_style_pad_row(avg_container, 5,
+                           0); // Space between rows if wrapped
+  lv_obj_set_scroll_dir(avg_container, LV_DIR_NONE);
+
+  particulateMatterLabels.average_1h = lv_label_create(avg_container);
+  particulateMatterLabels.average_24h = lv_label_create(avg_container);
+  particulateMatterLabels.aqi = lv_label_create(avg_container);
+
   lv_obj_t *md_container = lv_obj_create(tab_sps);
   lv_obj_set_width(md_container, lv_pct(100));      // Full width
   lv_obj_set_height(md_container, LV_SIZE_CONTENT); // Height fits content
@@ -399,8 +670,12 @@ void lvgl_anemometer_ui_init(lv_obj_t *parent) {
   particulateMatterLabels.particle_count_10 = lv_label_create(pc_container);
   particulateMatterLabels.particle_size = lv_label_create(pc_container);
 
-  particulate_matter_data_default(&particulateMatterData);
-  lvgl_update_particulate_matter_data(&particulateMatterData);
+  ParticulateMatterData pm_data;
+  particulate_matter_data_default(&pm_data);
+  lvgl_update_particulate_matter_data(&pm_data);
+
+  PmStats pm_stats = {0};
+  lvgl_update_pm_stats(&pm_stats);
 
   // -------------------------------
   // TAB IMU
@@ -455,8 +730,9 @@ void lvgl_anemometer_ui_init(lv_obj_t *parent) {
   imuLabels.mag_y = lv_label_create(mag_container);
   imuLabels.mag_z = lv_label_create(mag_container);
 
-  imu_data_default(&imuData);
-  lvgl_update_imu_data(&imuData);
+  ImuData imu_data;
+  imu_data_default(&imu_data);
+  lvgl_update_imu_data(&imu_data);
 
   // -------------------------------
   // TAB CMD
@@ -533,6 +809,16 @@ void lvgl_anemometer_ui_init(lv_obj_t *parent) {
   lv_obj_set_flex_flow(status_container, LV_FLEX_FLOW_COLUMN);
   lv_obj_set_scroll_dir(status_container, LV_DIR_ALL);
 
-  // 3 = tab_cmd (0-indexed)
-  lv_tabview_set_act(tabview, 3, LV_ANIM_OFF);
+  lv_tabview_set_act(tabview, UI_TAB_CMD, LV_ANIM_OFF);
+  active_tab = UI_TAB_CMD;
+  lv_obj_add_event_cb(tabview, tabview_changed, LV_EVENT_VALUE_CHANGED, NULL);
+
+  status_queue = xQueueCreate(MAX_MESSAGES, sizeof(StatusText));
+  lv_timer_create(wind_refresh,
+                  REFRESH_PERIOD_MS(CONFIG_SCREEN_UI_WIND_REFRESH_HZ), NULL);
+  lv_timer_create(sps30_refresh,
+                  REFRESH_PERIOD_MS(CONFIG_SCREEN_UI_SPS30_REFRESH_HZ), NULL);
+  lv_timer_create(imu_refresh,
+                  REFRESH_PERIOD_MS(CONFIG_SCREEN_UI_IMU_REFRESH_HZ), NULL);
+  lv_timer_create(status_refresh, STATUS_REFRESH_PERIOD_MS, NULL);
 }
@@ -3,11 +3,26 @@
 #include "data.h"
 #include "esp_log.h"
 #include "lvgl.h"
+#include "pm_stats.h"
 #include "screen.h"
+#include "wind_stats.h"
 
 typedef struct WindLabels {
   lv_obj_t *timestamp;
 
+  lv_obj_t *speed;
+  lv_obj_t *speed_3d;
+  lv_obj_t *direction;
+
+  lv_obj_t *mean_2m;
+  lv_obj_t *gust_2m;
+  lv_obj_t *range_2m;
+  lv_obj_t *turbulence_2m;
+  lv_obj_t *mean_10m;
+  lv_obj_t *gust_10m;
+  lv_obj_t *range_10m;
+  lv_obj_t *turbulence_10m;
+
   lv_obj_t *x_vout;
   lv_obj_t *autocalibrazione_asse_x;
   lv_obj_t *autocalibrazione_misura_x;
@@ -41,6 +56,10 @@ typedef struct ParticulateMatterLabels {
   lv_obj_t *particle_count_10;
 
   lv_obj_t *particle_size;
+
+  lv_obj_t *average_1h;
+  lv_obj_t *average_24h;
+  lv_obj_t *aqi;
 } ParticulateMatterLabels;
 
 extern ParticulateMatterLabels particulateMatterLabels;
@@ -69,9 +88,16 @@ typedef struct ImuLabels {
 extern ImuLabels imuLabels;
 
 #define MAX_MESSAGES 4
+#define STATUS_TEXT_MAX 128
+
+// How often queued status messages are shown
+#define STATUS_REFRESH_PERIOD_MS 100
 
+// LVGL task only, called by the tab refresh timers with the snapshot data
 void lvgl_update_anemometer_data(const AnemometerData *anm_data);
+void lvgl_update_wind_stats(const WindStats *stats);
 void lvgl_update_particulate_matter_data(const ParticulateMatterData *pm_data);
+void lvgl_update_pm_stats(const PmStats *stats);
 void lvgl_update_imu_data(const ImuData *imu_data);
 void lvgl_anemometer_ui_init(lv_obj_t *parent);
 void add_text_to_status_list(const char *text);
\ No newline at end of file
@@ -1,6 +1,10 @@
 #include "lvgl_utils.h"
+#include "esp_heap_caps.h"
 #include "esp_timer.h"
 #include "lvgl.h"
+#include "sdkconfig.h"
+#include <inttypes.h>
+#include <string.h>
 
 #include "data.h"
 
@@ -13,16 +17,181 @@ lv_timer_t *qmi8658_timer;
 
 lv_obj_t *label_gpio_read_status;
 
+#if CONFIG_SCREEN_DISPLAY_STATS
+#define DISPLAY_STATS_PERIOD_US (5 * 1000 * 1000)
+
+static struct {
+  int64_t since;
+  uint32_t frames;
+  uint32_t frame_ms; // render + flush, as reported by LVGL
+  uint32_t pixels;
+  uint32_t flushes; // flush_cb calls
+  uint32_t merged;  // areas joined by display_merge_areas()
+  int64_t flush_start;
+  volatile uint32_t flush_us; // SPI busy, flush call to last transfer done
+} display_stats;
+
+/**
+ * @brief LVGL monitor_cb, logs the totals every DISPLAY_STATS_PERIOD_US
+ */
+static void display_stats_monitor(lv_disp_drv_t *drv, uint32_t time_ms,
+                                  uint32_t px) {
+  int64_t now = esp_timer_get_time();
+
+  display_stats.frames++;
+  display_stats.frame_ms += time_ms;
+  display_stats.pixels += px;
+  if (now - display_stats.since < DISPLAY_STATS_PERIOD_US) {
+    return;
+  }
+
+  uint32_t frames = display_stats.frames;
+  uint32_t flushes = display_stats.flushes * 10 / frames; // tenths
+  uint32_t flush_us = display_stats.flush_us;
+  uint32_t bytes = display_stats.pixels * sizeof(lv_color_t);
+  ESP_LOGI(TAG,
+           "%" PRIu32 " frames, %" PRIu32 " ms/frame, %" PRIu32 ".%" PRIu32
+           " flushes/frame, %" PRIu32 " areas merged, %" PRIu32
+           " KB flushed at %" PRIu32 " KB/s",
+           frames, display_stats.frame_ms / frames, flushes / 10, flushes % 10,
+           display_stats.merged, bytes / 1024,
+           flush_us ? (uint32_t)((uint64_t)bytes * 1000000 / 1024 / flush_us)
+                    : 0);
+
+  display_stats.since = now;
+  display_stats.frames = 0;
+  display_stats.frame_ms = 0;
+  display_stats.pixels = 0;
+  display_stats.flushes = 0;
+  display_stats.merged = 0;
+  display_stats.flush_us = 0;
+}
+#endif
+
+#if CONFIG_SCREEN_DISPLAY_MERGE_OVERHEAD_US > 0
+/*
+ * Every flush costs a CASET/RASET/RAMWR command sequence, an SPI transaction
+ * and a flush-ready interrupt on top of its pixels, about
+ * CONFIG_SCREEN_DISPLAY_MERGE_OVERHEAD_US. At LCD_PIXEL_CLOCK_HZ with 16-bit
+ * pixels that is worth this many pixels of transfer.
+ */
+#define DISPLAY_MERGE_OVERHEAD_PX                                              \
+  ((uint32_t)((uint64_t)CONFIG_SCREEN_DISPLAY_MERGE_OVERHEAD_US *              \
+              LCD_PIXEL_CLOCK_HZ / 16 / 1000000))
+
+/**
+ * @brief Join dirty areas whose bounding box is cheaper to send than both
+ *
+ * LVGL only joins two areas when their bounding box is smaller than the two
+ * together. Here a join is also taken when the extra pixels cost less than
+ * the flush it saves, which turns scattered label updates into a few larger
+ * flushes. Greedy and quadratic, over at most LV_INV_BUF_SIZE areas.
+ */
+static void display_merge_areas(lv_disp_t *disp) {
+  bool merged;
+
+  do {
+    merged = false;
+    for (uint16_t i = 0; i < disp->inv_p; i++) {
+      if (disp->inv_area_joined[i]) {
+        continue;
+      }
+      for (uint16_t j = i + 1; j < disp->inv_p; j++) {
+        if (disp->inv_area_joined[j]) {
+          continue;
+        }
+
+        lv_area_t joined;
+        _lv_area_join(&joined, &disp->inv_areas[i], &disp->inv_areas[j]);
+        if (lv_area_get_size(&joined) >=
+            lv_area_get_size(&disp->inv_areas[i]) +
+                lv_area_get_size(&disp->inv_areas[j]) +
+                DISPLAY_MERGE_OVERHEAD_PX) {
+          continue;
+        }
+
+        disp->inv_areas[i] = joined;
+        disp->inv_area_joined[j] = 1;
+        merged = true;
+#if CONFIG_SCREEN_DISPLAY_STATS
+        display_stats.merged++;
+#endif
+      }
+    }
+  } while (merged);
+}
+
+/**
+ * @brief Display refresh timer, merges the dirty areas before LVGL renders
+ */
+static void display_refr_timer(lv_timer_t *timer) {
+  display_merge_areas(timer->user_data);
+  _lv_disp_refr_timer(timer);
+}
+#endif
+
+#if CONFIG_SCREEN_DISPLAY_BOUNCE
+static lv_color_t *bounce_buf[2];
+static SemaphoreHandle_t bounce_free;    // bounce buffers not being sent
+static volatile uint32_t bounce_pending; // transfers left in this flush
+#endif
+
 void lvgl_flush_cb(lv_disp_drv_t *drv, const lv_area_t *area,
                    lv_color_t *color_map) {
   int offsetx1 = area->x1;
   int offsetx2 = area->x2;
   int offsety1 = area->y1;
   int offsety2 = area->y2;
-  // copy a buffer's content to a specific area of the display
 
+#if CONFIG_SCREEN_DISPLAY_STATS
+  display_stats.flush_start = esp_timer_get_time();
+  display_stats.flushes++;
+#endif
+
+#if CONFIG_SCREEN_DISPLAY_BOUNCE
+  // The area is contiguous in color_map, send it LCD_BOUNCE_HEIGHT lines at a
+  // time alternating the two bounce buffers; transfers complete in order, so
+  // bounce_free being available means the older of the two is free again.
+  int width = offsetx2 - offsetx1 + 1;
+  int lines = LCD_BOUNCE_LENGTH / width;
+  int height = offsety2 - offsety1 + 1;
+
+  bounce_pending = (height + lines - 1) / lines;
+  for (int y = offsety1, i = 0; y <= offsety2; y += lines, i ^= 1) {
+    int count = offsety2 + 1 - y < lines ? offsety2 + 1 - y : lines;
+    xSemaphoreTake(bounce_free, portMAX_DELAY);
+    memcpy(bounce_buf[i], color_map, count * width * sizeof(lv_color_t));
+    color_map += count * width;
+    esp_lcd_panel_draw_bitmap(panel_handle, offsetx1, y, offsetx2 + 1,
+                              y + count, bounce_buf[i]);
+  }
+#else
+  // copy a buffer's content to a specific area of the display
   esp_lcd_panel_draw_bitmap(panel_handle, offsetx1, offsety1, offsetx2 + 1,
                             offsety2 + 1, color_map);
+#endif
+}
+
+/**
+ * @brief esp_lcd on_color_trans_done, called from the SPI ISR
+ */
+bool lvgl_notify_flush_ready(esp_lcd_panel_io_handle_t panel_io,
+                             esp_lcd_panel_io_event_data_t *edata,
+                             void *user_ctx) {
+  BaseType_t woken = pdFALSE;
+
+#if CONFIG_SCREEN_DISPLAY_BOUNCE
+  xSemaphoreGiveFromISR(bounce_free, &woken);
+  if (--bounce_pending > 0) {
+    return woken == pdTRUE;
+  }
+#endif
+
+#if CONFIG_SCREEN_DISPLAY_STATS
+  display_stats.flush_us += esp_timer_get_time() - display_stats.flush_start;
+#endif
+  lv_disp_flush_ready(&disp_drv);
+  return woken == pdTRUE;
 }
 
 void lvgl_touch_cb(lv_indev_drv_t *drv, lv_indev_data_t *data) {
@@ -47,16 +216,16 @@ void lv_port_disp_init(void) {
 
   static lv_disp_draw_buf_t draw_buf;
 
-  lv_color_t *buf1 = heap_caps_malloc(LCD_BUF_LENGTH * sizeof(lv_color_t),
-                                      MALLOC_CAP_INTERNAL | MALLOC_CAP_DMA);
+  lv_color_t *buf1 =
+      heap_caps_malloc(LCD_BUF_LENGTH * sizeof(lv_color_t), LCD_BUF_CAPS);
 
   if (!buf1) {
     ESP_LOGE("lv_port_disp_init", "ERRORE FATALE: impossibile allocare buf1!");
     abort();
   }
 
-  lv_color_t *buf2 = heap_caps_malloc(LCD_BUF_LENGTH * sizeof(lv_color_t),
-                                      MALLOC_CAP_INTERNAL | MALLOC_CAP_DMA);
+  lv_color_t *buf2 =
+      heap_caps_malloc(LCD_BUF_LENGTH * sizeof(lv_color_t), LCD_BUF_CAPS);
 
   if (!buf2) {
     ESP_LOGE("lv_port_disp_init", "ERRORE FATALE: impossibile allocare buf2!");
@@ -65,6 +234,19 @@ void lv_port_disp_init(void) {
   lv_disp_draw_buf_init(&draw_buf, buf1, buf2,
                         LCD_BUF_LENGTH); /*Initialize the display buffer*/
 
+#if CONFIG_SCREEN_DISPLAY_BOUNCE
+  for (int i = 0; i < 2; i++) {
+    bounce_buf[i] =
+        heap_caps_malloc(LCD_BOUNCE_LENGTH * sizeof(lv_color_t),
+                         MALLOC_CAP_INTERNAL | MALLOC_CAP_DMA);
+    if (!bounce_buf[i]) {
+      ESP_LOGE("lv_port_disp_init", "Cannot allocate the bounce buffers");
+      abort();
+    }
+  }
+  bounce_free = xSemaphoreCreateCounting(2, 2);
+#endif
+
   /*-----------------------------------
    * Register the display in LVGL
    *----------------------------------*/
@@ -85,15 +267,26 @@ void lv_port_disp_init(void) {
 
   /*Required for Example 3)*/
   disp_drv.full_refresh = 0;
+  // No direct_mode: the panel keeps its own frame in GRAM, and rendering each
+  // area contiguously lets it go out in one transfer
   // disp_drv.direct_mode = 1;
 
+#if CONFIG_SCREEN_DISPLAY_STATS
+  display_stats.since = esp_timer_get_time();
+  disp_drv.monitor_cb = display_stats_monitor;
+#endif
+
   /* Fill a memory array with a color if you have GPU.
    * Note that, in lv_conf.h you can enable GPUs that has built-in support in
    * LVGL. But if you have a different GPU you can use with this callback.*/
   // disp_drv.gpu_fill_cb = gpu_fill;
 
   /*Finally register the driver*/
-  lv_disp_drv_register(&disp_drv);
+  lv_disp_t *disp = lv_disp_drv_register(&disp_drv);
+
+#if CONFIG_SCREEN_DISPLAY_MERGE_OVERHEAD_US > 0
+  lv_timer_set_cb(disp->refr_timer, display_refr_timer);
+#endif
 }
 
 void lv_port_indev_init(void) {
@@ -7,8 +7,10 @@
 #include "esp_flash.h"
 #include "esp_system.h"
 #include "esp_timer.h"
+#include "history.h"
+#include "sample_log.h"
 #include "sdkconfig.h"
-#include "tusb_cdc.h"
+#include "transport.h"
 #include <inttypes.h>
 #include <stdio.h>
 #include <time.h>
@@ -74,13 +76,16 @@ void app_main(void) {
   lv_port_indev_init();
   bsp_brightness_init();
   bsp_brightness_set_level(90);
-  tusb_cdc_init();
 
   if (lvgl_lock(-1)) {
     lvgl_anemometer_ui_init(lv_scr_act());
 
     lvgl_unlock();
   }
+  history_init();
+  sample_log_init();
+  // After the UI, so the status queue exists before the first frame
+  transport_init();
   xTaskCreatePinnedToCore(task, "bsp_lv_port_task", 1024 * 20, NULL, 5, NULL,
                           1);
 }
@@ -0,0 +1,262 @@
+#include "pm_stats.h"
+#include "snapshot.h"
+#include "transport.h"
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+// Breakpoint ranges, one per AqiCategory
+#define AQI_RANGES 6
+
+const char *aqi_category_name(uint8_t category) {
+  static const char *const names[AQI_RANGES] = {
+      "Good",      "Moderate",       "Unhealthy for sensitive groups",
+      "Unhealthy", "Very unhealthy", "Hazardous",
+  };
+  return category < AQI_RANGES ? names[category] : "";
+}
+
+#if CONFIG_SCREEN_PM_STATS
+
+typedef struct {
+  uint16_t c_lo; // tenths of ug/m3
+  uint16_t c_hi;
+  uint16_t i_lo;
+  uint16_t i_hi;
+  uint32_t slope; // index points per tenth, Q16
+} AqiBreakpoint;
+
+#define AQI_BREAKPOINT(c_lo, c_hi, i_lo, i_hi)                                 \
+  {(c_lo), (c_hi), (i_lo), (i_hi),                                             \
+   (uint32_t)((((i_hi) - (i_lo)) << 16) / ((c_hi) - (c_lo)))}
+
+// US EPA, 2024. PM2.5 is truncated to 0.1 ug/m3 and PM10 to 1 ug/m3 first.
+static const AqiBreakpoint aqi_pm_2_5[AQI_RANGES] = {
+    AQI_BREAKPOINT(0, 90, 0, 50),         AQI_BREAKPOINT(91, 354, 51, 100),
+    AQI_BREAKPOINT(355, 554, 101, 150),   AQI_BREAKPOINT(555, 1254, 151, 200),
+    AQI_BREAKPOINT(1255, 2254, 201, 300), AQI_BREAKPOINT(2255, 3254, 301, 500),
+};
+static const AqiBreakpoint aqi_pm_10[AQI_RANGES] = {
+    AQI_BREAKPOINT(0, 540, 0, 50),        AQI_BREAKPOINT(550, 1540, 51, 100),
+    AQI_BREAKPOINT(1550, 2540, 101, 150), AQI_BREAKPOINT(2550, 3540, 151, 200),
+    AQI_BREAKPOINT(3550, 4240, 201, 300), AQI_BREAKPOINT(4250, 6040, 301, 500),
+};
+
+#define PM_HOUR_MINUTES 60
+#define PM_DAY_MINUTES (24 * 60)
+
+// Sample values are clamped to the SPS30 range, 1000 ug/m3
+#define PM_MAX_CENTI 100000
+
+typedef struct {
+  uint32_t pm_2_5; // sum, hundredths of ug/m3
+  uint32_t pm_10;
+  uint16_t n;
+} PmBucket;
+
+typedef struct {
+  uint64_t pm_2_5; // sums of the buckets in the window
+  uint64_t pm_10;
+  uint32_t n;
+  uint16_t filled; // buckets with a sample
+} PmAggregate;
+
+static PmBucket buckets[PM_DAY_MINUTES]; // by minute since the epoch
+static uint32_t minute;                  // the bucket filling
+static bool started;
+
+static PmAggregate hour; // the last PM_HOUR_MINUTES buckets
+static PmAggregate day;  // all of them
+
+static PmStats stats_storage[3];
+static Snapshot stats_snapshot = SNAPSHOT_INIT(stats_storage);
+
+static PmBucket *bucket_at(uint32_t at) {
+  return &buckets[at % PM_DAY_MINUTES];
+}
+
+static void aggregate_remove(PmAggregate *aggregate, const PmBucket *bucket) {
+  aggregate->pm_2_5 -= bucket->pm_2_5;
+  aggregate->pm_10 -= bucket->pm_10;
+  aggregate->n -= bucket->n;
+  if (bucket->n > 0) {
+    aggregate->filled--;
+  }
+}
+
+/**
+ * @brief Start the next minute, dropping the minute each window leaves
+ *
+ * The bucket reused for the new minute is the one the day window leaves.
+ */
+static void minute_advance(void) {
+  minute++;
+  aggregate_remove(&hour, bucket_at(minute - PM_HOUR_MINUTES));
+  PmBucket *bucket = bucket_at(minute);
+  aggregate_remove(&day, bucket);
+  *bucket = (PmBucket){0};
+}
+
+static void pm_stats_reset(uint32_t now) {
+  memset(buckets, 0, sizeof(buckets));
+  minute = now;
+  hour = (PmAggregate){0};
+  day = (PmAggregate){0};
+  started = true;
+}
+
+static uint32_t to_centi(float value) {
+  if (!(value > 0)) {
+    return 0;
+  }
+  return value >= PM_MAX_CENTI / 100 ? PM_MAX_CENTI
+                                     : (uint32_t)lroundf(value * 100);
+}
+
+static void aggregate_add(PmAggregate *aggregate, uint32_t pm_2_5,
+                          uint32_t pm_10, bool first) {
+  aggregate->pm_2_5 += pm_2_5;
+  aggregate->pm_10 += pm_10;
+  aggregate->n++;
+  if (first) {
+    aggregate->filled++;
+  }
+}
+
+static PmWindow aggregate_window(const PmAggregate *aggregate) {
+  PmWindow window = {
+      .samples = aggregate->n,
+      .minutes = aggregate->filled,
+  };
+  if (aggregate->n > 0) {
+    window.pm_2_5 = (float)aggregate->pm_2_5 / aggregate->n / 100;
+    window.pm_10 = (float)aggregate->pm_10 / aggregate->n / 100;
+  }
+  return window;
+}
+
+/**
+ * @brief Sub-index of a truncated concentration, in tenths of ug/m3
+ */
+static uint16_t aqi_sub_index(const AqiBreakpoint *table, uint32_t tenths) {
+  for (size_t i = 0; i < AQI_RANGES; i++) {
+    const AqiBreakpoint *b = &table[i];
+    if (tenths <= b->c_hi) {
+      return b->i_lo + (((tenths - b->c_lo) * b->slope + 0x8000) >> 16);
+    }
+  }
+  return table[AQI_RANGES - 1].i_hi;
+}
+
+static void aqi_compute(PmStats *stats) {
+  if (day.n == 0) {
+    return;
+  }
+  uint32_t pm_2_5 = day.pm_2_5 / day.n / 10;     // truncated to 0.1
+  uint32_t pm_10 = day.pm_10 / day.n / 100 * 10; // truncated to 1
+  uint16_t aqi_2_5 = aqi_sub_index(aqi_pm_2_5, pm_2_5);
+  uint16_t aqi_10 = aqi_sub_index(aqi_pm_10, pm_10);
+  stats->aqi = aqi_2_5 > aqi_10 ? aqi_2_5 : aqi_10;
+
+  // Both tables share the index ranges of the categories
+  uint8_t category = 0;
+  while (category < AQI_RANGES - 1 &&
+         stats->aqi > aqi_pm_2_5[category].i_hi) {
+    category++;
+  }
+  stats->aqi_category = category;
+}
+
+#if CONFIG_SCREEN_PM_STATS_TX
+static void pm_window_append(char *msg, size_t size, const char *name,
+                             const PmWindow *window) {
+  size_t len = strlen(msg);
+  snprintf(msg + len, size - len,
+           ",\"%s\":{\"n\":%" PRIu32 ",\"minutes\":%u,\"pm2_5\":%.2f,"
+           "\"pm10\":%.2f}",
+           name, window->samples, window->minutes, window->pm_2_5,
+           window->pm_10);
+}
+
+/**
+ * @brief Send the averages to the bridge, once per minute
+ *
+ * Built with snprintf() rather than cJSON, as the wind statistics.
+ */
+static void pm_stats_send(const PmStats *stats) {
+  char msg[256];
+  snprintf(msg, sizeof(msg),
+           "{\"type\":\"pm_stats\",\"timestamp\":%" PRIu32
+           ",\"aqi\":%u,\"aqi_category\":\"%s\"",
+           stats->timestamp, stats->aqi,
+           aqi_category_name(stats->aqi_category));
+  pm_window_append(msg, sizeof(msg), "1h", &stats->hour);
+  pm_window_append(msg, sizeof(msg), "24h", &stats->day);
+  size_t len = strlen(msg);
+  snprintf(msg + len, sizeof(msg) - len, "}");
+  transport_write(msg);
+}
+#endif
+
+static void pm_stats_publish(uint32_t timestamp, bool send) {
+  PmStats stats = {
+      .timestamp = timestamp,
+      .hour = aggregate_window(&hour),
+      .day = aggregate_window(&day),
+  };
+  aqi_compute(&stats);
+  snapshot_publish(&stats_snapshot, &stats);
+#if CONFIG_SCREEN_PM_STATS_TX
+  if (send) {
+    pm_stats_send(&stats);
+  }
+#endif
+}
+
+/**
+ * @brief Add an SPS30 sample, RX task only
+ *
+ * A sample older than the previous one is taken as simultaneous with it;
+ * after a gap longer than a day everything starts over. The averages are
+ * sent to the bridge when a minute closes.
+ */
+void pm_stats_add(const ParticulateMatterData *pm_data) {
+  if (isnan(pm_data->mass_density_pm_2_5) ||
+      isnan(pm_data->mass_density_pm_10)) {
+    return;
+  }
+
+  uint32_t now = pm_data->timestamp / 60;
+  bool closed = false;
+  if (!started || now >= minute + PM_DAY_MINUTES) {
+    pm_stats_reset(now);
+  }
+  while (minute < now) {
+    minute_advance();
+    closed = true;
+  }
+
+  uint32_t pm_2_5 = to_centi(pm_data->mass_density_pm_2_5);
+  uint32_t pm_10 = to_centi(pm_data->mass_density_pm_10);
+  PmBucket *bucket = bucket_at(minute);
+  bool first = bucket->n == 0;
+  bucket->pm_2_5 += pm_2_5;
+  bucket->pm_10 += pm_10;
+  bucket->n++;
+  aggregate_add(&hour, pm_2_5, pm_10, first);
+  aggregate_add(&day, pm_2_5, pm_10, first);
+
+  pm_stats_publish(pm_data->timestamp, closed);
+}
+
+/**
+ * @brief Latest averages, LVGL task only
+ *
+ * @return true if they changed since the previous call
+ */
+bool pm_stats_latest(const PmStats **stats) {
+  return snapshot_read(&stats_snapshot, (const void **)stats);
+}
+
+#endif
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "data.h"
+#include "sdkconfig.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @brief Rolling 1 h and 24 h PM2.5 and PM10 averages and their AQI.
+ *
+ * Fed with every SPS30 sample by the RX task. Each minute of the last 24 h is
+ * a bucket with the sample count and the sums of both mass densities, in
+ * hundredths of ug/m3; each window keeps the running sums of its buckets and
+ * subtracts a bucket as it slides out. The integer sums never drift however
+ * long the screen runs, a sample costs O(1) and the memory is fixed.
+ *
+ * Time comes from the sample timestamps; a window covers its complete minutes
+ * plus the minute being filled. Samples with a missing PM2.5 or PM10 are
+ * left out.
+ *
+ * The AQI is the US EPA index of the 24 h averages, the higher of the PM2.5
+ * and PM10 sub-indices, with the category of its breakpoint range.
+ *
+ * Without CONFIG_SCREEN_PM_STATS every call is a no-op that finds nothing.
+ */
+
+typedef enum {
+  AQI_GOOD,
+  AQI_MODERATE,
+  AQI_UNHEALTHY_SENSITIVE,
+  AQI_UNHEALTHY,
+  AQI_VERY_UNHEALTHY,
+  AQI_HAZARDOUS,
+} AqiCategory;
+
+typedef struct PmWindow {
+  uint32_t samples;
+  uint16_t minutes; // with at least one sample, for the coverage
+  float pm_2_5;     // mean mass density, ug/m3
+  float pm_10;
+} PmWindow;
+
+typedef struct PmStats {
+  uint32_t timestamp; // of the last sample, seconds since the epoch
+  PmWindow hour;
+  PmWindow day;
+  uint16_t aqi;         // 0 to 500
+  uint8_t aqi_category; // AqiCategory
+} PmStats;
+
+const char *aqi_category_name(uint8_t category);
+
+#if CONFIG_SCREEN_PM_STATS
+
+void pm_stats_add(const ParticulateMatterData *pm_data);
+bool pm_stats_latest(const PmStats **stats);
+
+#else
+
+static inline void pm_stats_add(const ParticulateMatterData *pm_data) {}
+static inline bool pm_stats_latest(const PmStats **stats) { return false; }
+
+#endif
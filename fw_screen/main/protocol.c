@@ -0,0 +1,256 @@
+#include "protocol.h"
+#include "esp_log.h"
+#include <math.h>
+#include <string.h>
+
+static const char *TAG = "PROTOCOL";
+
+static uint16_t rd_u16(const uint8_t *p) {
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t rd_u32(const uint8_t *p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) |
+         ((uint32_t)p[3] << 24);
+}
+
+static float rd_f32(const uint8_t *p) {
+  uint32_t bits = rd_u32(p);
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+// Assign only when the bridge sent the field
+static void set_if_present(float *dst, const uint8_t *p) {
+  float value = rd_f32(p);
+  if (!isnan(value)) {
+    *dst = value;
+  }
+}
+
+static void set_centi_if_present(int16_t *dst, const uint8_t *p) {
+  float value = rd_f32(p);
+  if (!isnan(value)) {
+    *dst = data_to_centi(value);
+  }
+}
+
+static uint8_t unit_of(uint8_t code) {
+  return code < UNIT_COUNT ? code : UNIT_NONE;
+}
+
+/**
+ * @brief Decode a COBS block in place
+ *
+ * @return decoded length, 0 on malformed input
+ */
+size_t cobs_decode(uint8_t *buf, size_t len) {
+  size_t read = 0;
+  size_t write = 0;
+
+  while (read < len) {
+    uint8_t code = buf[read++];
+    if (code == 0 || read + code - 1 > len) {
+      return 0;
+    }
+
+    memmove(buf + write, buf + read, code - 1);
+    write += code - 1;
+    read += code - 1;
+
+    if (code != 0xFF && read < len) {
+      buf[write++] = 0;
+    }
+  }
+
+  return write;
+}
+
+/**
+ * @brief CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF)
+ */
+uint16_t crc16_ccitt(const uint8_t *data, size_t len) {
+  uint16_t crc = 0xFFFF;
+
+  for (size_t i = 0; i < len; i++) {
+    crc ^= (uint16_t)data[i] << 8;
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+  }
+  return crc;
+}
+
+/**
+ * @brief Payload length of a single sample frame type, 0 for other types
+ */
+size_t proto_sample_len(uint8_t type) {
+  switch (type) {
+  case FRAME_ANEMOMETER:
+    return PROTO_ANEMOMETER_LEN;
+  case FRAME_PARTICULATE_MATTER:
+    return PROTO_PARTICULATE_MATTER_LEN;
+  case FRAME_IMU:
+    return PROTO_IMU_LEN;
+  default:
+    return 0;
+  }
+}
+
+/**
+ * @brief Decode a received frame in place and check version and CRC
+ *
+ * On success the payload is NUL-terminated (over the CRC bytes), so text
+ * payloads can be used as C strings without copying.
+ *
+ * @param[in]  frame       COBS encoded frame, without the 0x00 delimiter
+ * @param[in]  len         Encoded length
+ * @param[out] type        Frame type
+ * @param[out] payload     Payload inside frame
+ * @param[out] payload_len Payload length
+ */
+bool proto_unpack_frame(uint8_t *frame, size_t len, uint8_t *type,
+                        uint8_t **payload, size_t *payload_len) {
+  size_t decoded_len = cobs_decode(frame, len);
+  if (decoded_len < PROTO_HEADER_LEN + PROTO_CRC_LEN) {
+    ESP_LOGW(TAG, "Malformed frame (%u bytes)", (unsigned)len);
+    return false;
+  }
+
+  size_t body_len = decoded_len - PROTO_CRC_LEN;
+  if (crc16_ccitt(frame, body_len) != rd_u16(frame + body_len)) {
+    ESP_LOGW(TAG, "CRC mismatch (%u bytes)", (unsigned)decoded_len);
+    return false;
+  }
+
+  if (frame[0] != PROTO_VERSION) {
+    ESP_LOGW(TAG, "Unsupported frame version %u", frame[0]);
+    return false;
+  }
+
+  *type = frame[1];
+  *payload = frame + PROTO_HEADER_LEN;
+  *payload_len = body_len - PROTO_HEADER_LEN;
+  frame[body_len] = '\0';
+  return true;
+}
+
+/**
+ * @brief Check a FRAME_BATCH payload
+ *
+ * @param[out] type    Type of the samples
+ * @param[out] count   Number of samples
+ * @param[out] samples First sample, the others follow every
+ *                     proto_sample_len(type) bytes
+ */
+bool proto_unpack_batch(const uint8_t *payload, size_t len, uint8_t *type,
+                        uint8_t *count, const uint8_t **samples) {
+  if (len < PROTO_BATCH_HEADER_LEN) {
+    ESP_LOGW(TAG, "Short batch frame (%u bytes)", (unsigned)len);
+    return false;
+  }
+
+  size_t sample_len = proto_sample_len(payload[0]);
+  if (sample_len == 0 ||
+      len - PROTO_BATCH_HEADER_LEN < payload[1] * sample_len) {
+    ESP_LOGW(TAG, "Malformed batch: type 0x%02x, %u samples, %u bytes",
+             payload[0], payload[1], (unsigned)len);
+    return false;
+  }
+
+  *type = payload[0];
+  *count = payload[1];
+  *samples = payload + PROTO_BATCH_HEADER_LEN;
+  return true;
+}
+
+bool proto_decode_anemometer(const uint8_t *payload, size_t len,
+                             AnemometerData *anm_data) {
+  if (len < PROTO_ANEMOMETER_LEN) {
+    ESP_LOGW(TAG, "Short anemometer frame (%u bytes)", (unsigned)len);
+    return false;
+  }
+
+  anm_data->timestamp = rd_u32(payload);
+  anm_data->timestamp_ms = rd_u16(payload + 4);
+
+  // AnemometerData.flags uses the wire bits, only the present ones change
+  uint16_t flags = rd_u16(payload + 6);
+  uint8_t present = (flags >> 8) & 0x3F;
+  anm_data->flags = (anm_data->flags & ~present) | (flags & present);
+
+  set_if_present(&anm_data->x_vout, payload + 8);
+  set_if_present(&anm_data->y_vout, payload + 12);
+  set_if_present(&anm_data->z_vout, payload + 16);
+  set_centi_if_present(&anm_data->temp_sonica_x, payload + 20);
+  set_centi_if_present(&anm_data->temp_sonica_y, payload + 24);
+  set_centi_if_present(&anm_data->temp_sonica_z, payload + 28);
+  return true;
+}
+
+bool proto_decode_particulate_matter(const uint8_t *payload, size_t len,
+                                     ParticulateMatterData *pm_data) {
+  if (len < PROTO_PARTICULATE_MATTER_LEN) {
+    ESP_LOGW(TAG, "Short SPS frame (%u bytes)", (unsigned)len);
+    return false;
+  }
+
+  pm_data->timestamp = rd_u32(payload);
+  pm_data->timestamp_ms = rd_u16(payload + 4);
+
+  pm_data->mass_density_unit = unit_of(payload[6]);
+  pm_data->particle_count_unit = unit_of(payload[7]);
+  pm_data->particle_size_unit = unit_of(payload[8]);
+
+  set_if_present(&pm_data->mass_density_pm_1_0, payload + 10);
+  set_if_present(&pm_data->mass_density_pm_2_5, payload + 14);
+  set_if_present(&pm_data->mass_density_pm_4_0, payload + 18);
+  set_if_present(&pm_data->mass_density_pm_10, payload + 22);
+
+  set_if_present(&pm_data->particle_count_0_5, payload + 26);
+  set_if_present(&pm_data->particle_count_1_0, payload + 30);
+  set_if_present(&pm_data->particle_count_2_5, payload + 34);
+  set_if_present(&pm_data->particle_count_4_0, payload + 38);
+  set_if_present(&pm_data->particle_count_10, payload + 42);
+
+  set_if_present(&pm_data->particle_size, payload + 46);
+  return true;
+}
+
+bool proto_decode_imu(const uint8_t *payload, size_t len, ImuData *imu_data) {
+  if (len < PROTO_IMU_LEN) {
+    ESP_LOGW(TAG, "Short IMU frame (%u bytes)", (unsigned)len);
+    return false;
+  }
+
+  imu_data->timestamp = rd_u32(payload);
+  imu_data->timestamp_ms = rd_u16(payload + 4);
+
+  struct {
+    float *x, *y, *z;
+    uint8_t *unit;
+  } const devs[] = {
+      {&imu_data->acc_top_x, &imu_data->acc_top_y, &imu_data->acc_top_z,
+       &imu_data->acc_top_unit},
+      {&imu_data->acc_x, &imu_data->acc_y, &imu_data->acc_z,
+       &imu_data->acc_unit},
+      {&imu_data->mag_x, &imu_data->mag_y, &imu_data->mag_z,
+       &imu_data->mag_unit},
+      {&imu_data->gyr_x, &imu_data->gyr_y, &imu_data->gyr_z,
+       &imu_data->gyr_unit},
+  };
+
+  uint8_t present = payload[6];
+  for (int i = 0; i < 4; i++) {
+    if (!(present & (1 << i))) {
+      continue;
+    }
+    const uint8_t *values = payload + 12 + i * 12;
+    *devs[i].unit = unit_of(payload[8 + i]);
+    set_if_present(devs[i].x, values);
+    set_if_present(devs[i].y, values + 4);
+    set_if_present(devs[i].z, values + 8);
+  }
+  return true;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "data.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Binary telemetry frames (bridge -> screen)
+ *
+ * On the wire every frame is COBS encoded and terminated by a 0x00 byte.
+ * Decoded, a frame is:
+ *
+ *   u8 version | u8 type | payload | u16 crc
+ *
+ * where crc is CRC-16/CCITT-FALSE over version, type and payload. All
+ * multi-byte fields are little-endian, floats are IEEE-754 binary32 and a NaN
+ * float means "field not present" (the previous value is kept). Unit bytes
+ * are Unit values (data.h), unknown codes read as UNIT_NONE.
+ */
+#define PROTO_VERSION 1
+#define PROTO_HEADER_LEN 2
+#define PROTO_CRC_LEN 2
+
+typedef enum {
+  FRAME_ANEMOMETER = 0x01,
+  FRAME_PARTICULATE_MATTER = 0x02,
+  FRAME_IMU = 0x03,
+  FRAME_STATUS = 0x04,
+  FRAME_BATCH = 0x10,
+  FRAME_JSON = 0x7F,
+} FrameType;
+
+/*
+ * FRAME_ANEMOMETER payload (32 bytes)
+ *
+ *   u32 ts_s | u16 ts_ms | u16 flags
+ *   f32 x_vout | f32 y_vout | f32 z_vout
+ *   f32 temp_sonica_x | f32 temp_sonica_y | f32 temp_sonica_z
+ *
+ * flags bit 0..2: autocalibrazione_asse_{x,y,z}
+ *       bit 3..5: autocalibrazione_misura_{x,y,z}
+ *       bit 8..13: the matching bit above is present
+ */
+#define PROTO_ANEMOMETER_LEN 32
+
+/*
+ * FRAME_PARTICULATE_MATTER payload (50 bytes)
+ *
+ *   u32 ts_s | u16 ts_ms
+ *   u8 mass_density_unit | u8 particle_count_unit | u8 particle_size_unit
+ *   u8 reserved
+ *   f32 mass_density pm1.0 | pm2.5 | pm4.0 | pm10
+ *   f32 particle_count pm0.5 | pm1.0 | pm2.5 | pm4.0 | pm10
+ *   f32 particle_size
+ */
+#define PROTO_PARTICULATE_MATTER_LEN 50
+
+/*
+ * FRAME_IMU payload (60 bytes)
+ *
+ *   u32 ts_s | u16 ts_ms | u8 present | u8 reserved
+ *   u8 unit[4]
+ *   f32 x, y, z for acctop, acc, mag, gyr (in this order)
+ *
+ * present bit n: device n was part of the sample
+ */
+#define PROTO_IMU_LEN 60
+
+/*
+ * FRAME_BATCH payload
+ *
+ *   u8 type | u8 count | count x sample payload
+ *
+ * Carries count samples of one of the sample types above, oldest first, each
+ * with its own timestamp.
+ */
+#define PROTO_BATCH_HEADER_LEN 2
+
+/*
+ * FRAME_STATUS payload: UTF-8 status text, not terminated.
+ * FRAME_JSON payload: a JSON document, for anything without a binary layout.
+ */
+
+size_t cobs_decode(uint8_t *buf, size_t len);
+uint16_t crc16_ccitt(const uint8_t *data, size_t len);
+size_t proto_sample_len(uint8_t type);
+
+bool proto_unpack_frame(uint8_t *frame, size_t len, uint8_t *type,
+                        uint8_t **payload, size_t *payload_len);
+bool proto_unpack_batch(const uint8_t *payload, size_t len, uint8_t *type,
+                        uint8_t *count, const uint8_t **samples);
+bool proto_decode_anemometer(const uint8_t *payload, size_t len,
+                             AnemometerData *anm_data);
+bool proto_decode_particulate_matter(const uint8_t *payload, size_t len,
+                                     ParticulateMatterData *pm_data);
+bool proto_decode_imu(const uint8_t *payload, size_t len, ImuData *imu_data);
@@ -0,0 +1,176 @@
+#include "ring_buffer.h"
+#include <string.h>
+
+void ring_buffer_init(RingBuffer *rb, uint8_t *storage, size_t size,
+                      size_t frame_max) {
+  rb->buf = storage;
+  rb->size = size;
+  rb->frame_max = frame_max;
+  atomic_init(&rb->head, 0);
+  atomic_init(&rb->tail, 0);
+  rb->pending = 0;
+  rb->scan = 0;
+  rb->discarding = false;
+  rb->oversized_frames = 0;
+  rb->released = 0;
+}
+
+size_t ring_buffer_used(RingBuffer *rb) {
+  size_t head = atomic_load_explicit(&rb->head, memory_order_acquire);
+  size_t tail = atomic_load_explicit(&rb->tail, memory_order_acquire);
+  return (head + rb->size - tail) % rb->size;
+}
+
+size_t ring_buffer_free(RingBuffer *rb) {
+  // One slot is always kept empty to tell a full ring from an empty one
+  return rb->size - 1 - ring_buffer_used(rb);
+}
+
+/**
+ * @brief Get the contiguous free region at the producer position
+ *
+ * @param[out] len Number of bytes that can be written at the returned pointer
+ */
+uint8_t *ring_buffer_write_acquire(RingBuffer *rb, size_t *len) {
+  size_t head = atomic_load_explicit(&rb->head, memory_order_relaxed);
+  size_t tail = atomic_load_explicit(&rb->tail, memory_order_acquire);
+
+  if (head >= tail) {
+    *len = rb->size - head - (tail == 0 ? 1 : 0);
+  } else {
+    *len = tail - head - 1;
+  }
+  return rb->buf + head;
+}
+
+void ring_buffer_write_commit(RingBuffer *rb, size_t len) {
+  size_t head = atomic_load_explicit(&rb->head, memory_order_relaxed);
+  atomic_store_explicit(&rb->head, (head + len) % rb->size,
+                        memory_order_release);
+}
+
+/**
+ * @brief Copy as much of data as fits
+ *
+ * @return number of bytes written
+ */
+size_t ring_buffer_write(RingBuffer *rb, const uint8_t *data, size_t len) {
+  size_t written = 0;
+
+  // At most two rounds: up to the end of the ring, then from its start
+  for (int i = 0; i < 2 && written < len; i++) {
+    size_t free_len = 0;
+    uint8_t *dst = ring_buffer_write_acquire(rb, &free_len);
+    size_t chunk = len - written < free_len ? len - written : free_len;
+    if (chunk == 0) {
+      break;
+    }
+    memcpy(dst, data + written, chunk);
+    ring_buffer_write_commit(rb, chunk);
+    written += chunk;
+  }
+  return written;
+}
+
+/**
+ * @brief Get the contiguous used region at the consumer position
+ *
+ * @param[out] len Number of bytes that can be read at the returned pointer
+ */
+const uint8_t *ring_buffer_read_acquire(RingBuffer *rb, size_t *len) {
+  size_t head = atomic_load_explicit(&rb->head, memory_order_acquire);
+  size_t tail = atomic_load_explicit(&rb->tail, memory_order_relaxed);
+
+  *len = head >= tail ? head - tail : rb->size - tail;
+  return rb->buf + tail;
+}
+
+void ring_buffer_read_commit(RingBuffer *rb, size_t len) {
+  size_t tail = atomic_load_explicit(&rb->tail, memory_order_relaxed);
+  tail = (tail + len) % rb->size;
+  rb->pending = tail;
+  rb->scan = tail;
+  rb->released += len;
+  atomic_store_explicit(&rb->tail, tail, memory_order_release);
+}
+
+/**
+ * @brief Get the next complete frame
+ *
+ * The frame is contiguous, does not include the delimiter and is
+ * NUL-terminated in place. It stays valid until ring_buffer_release() is
+ * called; several frames may be fetched before releasing them together.
+ * Empty frames are skipped and frames longer than frame_max are dropped up to
+ * their delimiter.
+ *
+ * @return false when no complete frame is available
+ */
+bool ring_buffer_next_frame(RingBuffer *rb, uint8_t delim, uint8_t **frame,
+                            size_t *len) {
+  size_t head = atomic_load_explicit(&rb->head, memory_order_acquire);
+
+  while (rb->scan != head) {
+    size_t start = rb->pending;
+    size_t pos = rb->scan;
+    rb->scan = (pos + 1) % rb->size;
+
+    size_t frame_len = (pos + rb->size - start) % rb->size;
+
+    if (rb->buf[pos] != delim) {
+      if (!rb->discarding && frame_len >= rb->frame_max) {
+        rb->discarding = true;
+        rb->oversized_frames++;
+      }
+      if (rb->discarding) {
+        // Nothing of an oversized frame is kept, free it as we go
+        rb->pending = rb->scan;
+      }
+      continue;
+    }
+
+    rb->pending = rb->scan;
+
+    if (rb->discarding) {
+      rb->discarding = false;
+      continue;
+    }
+
+    if (frame_len == 0) {
+      continue;
+    }
+
+    if (pos < start) {
+      // Wrapped: move the head of the frame right after the end of the ring
+      memcpy(rb->buf + rb->size, rb->buf, pos);
+      rb->buf[rb->size + pos] = '\0';
+    } else {
+      rb->buf[pos] = '\0';
+    }
+
+    *frame = rb->buf + start;
+    *len = frame_len;
+    return true;
+  }
+
+  return false;
+}
+
+/**
+ * @brief Give back to the producer every frame returned so far
+ */
+void ring_buffer_release(RingBuffer *rb) {
+  size_t tail = atomic_load_explicit(&rb->tail, memory_order_relaxed);
+  rb->released += (rb->pending + rb->size - tail) % rb->size;
+  atomic_store_explicit(&rb->tail, rb->pending, memory_order_release);
+}
+
+/**
+ * @brief Total bytes consumed so far, including frames not released yet
+ *
+ * Counts every byte up to the end of the last frame returned by
+ * ring_buffer_next_frame() (or skipped by it). Wraps at 2^32.
+ */
+uint32_t ring_buffer_consumed(RingBuffer *rb) {
+  size_t tail = atomic_load_explicit(&rb->tail, memory_order_relaxed);
+  return rb->released + (rb->pending + rb->size - tail) % rb->size;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Single-producer / single-consumer byte ring with in-place framing.
+ *
+ * The producer writes straight into the free space returned by
+ * ring_buffer_write_acquire(), so the driver can read into the ring without a
+ * bounce buffer. The consumer gets complete delimiter-terminated frames back as
+ * contiguous, NUL-terminated pointers into the ring storage.
+ *
+ * A frame that wraps around the end of the ring is made contiguous by copying
+ * its head part into the spare area that follows the ring, so a frame is copied
+ * at most once and only when it wraps. The storage passed to ring_buffer_init()
+ * must therefore be RING_BUFFER_STORAGE_SIZE(size, frame_max) bytes long.
+ *
+ * For plain byte streams (frame_max 0) the consumer uses
+ * ring_buffer_read_acquire() / ring_buffer_read_commit() instead of the
+ * framing functions; the two consumer styles must not be mixed on one ring.
+ */
+#define RING_BUFFER_STORAGE_SIZE(size, frame_max) ((size) + (frame_max) + 1)
+
+typedef struct RingBuffer {
+  uint8_t *buf;
+  size_t size;
+  size_t frame_max;
+
+  atomic_size_t head; // written by the producer only
+  atomic_size_t tail; // written by the consumer only
+
+  // Consumer side framing state
+  size_t pending; // end of the last frame handed out, released on demand
+  size_t scan;    // next byte to inspect for the delimiter
+  bool discarding;
+  uint32_t oversized_frames;
+  uint32_t released; // total bytes given back to the producer, wraps
+} RingBuffer;
+
+void ring_buffer_init(RingBuffer *rb, uint8_t *storage, size_t size,
+                      size_t frame_max);
+size_t ring_buffer_used(RingBuffer *rb);
+size_t ring_buffer_free(RingBuffer *rb);
+
+uint8_t *ring_buffer_write_acquire(RingBuffer *rb, size_t *len);
+void ring_buffer_write_commit(RingBuffer *rb, size_t len);
+size_t ring_buffer_write(RingBuffer *rb, const uint8_t *data, size_t len);
+
+const uint8_t *ring_buffer_read_acquire(RingBuffer *rb, size_t *len);
+void ring_buffer_read_commit(RingBuffer *rb, size_t len);
+
+bool ring_buffer_next_frame(RingBuffer *rb, uint8_t delim, uint8_t **frame,
+                            size_t *len);
+void ring_buffer_release(RingBuffer *rb);
+uint32_t ring_buffer_consumed(RingBuffer *rb);
@@ -0,0 +1,631 @@
+#include "sample_log.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "protocol.h"
+#include "ring_buffer.h"
+#include "transport.h"
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#if CONFIG_SCREEN_SAMPLE_LOG
+
+static const char *TAG = "SAMPLE_LOG";
+
+#define SAMPLE_LOG_PARTITION "samplelog"
+#define SAMPLE_LOG_MAGIC 0x474f4c53 // "SLOG"
+#define SAMPLE_LOG_VERSION 1
+
+#define SAMPLE_LOG_SECTOR_SIZE 4096
+#define SAMPLE_LOG_PAGE_SIZE 256
+#define SAMPLE_LOG_RECORD_MAX                                                  \
+  (SAMPLE_LOG_RECORD_HEADER_LEN + 58 + SAMPLE_LOG_RECORD_CRC_LEN)
+
+// Records per export chunk, after its u16 length
+#define SAMPLE_LOG_EXPORT_CHUNK 2048
+#define SAMPLE_LOG_EXPORT_TIMEOUT_MS 1000
+
+_Static_assert(sizeof(SampleLogSector) == 16, "SampleLogSector is padded");
+
+static const esp_partition_t *partition;
+static uint32_t sector_count;
+
+// Encoded records, RX task -> log task
+static RingBuffer queue_ring;
+static uint8_t
+    queue_storage[RING_BUFFER_STORAGE_SIZE(CONFIG_SCREEN_SAMPLE_LOG_BUFFER, 0)];
+static uint32_t dropped_records; // RX task only
+
+static TaskHandle_t log_task_handle;
+static QueueHandle_t export_queue;
+
+typedef struct {
+  uint32_t from;
+  uint32_t to;
+} SampleLogExport;
+
+/*
+ * Write position, log task only. The page buffer holds the page at
+ * page_base of head_sector: page_fill bytes are placed, the first
+ * page_flushed of them are already programmed. A full sector has page_base
+ * SAMPLE_LOG_SECTOR_SIZE, so the next record opens a new one.
+ */
+static bool empty = true;
+static uint32_t oldest_sector; // first in log order
+static uint32_t head_sector;
+static uint32_t head_seq;
+static uint32_t page_base;
+static uint32_t page_fill;
+static uint32_t page_flushed;
+static uint8_t page[SAMPLE_LOG_PAGE_SIZE];
+
+// A sector as read back, for the recovery and the export
+static uint8_t sector_buf[SAMPLE_LOG_SECTOR_SIZE];
+
+static void wr_u16(uint8_t *p, uint16_t value) {
+  p[0] = value;
+  p[1] = value >> 8;
+}
+
+static void wr_u32(uint8_t *p, uint32_t value) {
+  wr_u16(p, value);
+  wr_u16(p + 2, value >> 16);
+}
+
+static void wr_f32(uint8_t *p, float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  wr_u32(p, bits);
+}
+
+static uint32_t rd_u32(const uint8_t *p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) |
+         ((uint32_t)p[3] << 24);
+}
+
+static uint16_t sector_crc(const SampleLogSector *header) {
+  return crc16_ccitt((const uint8_t *)header,
+                     offsetof(SampleLogSector, crc));
+}
+
+static bool sector_header(uint32_t sector, SampleLogSector *header) {
+  if (esp_partition_read(partition, sector * SAMPLE_LOG_SECTOR_SIZE, header,
+                         sizeof(*header)) != ESP_OK) {
+    return false;
+  }
+  return header->magic == SAMPLE_LOG_MAGIC &&
+         header->version == SAMPLE_LOG_VERSION &&
+         header->crc == sector_crc(header);
+}
+
+/**
+ * @brief Length of the valid record at the start of data, 0 if there is none
+ *
+ * An erased type byte, a length past the end or a bad CRC all end the
+ * records of a sector.
+ */
+static size_t record_check(const uint8_t *data, size_t avail) {
+  if (avail < SAMPLE_LOG_RECORD_HEADER_LEN || data[0] == 0xFF) {
+    return 0;
+  }
+  size_t len = SAMPLE_LOG_RECORD_HEADER_LEN + data[1];
+  if (data[1] < 6 || len + SAMPLE_LOG_RECORD_CRC_LEN > avail) {
+    return 0;
+  }
+  if (crc16_ccitt(data, len) != (data[len] | (data[len + 1] << 8))) {
+    return 0;
+  }
+  return len + SAMPLE_LOG_RECORD_CRC_LEN;
+}
+
+// -------------------------------
+// Writer, log task
+// -------------------------------
+
+/**
+ * @brief Program the placed bytes not programmed yet, move on if the page is
+ * full
+ */
+static void page_program(void) {
+  if (page_fill > page_flushed) {
+    uint32_t offset =
+        head_sector * SAMPLE_LOG_SECTOR_SIZE + page_base + page_flushed;
+    esp_err_t err = esp_partition_write(partition, offset, page + page_flushed,
+                                        page_fill - page_flushed);
+    if (err != ESP_OK) {
+      ESP_LOGE(TAG, "Write failed: %s", esp_err_to_name(err));
+    }
+    page_flushed = page_fill;
+  }
+  if (page_fill == SAMPLE_LOG_PAGE_SIZE) {
+    page_base += SAMPLE_LOG_PAGE_SIZE;
+    page_fill = 0;
+    page_flushed = 0;
+    memset(page, 0xFF, sizeof(page));
+  }
+}
+
+static void page_place(const uint8_t *data, size_t len) {
+  while (len > 0) {
+    size_t n = SAMPLE_LOG_PAGE_SIZE - page_fill;
+    if (n > len) {
+      n = len;
+    }
+    memcpy(page + page_fill, data, n);
+    page_fill += n;
+    data += n;
+    len -= n;
+    if (page_fill == SAMPLE_LOG_PAGE_SIZE) {
+      page_program();
+    }
+  }
+}
+
+/**
+ * @brief Erase the next sector and start it with its header
+ *
+ * When the log is full the next sector is the oldest one, which is dropped.
+ */
+static void sector_open(uint32_t first) {
+  uint32_t next = (head_sector + 1) % sector_count;
+
+  if (empty) {
+    oldest_sector = next;
+    empty = false;
+  } else if (next == oldest_sector) {
+    oldest_sector = (next + 1) % sector_count;
+  }
+  head_sector = next;
+  head_seq++;
+
+  esp_err_t err = esp_partition_erase_range(
+      partition, head_sector * SAMPLE_LOG_SECTOR_SIZE, SAMPLE_LOG_SECTOR_SIZE);
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "Erase failed: %s", esp_err_to_name(err));
+  }
+
+  SampleLogSector header = {
+      .magic = SAMPLE_LOG_MAGIC,
+      .seq = head_seq,
+      .first = first,
+      .version = SAMPLE_LOG_VERSION,
+  };
+  header.crc = sector_crc(&header);
+
+  memset(page, 0xFF, sizeof(page));
+  page_base = 0;
+  page_fill = 0;
+  page_flushed = 0;
+  page_place((const uint8_t *)&header, sizeof(header));
+}
+
+static void record_place(const uint8_t *record, size_t len) {
+  if (page_base + page_fill + len > SAMPLE_LOG_SECTOR_SIZE) {
+    page_program();
+    sector_open(rd_u32(record + SAMPLE_LOG_RECORD_HEADER_LEN));
+  }
+  page_place(record, len);
+}
+
+/**
+ * @brief Next complete record of the queue, copied out of the ring
+ *
+ * The RX task may publish a record in two parts when it wraps, so the bytes
+ * are collected until the length in the header is reached.
+ */
+static const uint8_t *queue_next(size_t *len) {
+  static uint8_t record[SAMPLE_LOG_RECORD_MAX];
+  static size_t have;
+
+  while (1) {
+    size_t need = have < SAMPLE_LOG_RECORD_HEADER_LEN
+                      ? SAMPLE_LOG_RECORD_HEADER_LEN
+                      : SAMPLE_LOG_RECORD_HEADER_LEN + record[1] +
+                            SAMPLE_LOG_RECORD_CRC_LEN;
+    if (have == need && have > SAMPLE_LOG_RECORD_HEADER_LEN) {
+      *len = have;
+      have = 0;
+      return record;
+    }
+
+    size_t avail = 0;
+    const uint8_t *src = ring_buffer_read_acquire(&queue_ring, &avail);
+    if (avail == 0) {
+      return NULL;
+    }
+    size_t n = need - have < avail ? need - have : avail;
+    memcpy(record + have, src, n);
+    ring_buffer_read_commit(&queue_ring, n);
+    have += n;
+  }
+}
+
+static void log_drain(void) {
+  const uint8_t *record;
+  size_t len;
+  while ((record = queue_next(&len)) != NULL) {
+    record_place(record, len);
+  }
+}
+
+// -------------------------------
+// Recovery, at start up
+// -------------------------------
+
+/**
+ * @brief Find the newest sector by bisection, then scan only that one
+ *
+ * Sectors are written in order, so from sector 0 the headers carry
+ * consecutive sequence numbers up to the newest sector, and the sectors after
+ * it are erased or one lap older. A sector that was being erased or has a
+ * torn last record is not appended to: writing resumes in a new sector.
+ */
+static void log_recover(void) {
+  SampleLogSector header;
+  uint32_t newest;
+  uint32_t newest_seq;
+
+  if (sector_header(0, &header)) {
+    uint32_t base = header.seq;
+    uint32_t lo = 0;
+    uint32_t hi = sector_count - 1;
+    while (lo < hi) {
+      uint32_t mid = (lo + hi + 1) / 2;
+      if (sector_header(mid, &header) && header.seq == base + mid) {
+        lo = mid;
+      } else {
+        hi = mid - 1;
+      }
+    }
+    newest = lo;
+    newest_seq = base + lo;
+  } else if (sector_header(sector_count - 1, &header)) {
+    // Interrupted while erasing sector 0 for a new lap
+    newest = sector_count - 1;
+    newest_seq = header.seq;
+  } else {
+    head_sector = sector_count - 1;
+    page_base = SAMPLE_LOG_SECTOR_SIZE;
+    ESP_LOGI(TAG, "Empty log, %" PRIu32 " sectors", sector_count);
+    return;
+  }
+
+  empty = false;
+  head_sector = newest;
+  head_seq = newest_seq;
+  oldest_sector = 0;
+  for (uint32_t skip = 1; skip <= 2; skip++) {
+    uint32_t sector = (newest + skip) % sector_count;
+    if (sector != newest && sector_header(sector, &header)) {
+      oldest_sector = sector;
+      break;
+    }
+  }
+
+  esp_partition_read(partition, newest * SAMPLE_LOG_SECTOR_SIZE, sector_buf,
+                     sizeof(sector_buf));
+  size_t end = sizeof(SampleLogSector);
+  size_t len;
+  while ((len = record_check(sector_buf + end, sizeof(sector_buf) - end)) > 0) {
+    end += len;
+  }
+
+  memset(page, 0xFF, sizeof(page));
+  if (end < sizeof(sector_buf) && sector_buf[end] != 0xFF) {
+    ESP_LOGW(TAG, "Torn record at %u in sector %" PRIu32, (unsigned)end,
+             newest);
+    page_base = SAMPLE_LOG_SECTOR_SIZE;
+    page_fill = 0;
+  } else {
+    page_base = end - end % SAMPLE_LOG_PAGE_SIZE;
+    page_fill = end % SAMPLE_LOG_PAGE_SIZE;
+  }
+  page_flushed = page_fill;
+
+  ESP_LOGI(TAG,
+           "Sectors %" PRIu32 "..%" PRIu32 " of %" PRIu32 ", seq %" PRIu32
+           ", resuming at %u",
+           oldest_sector, newest, sector_count, newest_seq, (unsigned)end);
+}
+
+// -------------------------------
+// Export, log task
+// -------------------------------
+
+typedef struct {
+  uint8_t buf[2 + SAMPLE_LOG_EXPORT_CHUNK]; // u16 length | records
+  size_t len;
+  uint32_t records;
+  uint32_t bytes;
+  bool failed;
+} ExportChunk;
+
+static void chunk_send(ExportChunk *chunk) {
+  if (chunk->failed) {
+    return;
+  }
+  wr_u16(chunk->buf, chunk->len);
+  chunk->failed = !transport_write_stream(
+      chunk->buf, 2 + chunk->len, pdMS_TO_TICKS(SAMPLE_LOG_EXPORT_TIMEOUT_MS));
+  chunk->bytes += chunk->len;
+  chunk->len = 0;
+}
+
+static void chunk_add(ExportChunk *chunk, const uint8_t *record, size_t len) {
+  if (chunk->len + len > SAMPLE_LOG_EXPORT_CHUNK) {
+    chunk_send(chunk);
+  }
+  memcpy(chunk->buf + 2 + chunk->len, record, len);
+  chunk->len += len;
+  chunk->records++;
+}
+
+/**
+ * @brief Send the records of the sectors that overlap [from, to]
+ *
+ * The first sector is found by bisection on the first timestamp of each
+ * sector. Records queued meanwhile are still written between two sectors;
+ * a sector overwritten before it was read ends the export.
+ */
+static void export_records(ExportChunk *chunk, uint32_t from, uint32_t to) {
+  SampleLogSector header;
+  uint32_t count =
+      (head_sector + sector_count - oldest_sector) % sector_count + 1;
+  uint32_t oldest = oldest_sector;
+
+  if (!sector_header(oldest, &header)) {
+    return;
+  }
+  uint32_t base_seq = header.seq;
+
+  // Last sector starting before from, the oldest if none does: records of
+  // that very second may also end the previous sector
+  uint32_t lo = 0;
+  uint32_t hi = count - 1;
+  while (lo < hi) {
+    uint32_t mid = (lo + hi + 1) / 2;
+    if (sector_header((oldest + mid) % sector_count, &header) &&
+        header.first < from) {
+      lo = mid;
+    } else {
+      hi = mid - 1;
+    }
+  }
+
+  for (uint32_t k = lo; k < count && !chunk->failed; k++) {
+    uint32_t sector = (oldest + k) % sector_count;
+    if (esp_partition_read(partition, sector * SAMPLE_LOG_SECTOR_SIZE,
+                           sector_buf, sizeof(sector_buf)) != ESP_OK) {
+      break;
+    }
+    memcpy(&header, sector_buf, sizeof(header));
+    if (header.magic != SAMPLE_LOG_MAGIC || header.seq != base_seq + k ||
+        header.first > to) {
+      break;
+    }
+
+    size_t offset = sizeof(SampleLogSector);
+    size_t len;
+    while ((len = record_check(sector_buf + offset,
+                               sizeof(sector_buf) - offset)) > 0) {
+      const uint8_t *record = sector_buf + offset;
+      uint32_t timestamp = rd_u32(record + SAMPLE_LOG_RECORD_HEADER_LEN);
+      if (timestamp >= from && timestamp <= to) {
+        chunk_add(chunk, record, len);
+      }
+      offset += len;
+    }
+
+    log_drain();
+  }
+}
+
+/**
+ * @brief Stream the records of [from, to] to the host
+ *
+ * Everything queued so far is written first. The stream is a
+ * {"type":"log_export"} line, chunks of u16 length | whole records, a chunk
+ * of length 0 and a {"type":"log_export_end"} line with the totals.
+ */
+static void log_export(uint32_t from, uint32_t to) {
+  static ExportChunk chunk;
+  char line[128];
+
+  log_drain();
+  page_program();
+
+  if (!transport_write_stream_begin(
+          pdMS_TO_TICKS(SAMPLE_LOG_EXPORT_TIMEOUT_MS))) {
+    ESP_LOGW(TAG, "Export: TX busy");
+    return;
+  }
+
+  chunk = (ExportChunk){0};
+  snprintf(line, sizeof(line),
+           "{\"type\":\"log_export\",\"from\":%" PRIu32 ",\"to\":%" PRIu32
+           ",\"version\":%d}\n",
+           from, to, SAMPLE_LOG_VERSION);
+  chunk.failed = !transport_write_stream(
+      (const uint8_t *)line, strlen(line),
+      pdMS_TO_TICKS(SAMPLE_LOG_EXPORT_TIMEOUT_MS));
+
+  if (!empty) {
+    export_records(&chunk, from, to);
+  }
+  if (chunk.len > 0) {
+    chunk_send(&chunk);
+  }
+  chunk_send(&chunk); // terminator
+
+  snprintf(line, sizeof(line),
+           "{\"type\":\"log_export_end\",\"records\":%" PRIu32
+           ",\"bytes\":%" PRIu32 ",\"complete\":%s}\n",
+           chunk.records, chunk.bytes, chunk.failed ? "false" : "true");
+  transport_write_stream((const uint8_t *)line, strlen(line),
+                         pdMS_TO_TICKS(SAMPLE_LOG_EXPORT_TIMEOUT_MS));
+  transport_write_stream_end();
+
+  ESP_LOGI(TAG, "Exported %" PRIu32 " records, %" PRIu32 " bytes%s",
+           chunk.records, chunk.bytes, chunk.failed ? ", aborted" : "");
+}
+
+static void sample_log_task(void *param) {
+  const TickType_t flush_ticks =
+      pdMS_TO_TICKS(CONFIG_SCREEN_SAMPLE_LOG_FLUSH_S * 1000);
+  TickType_t last_flush = xTaskGetTickCount();
+  SampleLogExport request;
+
+  while (1) {
+    ulTaskNotifyTake(pdTRUE, flush_ticks);
+
+    log_drain();
+    if (xTaskGetTickCount() - last_flush >= flush_ticks) {
+      page_program();
+      last_flush = xTaskGetTickCount();
+    }
+    if (xQueueReceive(export_queue, &request, 0) == pdTRUE) {
+      log_export(request.from, request.to);
+    }
+  }
+}
+
+/**
+ * @brief Find the partition, recover the write position and start the task
+ *
+ * Without the partition the log stays disabled and records are dropped.
+ */
+void sample_log_init(void) {
+  partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                       ESP_PARTITION_SUBTYPE_ANY,
+                                       SAMPLE_LOG_PARTITION);
+  if (!partition || partition->size < 2 * SAMPLE_LOG_SECTOR_SIZE) {
+    ESP_LOGE(TAG, "No \"%s\" partition, samples are not logged",
+             SAMPLE_LOG_PARTITION);
+    partition = NULL;
+    return;
+  }
+  sector_count = partition->size / SAMPLE_LOG_SECTOR_SIZE;
+
+  log_recover();
+
+  ring_buffer_init(&queue_ring, queue_storage, CONFIG_SCREEN_SAMPLE_LOG_BUFFER,
+                   0);
+  export_queue = xQueueCreate(1, sizeof(SampleLogExport));
+  xTaskCreate(sample_log_task, "sample_log", 1024 * 4, NULL, 4,
+              &log_task_handle);
+}
+
+// -------------------------------
+// Producers, RX task
+// -------------------------------
+
+/**
+ * @brief Queue an encoded record, or drop it if the queue is full
+ *
+ * @param[in] record Payload at SAMPLE_LOG_RECORD_HEADER_LEN, room for the CRC
+ * after it; the header and the CRC are filled here
+ */
+static void record_queue(uint8_t *record, uint8_t type, uint8_t payload_len) {
+  if (!log_task_handle) {
+    return;
+  }
+
+  size_t len = SAMPLE_LOG_RECORD_HEADER_LEN + payload_len;
+  record[0] = type;
+  record[1] = payload_len;
+  wr_u16(record + len, crc16_ccitt(record, len));
+  len += SAMPLE_LOG_RECORD_CRC_LEN;
+
+  if (ring_buffer_free(&queue_ring) < len) {
+    if (dropped_records++ % 100 == 0) {
+      ESP_LOGW(TAG, "Queue full, %" PRIu32 " records dropped",
+               dropped_records);
+    }
+    return;
+  }
+  ring_buffer_write(&queue_ring, record, len);
+  if (ring_buffer_used(&queue_ring) >= SAMPLE_LOG_PAGE_SIZE) {
+    xTaskNotifyGive(log_task_handle);
+  }
+}
+
+void sample_log_anemometer(const AnemometerData *anm_data) {
+#if CONFIG_SCREEN_SAMPLE_LOG_ANEMOMETER
+  uint8_t record[SAMPLE_LOG_RECORD_HEADER_LEN + 19 + SAMPLE_LOG_RECORD_CRC_LEN];
+  uint8_t *p = record + SAMPLE_LOG_RECORD_HEADER_LEN;
+
+  wr_u32(p, anm_data->timestamp);
+  wr_u16(p + 4, anm_data->timestamp_ms);
+  p[6] = anm_data->flags;
+  wr_u16(p + 7, data_to_centi(anm_data->x_vout));
+  wr_u16(p + 9, data_to_centi(anm_data->y_vout));
+  wr_u16(p + 11, data_to_centi(anm_data->z_vout));
+  wr_u16(p + 13, anm_data->temp_sonica_x);
+  wr_u16(p + 15, anm_data->temp_sonica_y);
+  wr_u16(p + 17, anm_data->temp_sonica_z);
+  record_queue(record, SAMPLE_LOG_ANEMOMETER, 19);
+#endif
+}
+
+void sample_log_particulate_matter(const ParticulateMatterData *pm_data) {
+#if CONFIG_SCREEN_SAMPLE_LOG_PARTICULATE_MATTER
+  uint8_t record[SAMPLE_LOG_RECORD_HEADER_LEN + 49 + SAMPLE_LOG_RECORD_CRC_LEN];
+  uint8_t *p = record + SAMPLE_LOG_RECORD_HEADER_LEN;
+  const float *values = &pm_data->mass_density_pm_1_0;
+
+  wr_u32(p, pm_data->timestamp);
+  wr_u16(p + 4, pm_data->timestamp_ms);
+  p[6] = pm_data->mass_density_unit;
+  p[7] = pm_data->particle_count_unit;
+  p[8] = pm_data->particle_size_unit;
+  // mass_density_pm_1_0..particle_size are consecutive, see history.c
+  for (size_t i = 0; i < 10; i++) {
+    wr_f32(p + 9 + 4 * i, values[i]);
+  }
+  record_queue(record, SAMPLE_LOG_PARTICULATE_MATTER, 49);
+#endif
+}
+
+void sample_log_imu(const ImuData *imu_data) {
+#if CONFIG_SCREEN_SAMPLE_LOG_IMU
+  uint8_t record[SAMPLE_LOG_RECORD_HEADER_LEN + 58 + SAMPLE_LOG_RECORD_CRC_LEN];
+  uint8_t *p = record + SAMPLE_LOG_RECORD_HEADER_LEN;
+  const float *values = &imu_data->acc_top_x;
+
+  wr_u32(p, imu_data->timestamp);
+  wr_u16(p + 4, imu_data->timestamp_ms);
+  p[6] = imu_data->acc_top_unit;
+  p[7] = imu_data->acc_unit;
+  p[8] = imu_data->mag_unit;
+  p[9] = imu_data->gyr_unit;
+  // acc_top_x..gyr_z are consecutive, see history.c
+  for (size_t i = 0; i < 12; i++) {
+    wr_f32(p + 10 + 4 * i, values[i]);
+  }
+  record_queue(record, SAMPLE_LOG_IMU, 58);
+#endif
+}
+
+/**
+ * @brief Ask the log task to stream [from, to] to the host, RX task
+ *
+ * A request arriving while an export is pending is dropped.
+ */
+void sample_log_export(uint32_t from, uint32_t to) {
+  SampleLogExport request = {.from = from, .to = to};
+
+  if (!log_task_handle) {
+    return;
+  }
+  if (xQueueSend(export_queue, &request, 0) != pdTRUE) {
+    ESP_LOGW(TAG, "Export already pending");
+    return;
+  }
+  xTaskNotifyGive(log_task_handle);
+}
+
+#endif
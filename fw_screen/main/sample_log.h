@@ -0,0 +1,96 @@
+#pragma once
+
+#include "data.h"
+#include "sdkconfig.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @brief Append-only log of the parsed samples in the "samplelog" partition.
+ *
+ * The partition is a circular sequence of 4 KB sectors. A sector starts with
+ * a SampleLogSector header, written with its first page, followed by records
+ * that never cross into the next sector:
+ *
+ *   u8 type | u8 len | len bytes of payload | u16 crc
+ *
+ * where type is a SampleLogType, crc is CRC-16/CCITT-FALSE over type, len and
+ * payload, as in protocol.h, and an erased 0xFF type byte ends the sector.
+ * Every payload starts with u32 ts_s | u16 ts_ms, little-endian; the layouts
+ * are below.
+ *
+ * The RX task only queues encoded records in a RAM ring; the log task places
+ * them in a page buffer and programs whole 256 byte pages, erasing each
+ * sector just before its first page. When the log is full the oldest sector
+ * is erased, so every sector is erased once per lap of the partition. A
+ * partial page is written after SCREEN_SAMPLE_LOG_FLUSH_S, and only its new
+ * bytes, so a page is never programmed twice over.
+ *
+ * At boot the newest sector is found by bisecting the sector headers and only
+ * that sector is scanned for the end of the log. Time ranges are located the
+ * same way, on the first timestamp of each sector: the bridge clock is taken
+ * as monotonic.
+ *
+ * Without CONFIG_SCREEN_SAMPLE_LOG every call is a no-op.
+ */
+
+typedef enum {
+  SAMPLE_LOG_ANEMOMETER = 0x01,
+  SAMPLE_LOG_PARTICULATE_MATTER = 0x02,
+  SAMPLE_LOG_IMU = 0x03,
+} SampleLogType;
+
+/*
+ * SAMPLE_LOG_ANEMOMETER payload (19 bytes)
+ *
+ *   u32 ts_s | u16 ts_ms | u8 flags (ANM_*)
+ *   i16 x_vout | y_vout | z_vout, 0.01 m/s
+ *   i16 temp_sonica_x | y | z, 0.01 C
+ *
+ * SAMPLE_LOG_PARTICULATE_MATTER payload (49 bytes)
+ *
+ *   u32 ts_s | u16 ts_ms
+ *   u8 mass_density_unit | particle_count_unit | particle_size_unit
+ *   f32 mass_density pm1.0 | pm2.5 | pm4.0 | pm10
+ *   f32 particle_count pm0.5 | pm1.0 | pm2.5 | pm4.0 | pm10
+ *   f32 particle_size
+ *
+ * SAMPLE_LOG_IMU payload (58 bytes)
+ *
+ *   u32 ts_s | u16 ts_ms
+ *   u8 acc_top_unit | acc_unit | mag_unit | gyr_unit
+ *   f32 x, y, z for acctop, acc, mag, gyr
+ */
+#define SAMPLE_LOG_RECORD_HEADER_LEN 2
+#define SAMPLE_LOG_RECORD_CRC_LEN 2
+
+typedef struct {
+  uint32_t magic; // SAMPLE_LOG_MAGIC
+  uint32_t seq;   // +1 per sector written, never reused
+  uint32_t first; // timestamp of the first record, seconds since the epoch
+  uint16_t version;
+  uint16_t crc; // of the fields above
+} SampleLogSector;
+
+#if CONFIG_SCREEN_SAMPLE_LOG
+
+void sample_log_init(void);
+
+void sample_log_anemometer(const AnemometerData *anm_data);
+void sample_log_particulate_matter(const ParticulateMatterData *pm_data);
+void sample_log_imu(const ImuData *imu_data);
+
+void sample_log_export(uint32_t from, uint32_t to);
+
+#else
+
+static inline void sample_log_init(void) {}
+
+static inline void sample_log_anemometer(const AnemometerData *anm_data) {}
+static inline void
+sample_log_particulate_matter(const ParticulateMatterData *pm_data) {}
+static inline void sample_log_imu(const ImuData *imu_data) {}
+
+static inline void sample_log_export(uint32_t from, uint32_t to) {}
+
+#endif
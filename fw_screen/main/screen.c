@@ -15,13 +15,6 @@ lv_disp_drv_t disp_drv;
 esp_lcd_panel_handle_t panel_handle;
 esp_lcd_touch_handle_t tp;
 
-bool lvgl_notify_flush_ready(esp_lcd_panel_io_handle_t panel_io,
-                             esp_lcd_panel_io_event_data_t *edata,
-                             void *user_ctx) {
-  lv_disp_flush_ready(&disp_drv);
-  return false;
-}
-
 void display_init(void) {
   ESP_LOGI(TAG, "SPI BUS init");
   spi_bus_config_t buscfg = {.sclk_io_num = PIN_NUM_LCD_SCLK,
@@ -29,7 +22,7 @@ void display_init(void) {
                              .miso_io_num = PIN_NUM_LCD_MISO,
                              .quadwp_io_num = -1,
                              .quadhd_io_num = -1,
-                             .max_transfer_sz = 4000};
+                             .max_transfer_sz = LCD_MAX_TRANSFER_SZ};
   ESP_ERROR_CHECK(spi_bus_initialize(SPI_HOST, &buscfg, SPI_DMA_CH_AUTO));
 
   ESP_LOGI(TAG, "Install panel IO");
@@ -6,6 +6,7 @@
 #include "esp_lcd_touch_cst816s.h"
 #include "esp_log.h"
 #include "lvgl_utils.h"
+#include "sdkconfig.h"
 
 #define PIN_NUM_LCD_SCLK 39
 #define PIN_NUM_LCD_MOSI 38
@@ -30,9 +31,32 @@
 
 #define LCD_V_RES 320
 #define LCD_H_RES 240
-#define LCD_BUF_HEIGHT 40
+
+// LVGL draw buffers, see the SCREEN_DISPLAY_PROFILE choice
+#if CONFIG_SCREEN_DISPLAY_PARTIAL
+#define LCD_BUF_HEIGHT CONFIG_SCREEN_DISPLAY_BUF_LINES
+#define LCD_BUF_CAPS (MALLOC_CAP_INTERNAL | MALLOC_CAP_DMA)
+#else
+#define LCD_BUF_HEIGHT LCD_V_RES
+#define LCD_BUF_CAPS MALLOC_CAP_SPIRAM
+#endif
 #define LCD_BUF_LENGTH (LCD_H_RES * LCD_BUF_HEIGHT)
 
+#if CONFIG_SCREEN_DISPLAY_BOUNCE
+#define LCD_BOUNCE_HEIGHT CONFIG_SCREEN_DISPLAY_BOUNCE_LINES
+#define LCD_BOUNCE_LENGTH (LCD_H_RES * LCD_BOUNCE_HEIGHT)
+#define LCD_FLUSH_LENGTH LCD_BOUNCE_LENGTH
+#else
+#define LCD_FLUSH_LENGTH LCD_BUF_LENGTH
+#endif
+
+// Largest SPI DMA transaction the ESP32-S3 accepts, 2^18 bits
+#define LCD_SPI_MAX_TRANSFER (32 * 1024)
+// Larger flushes are split by esp_lcd into transactions of this size
+#define LCD_MAX_TRANSFER_SZ                                                    \
+  (LCD_FLUSH_LENGTH * 2 < LCD_SPI_MAX_TRANSFER ? LCD_FLUSH_LENGTH * 2          \
+                                               : LCD_SPI_MAX_TRANSFER)
+
 #define PIN_NUM_BK_LIGHT 1
 
 #define LCD_BL_LEDC_TIMER LEDC_TIMER_0
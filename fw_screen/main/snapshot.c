@@ -0,0 +1,41 @@
+#include "snapshot.h"
+#include <string.h>
+
+#define SNAPSHOT_INDEX 0x3 // slot held by middle
+#define SNAPSHOT_FRESH 0x4 // middle holds a value the reader has not seen
+
+/**
+ * @brief Publish a new value, writer task only
+ */
+void snapshot_publish(Snapshot *snapshot, const void *value) {
+  memcpy(snapshot->slots + snapshot->back * snapshot->size, value,
+         snapshot->size);
+
+  // Release the copy above, acquire the slot the reader gave back
+  uint_fast8_t previous = atomic_exchange_explicit(
+      &snapshot->middle, snapshot->back | SNAPSHOT_FRESH, memory_order_acq_rel);
+  snapshot->back = previous & SNAPSHOT_INDEX;
+}
+
+/**
+ * @brief Latest published value, reader task only
+ *
+ * @param[out] value Points to the latest value, valid until the next call;
+ *                   zero-filled storage before the first publish
+ *
+ * @return true if the value changed since the previous call
+ */
+bool snapshot_read(Snapshot *snapshot, const void **value) {
+  bool fresh =
+      atomic_load_explicit(&snapshot->middle, memory_order_relaxed) &
+      SNAPSHOT_FRESH;
+
+  if (fresh) {
+    uint_fast8_t previous = atomic_exchange_explicit(
+        &snapshot->middle, snapshot->front, memory_order_acq_rel);
+    snapshot->front = previous & SNAPSHOT_INDEX;
+  }
+
+  *value = snapshot->slots + snapshot->front * snapshot->size;
+  return fresh;
+}
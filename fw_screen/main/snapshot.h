@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Latest-value handoff of a small struct between two tasks.
+ *
+ * A triple buffer: the writer fills its back slot and swaps it with the
+ * middle one, the reader swaps the middle slot with its front one when the
+ * writer left something new there. Both sides are wait-free, neither ever
+ * sees a slot the other is using, and the reader always gets the most
+ * recent complete value; older ones are overwritten, never queued.
+ *
+ * One writer task and one reader task per snapshot. The storage passed to
+ * SNAPSHOT_INIT() must be an array of three elements.
+ */
+
+typedef struct Snapshot {
+  uint8_t *slots;
+  size_t size;
+  uint8_t back;               // writer only
+  uint8_t front;              // reader only
+  atomic_uint_fast8_t middle; // slot index, SNAPSHOT_FRESH when unread
+} Snapshot;
+
+#define SNAPSHOT_INIT(storage)                                                 \
+  {(uint8_t *)(storage), sizeof((storage)[0]), 0, 1, 2}
+
+void snapshot_publish(Snapshot *snapshot, const void *value);
+bool snapshot_read(Snapshot *snapshot, const void **value);
@@ -0,0 +1,655 @@
+#include "transport.h"
+#include "cJSON.h"
+#include "cjson_arena.h"
+#include "data.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "json_keys.h"
+#include "protocol.h"
+#include "ring_buffer.h"
+#include "sdkconfig.h"
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "TRANSPORT";
+
+static uint8_t rx_storage[RING_BUFFER_STORAGE_SIZE(TRANSPORT_RX_RING_SIZE,
+                                                   TRANSPORT_RX_FRAME_MAX)];
+static RingBuffer rx_ring;
+static SemaphoreHandle_t rx_fill_mux;
+static TaskHandle_t rx_task_handle;
+static volatile bool rx_stalled = false;
+static TaskHandle_t reader_task_handle;
+static volatile LinkFormat link_format = LINK_FORMAT_JSON;
+static TickType_t last_valid_tick;
+static TickType_t hello_request_tick;
+static uint32_t handled_frames = 0;
+
+static uint8_t tx_storage[RING_BUFFER_STORAGE_SIZE(TRANSPORT_TX_RING_SIZE, 0)];
+static RingBuffer tx_ring;
+static portMUX_TYPE tx_lock = portMUX_INITIALIZER_UNLOCKED;
+static SemaphoreHandle_t tx_stream_mux;
+static SemaphoreHandle_t tx_space;
+static TaskHandle_t tx_task_handle;
+static volatile bool tx_streaming = false;
+static uint32_t tx_dropped = 0; // bytes, under tx_lock
+
+// Credit accounting, owned by the RX task
+static volatile bool credit_enabled = false;
+static uint32_t credit_base;
+static uint32_t credit_reported;
+static uint32_t drops_reported;
+static TickType_t credit_report_tick;
+static uint32_t invalid_frames = 0;
+static uint32_t superseded_frames = 0;
+
+typedef struct {
+  uint8_t *frame;
+  size_t len;
+  LinkFormat format;
+} Mailbox;
+
+#if defined(CONFIG_SCREEN_TRANSPORT_TINYUSB_CDC)
+static const TransportBackend *const backend = &transport_tusb_cdc;
+#elif defined(CONFIG_SCREEN_TRANSPORT_USB_SERIAL_JTAG)
+static const TransportBackend *const backend = &transport_usb_serial_jtag;
+#elif defined(CONFIG_SCREEN_TRANSPORT_UART)
+static const TransportBackend *const backend = &transport_uart;
+#elif defined(CONFIG_SCREEN_TRANSPORT_PTY)
+static const TransportBackend *const backend = &transport_pty;
+#else
+#error "No data link transport selected"
+#endif
+
+/**
+ * @brief Move everything the backend has buffered into the RX ring
+ *
+ * Reads go straight into the free space of the ring. When the ring is full the
+ * remaining bytes are left in the backend (USB is NAKed, the UART driver
+ * buffers them) and the RX task asks for a refill once it has released some
+ * frames.
+ *
+ * @param[in] timeout Longest wait for the first byte
+ */
+static void transport_rx_fill(TickType_t timeout) {
+  if (xSemaphoreTake(rx_fill_mux, portMAX_DELAY) != pdTRUE) {
+    return;
+  }
+
+  bool stalled = false;
+  size_t total = 0;
+  while (1) {
+    size_t free_len = 0;
+    uint8_t *dst = ring_buffer_write_acquire(&rx_ring, &free_len);
+    if (free_len == 0) {
+      stalled = true;
+      break;
+    }
+
+    size_t rx_size = backend->read(dst, free_len, timeout);
+    if (rx_size == 0) {
+      break;
+    }
+    ring_buffer_write_commit(&rx_ring, rx_size);
+    total += rx_size;
+    timeout = 0;
+  }
+  rx_stalled = stalled;
+
+  xSemaphoreGive(rx_fill_mux);
+  if (total > 0 || stalled) {
+    xTaskNotifyGive(rx_task_handle);
+  }
+}
+
+/**
+ * @brief Reader for backends without RX notifications
+ */
+static void transport_reader_task(void *param) {
+  while (1) {
+    transport_rx_fill(pdMS_TO_TICKS(TRANSPORT_READ_TIMEOUT_MS));
+    if (rx_stalled) {
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+  }
+}
+
+/**
+ * @brief Called by a backend with RX notifications when data arrived
+ */
+void transport_rx_ready(void) { transport_rx_fill(0); }
+
+/**
+ * @brief Called by a backend when the host closed the link
+ *
+ * The next bridge has to negotiate again.
+ */
+void transport_link_reset(void) {
+  link_format = LINK_FORMAT_JSON;
+  credit_enabled = false;
+}
+
+void transport_init(void) {
+  // The RX task parses the cJSON fallback frames in an arena
+  cjson_arena_init();
+
+  rx_fill_mux = xSemaphoreCreateMutex();
+  ring_buffer_init(&rx_ring, rx_storage, TRANSPORT_RX_RING_SIZE,
+                   TRANSPORT_RX_FRAME_MAX);
+  xTaskCreate(transport_rx_task, "transport_rx", 1024 * 4, NULL, 5,
+              &rx_task_handle);
+
+  tx_stream_mux = xSemaphoreCreateMutex();
+  tx_space = xSemaphoreCreateBinary();
+  ring_buffer_init(&tx_ring, tx_storage, TRANSPORT_TX_RING_SIZE, 0);
+  xTaskCreate(transport_tx_task, "transport_tx", 1024 * 3, NULL, 5,
+              &tx_task_handle);
+
+  ESP_LOGI(TAG, "Data link on %s", backend->name);
+  ESP_ERROR_CHECK(backend->init());
+
+  if (!backend->rx_notify) {
+    xTaskCreate(transport_reader_task, "transport_rd", 1024 * 3, NULL, 5,
+                &reader_task_handle);
+  }
+}
+
+void transport_get_stats(TransportStats *stats) {
+  stats->rx_bytes = rx_ring.released;
+  stats->frames = handled_frames;
+  stats->invalid_frames = invalid_frames;
+  stats->oversized_frames = rx_ring.oversized_frames;
+  stats->superseded_frames = superseded_frames;
+  portENTER_CRITICAL(&tx_lock);
+  stats->tx_dropped = tx_dropped;
+  portEXIT_CRITICAL(&tx_lock);
+}
+
+/**
+ * @brief Answer the bridge hello and switch the link format
+ *
+ * The bridge sends {"topic":"hello","proto":1,"formats":["bin","json"]} when it
+ * opens the port. Binary frames are used from the next frame on when the
+ * bridge offers them for our protocol version; bridges that never say hello
+ * keep talking JSON. The reply also tells the bridge it may send FRAME_BATCH,
+ * how long a frame may be and its credit window.
+ *
+ * Credit starts counting right after the hello line: from then on the bridge
+ * may have at most "window" bytes sent but not yet reported as consumed.
+ */
+void transport_handle_hello(const cJSON *json) {
+  bool binary = false;
+
+  cJSON *proto = cJSON_GetObjectItem(json, "proto");
+  cJSON *formats = cJSON_GetObjectItem(json, "formats");
+  if (cJSON_IsNumber(proto) && proto->valueint == PROTO_VERSION &&
+      cJSON_IsArray(formats)) {
+    cJSON *format;
+    cJSON_ArrayForEach(format, formats) {
+      if (cJSON_IsString(format) && strcmp(format->valuestring, "bin") == 0) {
+        binary = true;
+      }
+    }
+  }
+
+  cJSON *reply = cJSON_CreateObject();
+  cJSON_AddStringToObject(reply, "type", "hello");
+  cJSON_AddNumberToObject(reply, "proto", PROTO_VERSION);
+  cJSON_AddStringToObject(reply, "format", binary ? "bin" : "json");
+  cJSON_AddBoolToObject(reply, "batch", binary);
+  cJSON_AddNumberToObject(reply, "frame_max", TRANSPORT_RX_FRAME_MAX);
+  cJSON_AddNumberToObject(reply, "window", TRANSPORT_CREDIT_WINDOW);
+  transport_json_write(reply);
+  cJSON_Delete(reply);
+
+  credit_base = ring_buffer_consumed(&rx_ring);
+  credit_reported = 0;
+  drops_reported = rx_ring.oversized_frames + invalid_frames;
+  credit_report_tick = xTaskGetTickCount();
+  credit_enabled = true;
+
+  last_valid_tick = xTaskGetTickCount();
+  link_format = binary ? LINK_FORMAT_BINARY : LINK_FORMAT_JSON;
+  ESP_LOGI(TAG, "Link format: %s", binary ? "binary" : "JSON");
+}
+
+/**
+ * @brief Parse one frame in place
+ *
+ * @param[in] frame  NUL-terminated frame inside the RX ring
+ * @param[in] len    Frame length, without the terminator
+ * @param[in] format Link format the frame was received with
+ */
+static void transport_handle_frame(uint8_t *frame, size_t len,
+                                   LinkFormat format) {
+  handled_frames++;
+
+  if (format == LINK_FORMAT_BINARY) {
+    if (on_binary_received(frame, len) == PRC_PARSING_ERROR) {
+      invalid_frames++;
+    } else {
+      last_valid_tick = xTaskGetTickCount();
+    }
+    return;
+  }
+
+  if (frame[len - 1] == '\r') {
+    frame[--len] = '\0';
+  }
+
+  if (len == 0 || frame[0] != '{') {
+    ESP_LOGD(TAG, "Skipping non JSON frame (%u bytes)", (unsigned)len);
+    return;
+  }
+
+  if (on_json_frame_received((const char *)frame, len) == PRC_PARSING_ERROR) {
+    invalid_frames++;
+  } else {
+    last_valid_tick = xTaskGetTickCount();
+  }
+  ESP_LOGD(TAG, "Message Received");
+}
+
+/**
+ * @brief Tell the bridge how much of its data has been consumed
+ *
+ * Sends {"type":"credit","consumed":N,"window":W,"oversized":O,"invalid":I,
+ * "superseded":S} where consumed counts the bytes processed since the hello
+ * (wrapping at 2^32), oversized / invalid are the frames dropped so far and
+ * superseded the samples skipped by the latest-wins mailboxes. A report goes
+ * out as soon as a quarter of the window has been consumed, otherwise every
+ * TRANSPORT_CREDIT_PERIOD_MS while something changed, and at least every
+ * TRANSPORT_CREDIT_KEEPALIVE_MS so a lost report cannot stall the bridge.
+ * A report transport_write() drops is not counted as sent.
+ */
+static void transport_report_credit(void) {
+  uint32_t consumed = ring_buffer_consumed(&rx_ring) - credit_base;
+  uint32_t drops = rx_ring.oversized_frames + invalid_frames;
+  TickType_t elapsed = xTaskGetTickCount() - credit_report_tick;
+
+  bool changed = consumed != credit_reported || drops != drops_reported;
+  if (consumed - credit_reported < TRANSPORT_CREDIT_WINDOW / 4 &&
+      !(changed && elapsed >= pdMS_TO_TICKS(TRANSPORT_CREDIT_PERIOD_MS)) &&
+      elapsed < pdMS_TO_TICKS(TRANSPORT_CREDIT_KEEPALIVE_MS)) {
+    return;
+  }
+
+  char msg[160];
+  snprintf(msg, sizeof(msg),
+           "{\"type\":\"credit\",\"consumed\":%" PRIu32
+           ",\"window\":%u,\"oversized\":%" PRIu32 ",\"invalid\":%" PRIu32
+           ",\"superseded\":%" PRIu32 "}",
+           consumed, (unsigned)TRANSPORT_CREDIT_WINDOW,
+           rx_ring.oversized_frames, invalid_frames, superseded_frames);
+  if (!transport_write(msg)) {
+    return; // TX ring full or a stream running, retried on the next drain
+  }
+
+  credit_reported = consumed;
+  drops_reported = drops;
+  credit_report_tick = xTaskGetTickCount();
+}
+
+static bool transport_mailbox_enabled(uint8_t type) {
+  switch (type) {
+#ifdef CONFIG_SCREEN_MAILBOX_ANEMOMETER
+  case FRAME_ANEMOMETER:
+    return true;
+#endif
+#ifdef CONFIG_SCREEN_MAILBOX_PARTICULATE_MATTER
+  case FRAME_PARTICULATE_MATTER:
+    return true;
+#endif
+#ifdef CONFIG_SCREEN_MAILBOX_IMU
+  case FRAME_IMU:
+    return true;
+#endif
+  default:
+    return false;
+  }
+}
+
+/**
+ * @brief Latest-wins mailbox of a frame, found without parsing it
+ *
+ * Binary frames are recognized by their type byte, which COBS leaves in place
+ * because version and type are never zero; batches go to the mailbox of their
+ * sample type. JSON frames are recognized by the value of their "topic" key.
+ *
+ * @return mailbox index, -1 for frames that are handled in order
+ */
+static int transport_mailbox_of(const uint8_t *frame, size_t len,
+                               LinkFormat format) {
+  uint8_t type = 0;
+
+  if (format == LINK_FORMAT_BINARY) {
+    // frame[0] is the COBS code: the next code - 1 bytes are literal
+    if (len < 3 || frame[0] < 3 || frame[1] != PROTO_VERSION) {
+      return -1;
+    }
+    type = frame[2];
+    if (type == FRAME_BATCH) {
+      type = (len > 3 && frame[0] > 3) ? frame[3] : 0;
+    }
+  } else {
+    const char *topic = strstr((const char *)frame, "\"topic\"");
+    if (!topic) {
+      return -1;
+    }
+    topic += strlen("\"topic\"");
+    topic += strspn(topic, " \t:");
+    if (*topic++ != '"') {
+      return -1;
+    }
+    switch (json_key_lookup(topic, strcspn(topic, "\""))) {
+    case JSON_KEY_ANM:
+      type = FRAME_ANEMOMETER;
+      break;
+    case JSON_KEY_SPS:
+      type = FRAME_PARTICULATE_MATTER;
+      break;
+    case JSON_KEY_IMU:
+      type = FRAME_IMU;
+      break;
+    default:
+      break;
+    }
+  }
+
+  if (!transport_mailbox_enabled(type)) {
+    return -1;
+  }
+  return type - FRAME_ANEMOMETER;
+}
+
+/**
+ * @brief Drain the RX ring
+ *
+ * Every complete frame is fetched before any is released. Frames of a
+ * latest-wins topic only replace the pending one in their mailbox, so under a
+ * burst only the newest sample of each is parsed; everything else (status,
+ * hello, ...) is handled in arrival order. Each mailbox keeps the link format
+ * its frame was received with, in case a hello switches it meanwhile.
+ */
+static void transport_drain(void) {
+  Mailbox mailbox[TRANSPORT_MAILBOX_COUNT] = {0};
+  uint8_t *frame;
+  size_t frame_len;
+
+  while (1) {
+    LinkFormat format = link_format;
+    if (!ring_buffer_next_frame(&rx_ring,
+                                format == LINK_FORMAT_BINARY ? '\0' : '\n',
+                                &frame, &frame_len)) {
+      break;
+    }
+
+    int slot = transport_mailbox_of(frame, frame_len, format);
+    if (slot >= 0) {
+      if (mailbox[slot].frame) {
+        superseded_frames++;
+      }
+      mailbox[slot] = (Mailbox){frame, frame_len, format};
+      continue;
+    }
+
+    transport_handle_frame(frame, frame_len, format);
+  }
+
+  for (int i = 0; i < TRANSPORT_MAILBOX_COUNT; i++) {
+    if (mailbox[i].frame) {
+      transport_handle_frame(mailbox[i].frame, mailbox[i].len,
+                            mailbox[i].format);
+    }
+  }
+  ring_buffer_release(&rx_ring);
+}
+
+/**
+ * @brief Recover a link whose two ends disagree on the format
+ *
+ * Only TinyUSB reports when the bridge closes the port; over UART,
+ * USB-Serial-JTAG or a PTY a restarted bridge says hello in JSON to a screen
+ * still expecting binary, or the other way round. When nothing but garbage
+ * arrived for TRANSPORT_LINK_TIMEOUT_MS the screen falls back to JSON and
+ * sends {"type":"hello_request"} so the bridge negotiates again.
+ */
+static void transport_check_link(void) {
+  TickType_t now = xTaskGetTickCount();
+  TickType_t timeout = pdMS_TO_TICKS(TRANSPORT_LINK_TIMEOUT_MS);
+
+  if (now - last_valid_tick < timeout || now - hello_request_tick < timeout) {
+    return;
+  }
+  hello_request_tick = now;
+
+  if (link_format != LINK_FORMAT_JSON) {
+    ESP_LOGW(TAG, "No valid frame for %d ms, back to JSON",
+             TRANSPORT_LINK_TIMEOUT_MS);
+    transport_link_reset();
+  }
+  transport_write("{\"type\":\"hello_request\"}");
+}
+
+void transport_rx_task(void *param) {
+  uint32_t oversized_frames = 0;
+  uint32_t superseded_logged = 0;
+  uint32_t garbage_seen = 0;
+
+  ESP_LOGI(TAG, "RX task started");
+  while (1) {
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(TRANSPORT_CREDIT_PERIOD_MS));
+
+    transport_drain();
+
+    if (rx_ring.oversized_frames != oversized_frames) {
+      oversized_frames = rx_ring.oversized_frames;
+      ESP_LOGW(TAG, "Dropped oversized frames: %" PRIu32, oversized_frames);
+    }
+    if (superseded_frames - superseded_logged >= 100) {
+      superseded_logged = superseded_frames;
+      ESP_LOGI(TAG, "Superseded frames: %" PRIu32, superseded_frames);
+    }
+
+    if (rx_ring.oversized_frames + invalid_frames != garbage_seen) {
+      garbage_seen = rx_ring.oversized_frames + invalid_frames;
+      transport_check_link();
+    }
+
+    if (rx_stalled) {
+      if (backend->rx_notify) {
+        transport_rx_fill(0);
+      } else {
+        xTaskNotifyGive(reader_task_handle);
+      }
+    }
+
+    if (credit_enabled) {
+      transport_report_credit();
+    }
+  }
+}
+
+/**
+ * @brief Move up to limit bytes from the TX ring into the backend
+ *
+ * @return false when the backend could not take everything
+ */
+static bool transport_tx_push(size_t limit) {
+  while (limit > 0) {
+    size_t len = 0;
+    const uint8_t *src = ring_buffer_read_acquire(&tx_ring, &len);
+    if (len == 0) {
+      break;
+    }
+    if (len > limit) {
+      len = limit;
+    }
+
+    size_t queued = backend->write(src, len);
+    ring_buffer_read_commit(&tx_ring, queued);
+    limit -= queued;
+    if (queued < len) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Drain the TX ring into the backend
+ *
+ * Messages are coalesced into full USB packets; a partial packet is sent once
+ * its first byte has waited TRANSPORT_TX_FLUSH_MS. While the host has the port
+ * closed everything queued is dropped, so writers never wait on a host that
+ * is not reading.
+ */
+void transport_tx_task(void *param) {
+  const TickType_t flush_ticks = pdMS_TO_TICKS(TRANSPORT_TX_FLUSH_MS)
+                                     ? pdMS_TO_TICKS(TRANSPORT_TX_FLUSH_MS)
+                                     : 1;
+  TickType_t pending_since = 0;
+  bool pending = false;
+
+  while (1) {
+    TickType_t wait = portMAX_DELAY;
+    size_t used = ring_buffer_used(&tx_ring);
+
+    if (used > 0 && !backend->connected()) {
+      ring_buffer_read_commit(&tx_ring, used);
+      portENTER_CRITICAL(&tx_lock);
+      tx_dropped += used;
+      portEXIT_CRITICAL(&tx_lock);
+      pending = false;
+      xSemaphoreGive(tx_space);
+    } else if (used > 0) {
+      TickType_t now = xTaskGetTickCount();
+      if (!pending) {
+        pending = true;
+        pending_since = now;
+      }
+
+      bool due = now - pending_since >= flush_ticks;
+      size_t whole = used - used % TRANSPORT_TX_PACKET_SIZE;
+      if (due || whole > 0) {
+        bool fifo_full = !transport_tx_push(due ? used : whole);
+        backend->flush();
+        xSemaphoreGive(tx_space);
+
+        pending = ring_buffer_used(&tx_ring) > 0;
+        pending_since = now;
+        // Retry on the next tick when the backend could not take everything
+        wait = fifo_full ? 1 : (pending ? flush_ticks : portMAX_DELAY);
+      } else {
+        wait = flush_ticks - (now - pending_since);
+      }
+    }
+
+    ulTaskNotifyTake(pdTRUE, wait);
+  }
+}
+
+/**
+ * @brief Queue a message and a trailing newline, without blocking
+ *
+ * The message is queued whole or not at all: when the TX ring is full, the
+ * host has the port closed or a stream is being written it is dropped and
+ * counted. Safe to call from the LVGL task.
+ *
+ * @return true if the message was queued
+ */
+bool transport_write(const char *msg) {
+  if (!backend->connected()) {
+    return false;
+  }
+
+  size_t len = strlen(msg);
+  bool queued = false;
+  uint32_t dropped;
+
+  portENTER_CRITICAL(&tx_lock);
+  if (!tx_streaming && ring_buffer_free(&tx_ring) >= len + 1) {
+    ring_buffer_write(&tx_ring, (const uint8_t *)msg, len);
+    ring_buffer_write(&tx_ring, (const uint8_t *)"\n", 1);
+    queued = true;
+  } else {
+    tx_dropped += len + 1;
+  }
+  dropped = tx_dropped;
+  portEXIT_CRITICAL(&tx_lock);
+
+  if (!queued) {
+    ESP_LOGW(TAG, "TX busy, message dropped (%" PRIu32 " bytes so far)",
+             dropped);
+    return false;
+  }
+  xTaskNotifyGive(tx_task_handle);
+  return true;
+}
+
+bool transport_json_write(const cJSON *json) {
+  char *json_printed = cJSON_PrintUnformatted(json);
+  if (!json_printed) {
+    return false;
+  }
+  bool queued = transport_write(json_printed);
+  cJSON_free(json_printed);
+  return queued;
+}
+
+/**
+ * @brief Take the TX ring for a stream of arbitrary length
+ *
+ * Until transport_write_stream_end() only transport_write_stream() reaches the
+ * host and transport_write() drops its messages, so the stream is never
+ * interleaved. Must not be used from the LVGL task.
+ */
+bool transport_write_stream_begin(TickType_t timeout) {
+  if (xSemaphoreTake(tx_stream_mux, timeout) != pdTRUE) {
+    return false;
+  }
+  portENTER_CRITICAL(&tx_lock);
+  tx_streaming = true;
+  portEXIT_CRITICAL(&tx_lock);
+  return true;
+}
+
+/**
+ * @brief Queue data of a stream, waiting for room in the TX ring
+ *
+ * @param[in] timeout Longest wait for the TX task to free some room
+ *
+ * @return false if the host closed the port or no room was freed in time
+ */
+bool transport_write_stream(const uint8_t *data, size_t len,
+                            TickType_t timeout) {
+  while (len > 0) {
+    if (!backend->connected()) {
+      return false;
+    }
+
+    portENTER_CRITICAL(&tx_lock);
+    size_t written = ring_buffer_write(&tx_ring, data, len < 256 ? len : 256);
+    portEXIT_CRITICAL(&tx_lock);
+
+    data += written;
+    len -= written;
+    xTaskNotifyGive(tx_task_handle);
+
+    if (written == 0 && xSemaphoreTake(tx_space, timeout) != pdTRUE) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void transport_write_stream_end(void) {
+  portENTER_CRITICAL(&tx_lock);
+  tx_streaming = false;
+  portEXIT_CRITICAL(&tx_lock);
+  xSemaphoreGive(tx_stream_mux);
+}
\ No newline at end of file
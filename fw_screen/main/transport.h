@@ -0,0 +1,99 @@
+#pragma once
+
+#include "cJSON.h"
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Data link between the bridge and the screen
+ *
+ * The transport owns everything that does not depend on the physical link:
+ * the RX ring and its framing, the latest-wins mailboxes, the dispatch into
+ * on_json_received() / on_binary_received(), the hello negotiation, credit
+ * reports and the TX ring. A backend only moves bytes, see TransportBackend.
+ */
+
+// Byte ring the link is read into, and the longest frame it can hold
+#define TRANSPORT_RX_RING_SIZE 8192
+#define TRANSPORT_RX_FRAME_MAX 2048
+
+// TX ring drained by transport_tx_task, the full-speed bulk packet size it
+// coalesces messages into and how long a partial packet may wait for more
+#define TRANSPORT_TX_RING_SIZE 4096
+#define TRANSPORT_TX_PACKET_SIZE 64
+#define TRANSPORT_TX_FLUSH_MS 10
+
+// Bytes the bridge may have in flight, and how often unchanged credit is
+// reported again (see transport_report_credit)
+#define TRANSPORT_CREDIT_WINDOW (TRANSPORT_RX_RING_SIZE - 1)
+#define TRANSPORT_CREDIT_PERIOD_MS 200
+#define TRANSPORT_CREDIT_KEEPALIVE_MS 1000
+
+// Without a valid frame for this long while garbage keeps arriving, the link
+// falls back to JSON and asks the bridge for a new hello
+#define TRANSPORT_LINK_TIMEOUT_MS 3000
+
+// Longest wait of the reader task of a backend without RX notifications
+#define TRANSPORT_READ_TIMEOUT_MS 100
+
+// One latest-wins slot per sample type (FRAME_ANEMOMETER..FRAME_IMU)
+#define TRANSPORT_MAILBOX_COUNT 3
+
+typedef enum {
+  LINK_FORMAT_JSON,   // newline-terminated JSON documents
+  LINK_FORMAT_BINARY, // COBS frames terminated by 0x00, see protocol.h
+} LinkFormat;
+
+/**
+ * @brief Byte mover for one physical link
+ *
+ * Backends with rx_notify call transport_rx_ready() when data arrives and
+ * read() must not block; the others are polled by a reader task and read()
+ * waits up to timeout for the first byte. write() must never block and
+ * returns how many bytes it took.
+ */
+typedef struct {
+  const char *name;
+  esp_err_t (*init)(void);
+  size_t (*read)(uint8_t *dst, size_t len, TickType_t timeout);
+  size_t (*write)(const uint8_t *data, size_t len);
+  void (*flush)(void);
+  bool (*connected)(void);
+  bool rx_notify;
+} TransportBackend;
+
+extern const TransportBackend transport_tusb_cdc;
+extern const TransportBackend transport_usb_serial_jtag;
+extern const TransportBackend transport_uart;
+extern const TransportBackend transport_pty;
+
+typedef struct {
+  uint32_t rx_bytes; // consumed since boot, wraps
+  uint32_t frames;   // handed to the parser
+  uint32_t invalid_frames;
+  uint32_t oversized_frames;
+  uint32_t superseded_frames;
+  uint32_t tx_dropped; // bytes
+} TransportStats;
+
+void transport_init(void);
+void transport_rx_task(void *param);
+void transport_tx_task(void *param);
+void transport_get_stats(TransportStats *stats);
+
+// Backend events
+void transport_rx_ready(void);
+void transport_link_reset(void);
+
+void transport_handle_hello(const cJSON *json);
+
+bool transport_write(const char *msg);
+bool transport_json_write(const cJSON *json);
+bool transport_write_stream_begin(TickType_t timeout);
+bool transport_write_stream(const uint8_t *data, size_t len,
+                            TickType_t timeout);
+void transport_write_stream_end(void);
@@ -0,0 +1,105 @@
+// posix_openpt() and cfmakeraw()
+#define _GNU_SOURCE
+
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "sdkconfig.h"
+#include "transport.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+
+#ifdef CONFIG_SCREEN_TRANSPORT_PTY
+
+static const char *TAG = "PTY";
+
+static int master_fd = -1;
+static volatile bool attached = false;
+
+static esp_err_t pty_init(void) {
+  master_fd = posix_openpt(O_RDWR | O_NOCTTY);
+  if (master_fd < 0 || grantpt(master_fd) != 0 || unlockpt(master_fd) != 0) {
+    ESP_LOGE(TAG, "Cannot create a pseudo terminal (errno %d)", errno);
+    return ESP_FAIL;
+  }
+
+  const char *name = ptsname(master_fd);
+  // Raw mode up front (no echo, no CR/LF translation) for bridges that do not
+  // configure the port themselves
+  int slave_fd = open(name, O_RDWR | O_NOCTTY);
+  if (slave_fd >= 0) {
+    struct termios tio;
+    tcgetattr(slave_fd, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(slave_fd, TCSANOW, &tio);
+    close(slave_fd);
+  }
+  fcntl(master_fd, F_SETFL, fcntl(master_fd, F_GETFL) | O_NONBLOCK);
+
+  ESP_LOGI(TAG, "Data link on %s, start the bridge with --port %s", name,
+           name);
+  return ESP_OK;
+}
+
+/**
+ * @brief Poll the master side until data arrives or timeout expires
+ *
+ * The FreeRTOS POSIX port must not block in the kernel, so the master is
+ * non-blocking and the wait is done one tick at a time. The master reads EIO
+ * while no process has the slave open.
+ */
+static size_t pty_read(uint8_t *dst, size_t len, TickType_t timeout) {
+  while (1) {
+    ssize_t rx_size = read(master_fd, dst, len);
+    if (rx_size > 0) {
+      if (!attached) {
+        attached = true;
+        ESP_LOGI(TAG, "Bridge attached");
+      }
+      return rx_size;
+    }
+    if (rx_size < 0 && errno == EIO && attached) {
+      attached = false;
+      ESP_LOGI(TAG, "Bridge detached");
+      transport_link_reset();
+    }
+    if (timeout == 0) {
+      return 0;
+    }
+    vTaskDelay(1);
+    timeout--;
+  }
+}
+
+static size_t pty_write(const uint8_t *data, size_t len) {
+  ssize_t queued = write(master_fd, data, len);
+  return queued > 0 ? queued : 0;
+}
+
+static void pty_flush(void) {
+  // Writes go straight to the kernel
+}
+
+static bool pty_connected(void) { return attached; }
+
+/**
+ * @brief Data link on a pseudo terminal, for the linux target
+ *
+ * The bridge opens the slave like a serial port, which makes it possible to
+ * run and benchmark the whole data path on a workstation.
+ */
+const TransportBackend transport_pty = {
+    .name = "PTY",
+    .init = pty_init,
+    .read = pty_read,
+    .write = pty_write,
+    .flush = pty_flush,
+    .connected = pty_connected,
+    .rx_notify = false,
+};
+
+#endif // CONFIG_SCREEN_TRANSPORT_PTY
@@ -0,0 +1,106 @@
+#include "driver/uart.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "sdkconfig.h"
+#include "transport.h"
+#include <stdint.h>
+
+#ifdef CONFIG_SCREEN_TRANSPORT_UART
+
+static const char *TAG = "UART";
+
+#define UART_RX_BUFFER_SIZE 4096
+#define UART_TX_BUFFER_SIZE 2048
+
+static esp_err_t uart_transport_init(void) {
+  const uart_config_t config = {
+      .baud_rate = CONFIG_SCREEN_TRANSPORT_UART_BAUD,
+      .data_bits = UART_DATA_8_BITS,
+      .parity = UART_PARITY_DISABLE,
+      .stop_bits = UART_STOP_BITS_1,
+      .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
+      .source_clk = UART_SCLK_DEFAULT,
+  };
+
+  ESP_ERROR_CHECK(uart_driver_install(CONFIG_SCREEN_TRANSPORT_UART_PORT,
+                                      UART_RX_BUFFER_SIZE, UART_TX_BUFFER_SIZE,
+                                      0, NULL, 0));
+  ESP_ERROR_CHECK(
+      uart_param_config(CONFIG_SCREEN_TRANSPORT_UART_PORT, &config));
+  ESP_ERROR_CHECK(uart_set_pin(CONFIG_SCREEN_TRANSPORT_UART_PORT,
+                               CONFIG_SCREEN_TRANSPORT_UART_TX_PIN,
+                               CONFIG_SCREEN_TRANSPORT_UART_RX_PIN,
+                               UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE));
+
+  ESP_LOGI(TAG, "UART%d at %d baud", CONFIG_SCREEN_TRANSPORT_UART_PORT,
+           CONFIG_SCREEN_TRANSPORT_UART_BAUD);
+  return ESP_OK;
+}
+
+/**
+ * @brief Wait for the first byte, then take everything already buffered
+ *
+ * uart_read_bytes() waits until len bytes arrived, which would hold complete
+ * frames back until the ring space is filled.
+ */
+static size_t uart_transport_read(uint8_t *dst, size_t len,
+                                  TickType_t timeout) {
+  int rx_size = uart_read_bytes(CONFIG_SCREEN_TRANSPORT_UART_PORT, dst, 1,
+                                timeout);
+  if (rx_size <= 0) {
+    return 0;
+  }
+
+  size_t buffered = 0;
+  uart_get_buffered_data_len(CONFIG_SCREEN_TRANSPORT_UART_PORT, &buffered);
+  if (buffered > len - 1) {
+    buffered = len - 1;
+  }
+  if (buffered > 0) {
+    int more = uart_read_bytes(CONFIG_SCREEN_TRANSPORT_UART_PORT, dst + 1,
+                               buffered, 0);
+    if (more > 0) {
+      rx_size += more;
+    }
+  }
+  return rx_size;
+}
+
+static size_t uart_transport_write(const uint8_t *data, size_t len) {
+  size_t space = 0;
+  uart_get_tx_buffer_free_size(CONFIG_SCREEN_TRANSPORT_UART_PORT, &space);
+  if (len > space) {
+    len = space;
+  }
+  if (len == 0) {
+    return 0;
+  }
+  int queued = uart_write_bytes(CONFIG_SCREEN_TRANSPORT_UART_PORT, data, len);
+  return queued > 0 ? queued : 0;
+}
+
+static void uart_transport_flush(void) {
+  // The driver starts transmitting as soon as bytes are queued
+}
+
+static bool uart_transport_connected(void) {
+  // A UART has no line state, link changes are detected by
+  // transport_check_link()
+  return true;
+}
+
+/**
+ * @brief Data link on a UART, for boards wired to a USB-UART bridge
+ */
+const TransportBackend transport_uart = {
+    .name = "UART",
+    .init = uart_transport_init,
+    .read = uart_transport_read,
+    .write = uart_transport_write,
+    .flush = uart_transport_flush,
+    .connected = uart_transport_connected,
+    .rx_notify = false,
+};
+
+#endif // CONFIG_SCREEN_TRANSPORT_UART
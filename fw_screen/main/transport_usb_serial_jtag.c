@@ -0,0 +1,64 @@
+#include "driver/usb_serial_jtag.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "sdkconfig.h"
+#include "transport.h"
+#include <stdint.h>
+
+#ifdef CONFIG_SCREEN_TRANSPORT_USB_SERIAL_JTAG
+
+static const char *TAG = "USB_SERIAL_JTAG";
+
+#define USB_SERIAL_JTAG_RX_BUFFER_SIZE 2048
+#define USB_SERIAL_JTAG_TX_BUFFER_SIZE 2048
+
+static esp_err_t usb_serial_jtag_init(void) {
+  usb_serial_jtag_driver_config_t config = {
+      .rx_buffer_size = USB_SERIAL_JTAG_RX_BUFFER_SIZE,
+      .tx_buffer_size = USB_SERIAL_JTAG_TX_BUFFER_SIZE,
+  };
+  esp_err_t ret = usb_serial_jtag_driver_install(&config);
+  if (ret != ESP_OK) {
+    ESP_LOGE(TAG, "Driver install failed: %s", esp_err_to_name(ret));
+  }
+  return ret;
+}
+
+static size_t usb_serial_jtag_read(uint8_t *dst, size_t len,
+                                   TickType_t timeout) {
+  int rx_size = usb_serial_jtag_read_bytes(dst, len, timeout);
+  return rx_size > 0 ? rx_size : 0;
+}
+
+static size_t usb_serial_jtag_write(const uint8_t *data, size_t len) {
+  int queued = usb_serial_jtag_write_bytes(data, len, 0);
+  return queued > 0 ? queued : 0;
+}
+
+static void usb_serial_jtag_flush(void) {
+  // The driver sends whatever it holds as soon as the host polls
+}
+
+static bool usb_serial_jtag_connected(void) {
+  return usb_serial_jtag_is_connected();
+}
+
+/**
+ * @brief Data link on the built-in USB-Serial-JTAG controller
+ *
+ * The driver has no RX callback, so a reader task waits on it. The console
+ * must be moved off this port (CONFIG_ESP_CONSOLE_*), otherwise log lines are
+ * interleaved with the replies to the bridge.
+ */
+const TransportBackend transport_usb_serial_jtag = {
+    .name = "USB-Serial-JTAG",
+    .init = usb_serial_jtag_init,
+    .read = usb_serial_jtag_read,
+    .write = usb_serial_jtag_write,
+    .flush = usb_serial_jtag_flush,
+    .connected = usb_serial_jtag_connected,
+    .rx_notify = false,
+};
+
+#endif // CONFIG_SCREEN_TRANSPORT_USB_SERIAL_JTAG
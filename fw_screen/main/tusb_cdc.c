@@ -1,26 +1,18 @@
 #include "tusb_cdc.h"
-#include "cJSON.h"
-#include "data.h"
 #include "esp_log.h"
 #include "freertos/FreeRTOS.h"
-#include "freertos/queue.h"
 #include "freertos/task.h"
 #include "sdkconfig.h"
 #include "tinyusb.h"
 #include "tinyusb_cdc_acm.h"
 #include "tinyusb_console.h"
 #include "tinyusb_default_config.h"
+#include "transport.h"
 #include <stdint.h>
 
-static const char *TAG = "TUSB_CDC";
-static uint8_t rx_buf[CONFIG_TINYUSB_CDC_RX_BUFSIZE + 1];
+#ifdef CONFIG_SCREEN_TRANSPORT_TINYUSB_CDC
 
-typedef struct {
-  uint8_t buf[CONFIG_TINYUSB_CDC_RX_BUFSIZE + 1]; // Data buffer
-  size_t buf_len;                                 // Number of bytes received
-  uint8_t itf; // Index of CDC device interface
-} app_message_t;
-static QueueHandle_t app_queue;
+static const char *TAG = "TUSB_CDC";
 
 /**
  * @brief CDC device RX callback
@@ -31,24 +23,7 @@ static QueueHandle_t app_queue;
  * @param[in] event CDC event type
  */
 void tusb_cdc_rx_callback(int itf, cdcacm_event_t *event) {
-  /* initialization */
-  size_t rx_size = 0;
-
-  /* read */
-  esp_err_t ret = tinyusb_cdcacm_read(
-      itf, rx_buf, CONFIG_TINYUSB_CDC_RX_BUFSIZE * 4, &rx_size);
-  if (ret == ESP_OK) {
-
-    app_message_t tx_msg = {
-        .buf_len = rx_size,
-        .itf = itf,
-    };
-
-    memcpy(tx_msg.buf, rx_buf, rx_size);
-    xQueueSend(app_queue, &tx_msg, 0);
-  } else {
-    ESP_LOGE(TAG, "Read Error");
-  }
+  transport_rx_ready();
 }
 
 /**
@@ -64,11 +39,14 @@ void tusb_cdc_line_state_changed_callback(int itf, cdcacm_event_t *event) {
   int rts = event->line_state_changed_data.rts;
   ESP_LOGI(TAG, "Line state changed on channel %d: DTR:%d, RTS:%d", itf, dtr,
            rts);
-}
 
-void tusb_cdc_init(void) {
-  app_queue = xQueueCreate(10, sizeof(app_message_t));
+  if (itf == TUSB_CDC_DATA_ACM && !dtr) {
+    // The bridge closed the port
+    transport_link_reset();
+  }
+}
 
+static esp_err_t tusb_cdc_init(void) {
   ESP_LOGI(TAG, "USB initialization");
   const tinyusb_config_t tusb_cfg = TINYUSB_DEFAULT_CONFIG();
   ESP_ERROR_CHECK(tinyusb_driver_install(&tusb_cfg));
@@ -93,48 +71,49 @@ void tusb_cdc_init(void) {
                                           .callback_line_state_changed = NULL,
                                           .callback_line_coding_changed = NULL};
   ESP_ERROR_CHECK(tinyusb_cdcacm_init(&acm_data_cfg));
-  //   ESP_ERROR_CHECK(tinyusb_cdcacm_register_callback(
-  //       TUSB_CDC_DATA_ACM, CDC_EVENT_LINE_STATE_CHANGED,
-  //       &tusb_cdc_line_state_changed_callback));
+  ESP_ERROR_CHECK(tinyusb_cdcacm_register_callback(
+      TUSB_CDC_DATA_ACM, CDC_EVENT_LINE_STATE_CHANGED,
+      &tusb_cdc_line_state_changed_callback));
 
-  xTaskCreate(tusb_cdc_rx_task, "tusb_cdc_rx", 1024 * 4, NULL, 5, NULL);
+  ESP_LOGI(TAG, "USB initialization DONE");
+  return ESP_OK;
 }
 
-void tusb_cdc_rx_task(void *param) {
-  app_message_t msg;
-
-  ESP_LOGI(TAG, "USB initialization DONE");
-  while (1) {
-    if (xQueueReceive(app_queue, &msg, portMAX_DELAY)) {
-      if (msg.buf_len) {
-
-        /* Print received data*/
-        ESP_LOGI(TAG, "Data from channel %d:", msg.itf);
-
-        cJSON *json = cJSON_Parse(msg.buf);
-        if (!json) {
-          continue;
-        }
-        on_json_received(json);
-        ESP_LOGI(TAG, "Message Received");
-        cJSON_Delete(json);
-      }
-    }
-    vTaskDelay(10);
+static size_t tusb_cdc_read(uint8_t *dst, size_t len, TickType_t timeout) {
+  size_t rx_size = 0;
+  if (tinyusb_cdcacm_read(TUSB_CDC_DATA_ACM, dst, len, &rx_size) != ESP_OK) {
+    ESP_LOGE(TAG, "Read Error");
+    return 0;
   }
+  return rx_size;
 }
 
-void tusb_write(const char *msg) {
-  if (tud_cdc_n_connected(TUSB_CDC_DATA_ACM)) {
-    char data_msg[64];
-    int len = snprintf(data_msg, sizeof(data_msg), "%s\n", msg);
-    tinyusb_cdcacm_write_queue(TUSB_CDC_DATA_ACM, (uint8_t *)data_msg, len);
-    tinyusb_cdcacm_write_flush(TUSB_CDC_DATA_ACM, 0);
-  }
+static size_t tusb_cdc_write(const uint8_t *data, size_t len) {
+  return tinyusb_cdcacm_write_queue(TUSB_CDC_DATA_ACM, data, len);
 }
 
-void tusb_json_write(const cJSON *json) {
-  char *json_printed = cJSON_PrintUnformatted(json);
-  tusb_write(json_printed);
-  cJSON_free(json_printed);
-}
\ No newline at end of file
+static void tusb_cdc_flush(void) {
+  tinyusb_cdcacm_write_flush(TUSB_CDC_DATA_ACM, 0);
+}
+
+static bool tusb_cdc_connected(void) {
+  return tud_cdc_n_connected(TUSB_CDC_DATA_ACM);
+}
+
+/**
+ * @brief Data link on the second ACM of the TinyUSB composite device
+ *
+ * The first ACM carries the log console. TinyUSB calls back on every OUT
+ * packet, so no reader task is needed.
+ */
+const TransportBackend transport_tusb_cdc = {
+    .name = "TinyUSB CDC",
+    .init = tusb_cdc_init,
+    .read = tusb_cdc_read,
+    .write = tusb_cdc_write,
+    .flush = tusb_cdc_flush,
+    .connected = tusb_cdc_connected,
+    .rx_notify = true,
+};
+
+#endif // CONFIG_SCREEN_TRANSPORT_TINYUSB_CDC
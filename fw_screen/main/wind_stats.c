@@ -0,0 +1,368 @@
+#include "wind_stats.h"
+#include "snapshot.h"
+#include "transport.h"
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#if CONFIG_SCREEN_WIND_STATS
+
+#define WIND_STEP_MS 250
+#define WIND_GUST_STEPS 12 // 3 s
+#define WIND_BLOCK_MS 5000
+
+// A window is this many blocks, the newest one still filling
+#define WIND_SHORT_BLOCKS 24 // 2 minutes
+#define WIND_LONG_BLOCKS 120 // 10 minutes
+
+// Below this mean speed, m/s, the turbulence intensity is left at 0
+#define WIND_CALM 0.1f
+
+typedef struct {
+  uint32_t n;
+  float mean;
+  float m2; // sum of squared deviations from the mean
+  float min;
+  float max;
+  float gust;
+} WindBlock;
+
+/*
+ * Sequence numbers of complete blocks whose value is monotonic from the
+ * front, the oldest, to the back: the front is the extremum of the window.
+ * A block is dropped from the back as soon as a newer one beats it, so each
+ * block is pushed and popped at most once.
+ */
+typedef struct {
+  uint32_t seq[WIND_LONG_BLOCKS];
+  uint8_t head;
+  uint8_t count;
+} WindDeque;
+
+typedef struct {
+  uint32_t blocks; // including the one filling
+  uint32_t n;      // Chan merge of the complete blocks
+  float mean;
+  float m2;
+  WindDeque min;
+  WindDeque max;
+  WindDeque gust;
+} WindAggregate;
+
+static WindBlock blocks[WIND_LONG_BLOCKS]; // by sequence number
+static uint32_t block_seq;                 // the block filling
+static uint64_t block_end;                 // ms
+static bool started;
+
+static float step_sum;
+static uint32_t step_n;
+static uint64_t step_end; // ms
+
+// Sums of the last WIND_GUST_STEPS steps, oldest at gust_head
+static float gust_sum[WIND_GUST_STEPS];
+static uint32_t gust_n[WIND_GUST_STEPS];
+static uint8_t gust_head;
+static uint8_t gust_steps; // since the start, up to WIND_GUST_STEPS
+static float gust_total;
+static uint32_t gust_total_n;
+
+static WindAggregate short_window = {.blocks = WIND_SHORT_BLOCKS};
+static WindAggregate long_window = {.blocks = WIND_LONG_BLOCKS};
+
+static WindStats stats_storage[3];
+static Snapshot stats_snapshot = SNAPSHOT_INIT(stats_storage);
+
+static WindBlock *block_at(uint32_t seq) {
+  return &blocks[seq % WIND_LONG_BLOCKS];
+}
+
+static void block_reset(WindBlock *block) {
+  *block = (WindBlock){.min = INFINITY, .max = -INFINITY, .gust = -INFINITY};
+}
+
+/**
+ * @brief Welford update with one sample
+ */
+static void block_add(WindBlock *block, float speed) {
+  float delta = speed - block->mean;
+  block->n++;
+  block->mean += delta / block->n;
+  block->m2 += delta * (speed - block->mean);
+  block->min = fminf(block->min, speed);
+  block->max = fmaxf(block->max, speed);
+}
+
+/**
+ * @brief Chan's parallel merge of the moments of b into a
+ */
+static void moments_merge(uint32_t *n, float *mean, float *m2, uint32_t b_n,
+                          float b_mean, float b_m2) {
+  if (b_n == 0) {
+    return;
+  }
+  uint32_t total = *n + b_n;
+  float delta = b_mean - *mean;
+  *mean += delta * b_n / total;
+  *m2 += b_m2 + delta * delta * ((float)*n * b_n / total);
+  *n = total;
+}
+
+static void deque_push(WindDeque *deque, uint32_t seq, size_t offset,
+                       bool greater) {
+  float value;
+  memcpy(&value, (uint8_t *)block_at(seq) + offset, sizeof(value));
+
+  while (deque->count > 0) {
+    uint32_t back = deque->seq[(deque->head + deque->count - 1) %
+                               WIND_LONG_BLOCKS];
+    float back_value;
+    memcpy(&back_value, (uint8_t *)block_at(back) + offset,
+           sizeof(back_value));
+    if (greater ? back_value > value : back_value < value) {
+      break;
+    }
+    deque->count--;
+  }
+  deque->seq[(deque->head + deque->count) % WIND_LONG_BLOCKS] = seq;
+  deque->count++;
+}
+
+static void deque_expire(WindDeque *deque, uint32_t oldest) {
+  while (deque->count > 0 && deque->seq[deque->head] < oldest) {
+    deque->head = (deque->head + 1) % WIND_LONG_BLOCKS;
+    deque->count--;
+  }
+}
+
+static float deque_front(const WindDeque *deque, size_t offset, float empty) {
+  float value = empty;
+  if (deque->count > 0) {
+    memcpy(&value, (uint8_t *)block_at(deque->seq[deque->head]) + offset,
+           sizeof(value));
+  }
+  return value;
+}
+
+/**
+ * @brief Take the block that just closed into a window
+ *
+ * The extrema slide in O(1) amortized. The moments cannot lose the oldest
+ * block without cancellation, so they are merged again from the complete
+ * blocks, at most 119 every 5 s.
+ */
+static void aggregate_close(WindAggregate *aggregate, uint32_t closed) {
+  uint32_t oldest = closed + 2 > aggregate->blocks
+                        ? closed + 2 - aggregate->blocks
+                        : 0;
+
+  if (block_at(closed)->n > 0) {
+    deque_push(&aggregate->min, closed, offsetof(WindBlock, min), false);
+    deque_push(&aggregate->max, closed, offsetof(WindBlock, max), true);
+    deque_push(&aggregate->gust, closed, offsetof(WindBlock, gust), true);
+  }
+  deque_expire(&aggregate->min, oldest);
+  deque_expire(&aggregate->max, oldest);
+  deque_expire(&aggregate->gust, oldest);
+
+  aggregate->n = 0;
+  aggregate->mean = 0;
+  aggregate->m2 = 0;
+  for (uint32_t seq = oldest; seq <= closed; seq++) {
+    const WindBlock *block = block_at(seq);
+    moments_merge(&aggregate->n, &aggregate->mean, &aggregate->m2, block->n,
+                  block->mean, block->m2);
+  }
+}
+
+/**
+ * @brief A window's statistics, its complete blocks and the one filling
+ */
+static WindWindow aggregate_window(const WindAggregate *aggregate) {
+  const WindBlock *current = block_at(block_seq);
+  uint32_t n = aggregate->n;
+  float mean = aggregate->mean;
+  float m2 = aggregate->m2;
+  moments_merge(&n, &mean, &m2, current->n, current->mean, current->m2);
+
+  WindWindow window = {
+      .samples = n,
+      .mean = mean,
+      .std = n > 1 ? sqrtf(m2 / (n - 1)) : 0,
+      .min = fminf(current->min,
+                   deque_front(&aggregate->min, offsetof(WindBlock, min),
+                               INFINITY)),
+      .max = fmaxf(current->max,
+                   deque_front(&aggregate->max, offsetof(WindBlock, max),
+                               -INFINITY)),
+      .gust = fmaxf(current->gust,
+                    deque_front(&aggregate->gust, offsetof(WindBlock, gust),
+                                -INFINITY)),
+  };
+  // Not enough data yet for a gust, or no sample at all
+  if (isinf(window.gust)) {
+    window.gust = 0;
+  }
+  if (n == 0) {
+    window.min = window.max = 0;
+  }
+  if (window.mean > WIND_CALM) {
+    window.turbulence = window.std / window.mean;
+  }
+  return window;
+}
+
+#if CONFIG_SCREEN_WIND_STATS_TX
+static void wind_window_append(char *msg, size_t size, const char *name,
+                               const WindWindow *window) {
+  size_t len = strlen(msg);
+  snprintf(msg + len, size - len,
+           ",\"%s\":{\"n\":%" PRIu32 ",\"mean\":%.3f,\"std\":%.3f,"
+           "\"min\":%.3f,\"max\":%.3f,\"gust\":%.3f,\"ti\":%.3f}",
+           name, window->samples, window->mean, window->std, window->min,
+           window->max, window->gust, window->turbulence);
+}
+
+/**
+ * @brief Send the statistics to the bridge, once per block
+ *
+ * Built with snprintf() rather than cJSON: this runs in the RX task, outside
+ * the parser's arena.
+ */
+static void wind_stats_send(const WindStats *stats) {
+  char msg[384];
+  snprintf(msg, sizeof(msg),
+           "{\"type\":\"wind_stats\",\"timestamp\":%" PRIu32
+           ",\"speed\":%.3f,\"speed_3d\":%.3f,\"direction\":%.1f",
+           stats->timestamp, stats->speed, stats->speed_3d, stats->direction);
+  wind_window_append(msg, sizeof(msg), "2m", &stats->short_window);
+  wind_window_append(msg, sizeof(msg), "10m", &stats->long_window);
+  size_t len = strlen(msg);
+  snprintf(msg + len, sizeof(msg) - len, "}");
+  transport_write(msg);
+}
+#endif
+
+static void wind_stats_publish(const AnemometerData *anm_data, bool send) {
+  WindStats stats = {
+      .timestamp = anm_data->timestamp,
+      .speed = anm_data->speed,
+      .speed_3d = anm_data->speed_3d,
+      .direction = anm_data->direction,
+      .short_window = aggregate_window(&short_window),
+      .long_window = aggregate_window(&long_window),
+  };
+  snapshot_publish(&stats_snapshot, &stats);
+#if CONFIG_SCREEN_WIND_STATS_TX
+  if (send) {
+    wind_stats_send(&stats);
+  }
+#endif
+}
+
+static void wind_stats_reset(uint64_t now) {
+  memset(gust_sum, 0, sizeof(gust_sum));
+  memset(gust_n, 0, sizeof(gust_n));
+  gust_head = 0;
+  gust_steps = 0;
+  gust_total = 0;
+  gust_total_n = 0;
+  step_sum = 0;
+  step_n = 0;
+  step_end = now - now % WIND_STEP_MS + WIND_STEP_MS;
+
+  for (size_t i = 0; i < WIND_LONG_BLOCKS; i++) {
+    block_reset(&blocks[i]);
+  }
+  block_seq = 0;
+  block_end = now - now % WIND_BLOCK_MS + WIND_BLOCK_MS;
+  short_window = (WindAggregate){.blocks = WIND_SHORT_BLOCKS};
+  long_window = (WindAggregate){.blocks = WIND_LONG_BLOCKS};
+  started = true;
+}
+
+/**
+ * @brief Move the 3 s FIFO by one step, the 3 s mean is a gust candidate
+ *
+ * A candidate needs 3 s of data since the start and a sample in the step
+ * that closed; below 4 Hz some steps stay empty and the mean is taken over
+ * the samples of the 3 s there are.
+ */
+static void step_close(void) {
+  gust_total += step_sum - gust_sum[gust_head];
+  gust_total_n += step_n - gust_n[gust_head];
+  gust_sum[gust_head] = step_sum;
+  gust_n[gust_head] = step_n;
+  gust_head = (gust_head + 1) % WIND_GUST_STEPS;
+  if (gust_steps < WIND_GUST_STEPS) {
+    gust_steps++;
+  }
+
+  if (gust_steps == WIND_GUST_STEPS && step_n > 0) {
+    WindBlock *block = block_at(block_seq);
+    block->gust = fmaxf(block->gust, gust_total / gust_total_n);
+  }
+
+  step_sum = 0;
+  step_n = 0;
+  step_end += WIND_STEP_MS;
+}
+
+static void block_close(void) {
+  aggregate_close(&short_window, block_seq);
+  aggregate_close(&long_window, block_seq);
+  block_seq++;
+  block_reset(block_at(block_seq));
+  block_end += WIND_BLOCK_MS;
+}
+
+/**
+ * @brief Add an anemometer sample, RX task only
+ *
+ * Publishes the statistics whenever a 250 ms step closes. A sample older
+ * than the previous one is taken as simultaneous with it; after a gap longer
+ * than the long window everything starts over.
+ */
+void wind_stats_add(const AnemometerData *anm_data) {
+  static uint64_t last;
+  uint64_t now = (uint64_t)anm_data->timestamp * 1000 + anm_data->timestamp_ms;
+  float speed = anm_data->speed;
+
+  if (!started || now >= last + (uint64_t)WIND_LONG_BLOCKS * WIND_BLOCK_MS) {
+    wind_stats_reset(now);
+  } else if (now < last) {
+    now = last;
+  }
+  last = now;
+
+  // Steps are aligned on blocks, the step ending at block_end is the last
+  bool stepped = false;
+  bool blocked = false;
+  while (now >= step_end) {
+    step_close();
+    stepped = true;
+    if (step_end > block_end) {
+      block_close();
+      blocked = true;
+    }
+  }
+
+  block_add(block_at(block_seq), speed);
+  step_sum += speed;
+  step_n++;
+
+  if (stepped) {
+    wind_stats_publish(anm_data, blocked);
+  }
+}
+
+/**
+ * @brief Latest statistics, LVGL task only
+ *
+ * @return true if they changed since the previous call
+ */
+bool wind_stats_latest(const WindStats **stats) {
+  return snapshot_read(&stats_snapshot, (const void **)stats);
+}
+
+#endif
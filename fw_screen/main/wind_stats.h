@@ -0,0 +1,55 @@
+#pragma once
+
+#include "data.h"
+#include "sdkconfig.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @brief Rolling wind statistics over 2 and 10 minutes.
+ *
+ * Fed with every anemometer sample by the RX task, after wind_vector_compute().
+ * The horizontal wind speed goes into 5 s blocks, each a Welford accumulator
+ * (count, mean, sum of squared deviations) with its extrema; when a block
+ * closes, the blocks of each window are combined with Chan's formula and
+ * monotonic deques slide the window min, max and gust over the block extrema.
+ * The 3 s gust is the running mean of the last 12 steps of 250 ms, a FIFO of
+ * step sums, evaluated as each step closes; a block keeps the highest one.
+ * Every sample costs O(1) and the memory is fixed, whatever the sample rate.
+ *
+ * Time comes from the sample timestamps. A window covers its complete blocks
+ * plus the block being filled, so it slides in 5 s steps.
+ *
+ * Without CONFIG_SCREEN_WIND_STATS every call is a no-op that finds nothing.
+ */
+
+typedef struct WindWindow {
+  uint32_t samples;
+  float mean; // horizontal speed, m/s
+  float std;  // sample standard deviation
+  float min;
+  float max;
+  float gust;       // highest 3 s mean
+  float turbulence; // intensity, std / mean; 0 in calm air
+} WindWindow;
+
+typedef struct WindStats {
+  uint32_t timestamp;      // of the last sample, seconds since the epoch
+  float speed;             // wind vector of the last sample
+  float speed_3d;
+  float direction;
+  WindWindow short_window; // 2 minutes
+  WindWindow long_window;  // 10 minutes
+} WindStats;
+
+#if CONFIG_SCREEN_WIND_STATS
+
+void wind_stats_add(const AnemometerData *anm_data);
+bool wind_stats_latest(const WindStats **stats);
+
+#else
+
+static inline void wind_stats_add(const AnemometerData *anm_data) {}
+static inline bool wind_stats_latest(const WindStats **stats) { return false; }
+
+#endif
@@ -0,0 +1,67 @@
+#include "wind_vector.h"
+#include "sdkconfig.h"
+#include <math.h>
+
+#if CONFIG_SCREEN_WIND_VECTOR_DSP
+#include "dsps_add.h"
+#include "dsps_mul.h"
+#endif
+
+#define RAD_TO_DEG (180.0f / (float)M_PI)
+
+// The kernels index the members of consecutive samples as a float array
+#define WIND_VECTOR_STRIDE (sizeof(AnemometerData) / sizeof(float))
+_Static_assert(sizeof(AnemometerData) % sizeof(float) == 0,
+               "AnemometerData is not a whole number of floats");
+
+static float wind_direction(float x, float y) {
+  if (x == 0 && y == 0) {
+    return 0;
+  }
+  float direction = atan2f(-x, -y) * RAD_TO_DEG;
+  // + 0 turns the -0 of a wind from due north into 0
+  return direction < 0 ? direction + 360 : direction + 0.0f;
+}
+
+#if CONFIG_SCREEN_WIND_VECTOR_DSP
+
+/**
+ * @brief Squared norms with esp-dsp, then the roots and angles
+ *
+ * speed_3d holds y^2 and then z^2 as scratch before the sum.
+ */
+void wind_vector_compute(AnemometerData *samples, size_t count) {
+  const int step = WIND_VECTOR_STRIDE;
+  float *x = &samples->x_vout;
+  float *y = &samples->y_vout;
+  float *z = &samples->z_vout;
+  float *speed = &samples->speed;
+  float *speed_3d = &samples->speed_3d;
+
+  dsps_mul_f32(x, x, speed, count, step, step, step);
+  dsps_mul_f32(y, y, speed_3d, count, step, step, step);
+  dsps_add_f32(speed, speed_3d, speed, count, step, step, step);
+  dsps_mul_f32(z, z, speed_3d, count, step, step, step);
+  dsps_add_f32(speed, speed_3d, speed_3d, count, step, step, step);
+
+  for (size_t i = 0; i < count; i++) {
+    AnemometerData *s = &samples[i];
+    s->speed = sqrtf(s->speed);
+    s->speed_3d = sqrtf(s->speed_3d);
+    s->direction = wind_direction(s->x_vout, s->y_vout);
+  }
+}
+
+#else
+
+void wind_vector_compute(AnemometerData *samples, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    AnemometerData *s = &samples[i];
+    float horizontal = s->x_vout * s->x_vout + s->y_vout * s->y_vout;
+    s->speed = sqrtf(horizontal);
+    s->speed_3d = sqrtf(horizontal + s->z_vout * s->z_vout);
+    s->direction = wind_direction(s->x_vout, s->y_vout);
+  }
+}
+
+#endif
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "data.h"
+#include <stddef.h>
+
+/**
+ * @brief Wind vector of anemometer samples, derived at ingest.
+ *
+ * Fills speed, speed_3d and direction from the x, y and z components of a
+ * run of samples, in single precision, in place. With
+ * CONFIG_SCREEN_WIND_VECTOR_DSP the squares and sums go through the esp-dsp
+ * vector routines, which stride over the AnemometerData array without a
+ * gather; the ESP32-S3 vector unit has no float lanes, so these are the
+ * esp-dsp FPU loops. Otherwise, and on the host, a plain C loop does the
+ * same.
+ *
+ * The direction is where the wind blows from, in degrees clockwise from the
+ * Y axis taken as north, X pointing east; 0 in calm air.
+ */
+
+// Samples of a batch processed at once, bounded by the RX task stack
+#define WIND_VECTOR_CHUNK 16
+
+void wind_vector_compute(AnemometerData *samples, size_t count);
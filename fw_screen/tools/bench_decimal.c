@@ -0,0 +1,138 @@
+/*
+ * Host benchmark for main/decimal.c
+ *
+ * Checks decimal_parse() / decimal_parse_float() against strtod() / strtof()
+ * and decimal_format_float() against snprintf("%.*f") on numbers shaped like
+ * the bridge's, then times both sides.
+ *
+ *   gcc -O2 -I../main -o bench_decimal bench_decimal.c ../main/decimal.c -lm
+ *   ./bench_decimal
+ *
+ * Host timings only show the relative cost; on the ESP32-S3 the gap is wider
+ * because every double operation in strtod/printf is a software call.
+ */
+#include "decimal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define SAMPLES 4096
+#define ROUNDS 200
+
+static char numbers[SAMPLES][32];
+static float values[SAMPLES];
+static volatile double sink;
+
+static double now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void make_samples(void) {
+  static const char *fixed[] = {
+      "0",      "-0",        "0.0124",          "-0.0421",   "20.2112",
+      "7.944",  "59.98",     "1763924107.7981", "0.443",     "1e3",
+      "2.5E-3", "123456789", "0.000001",        "-999.999999",
+  };
+  size_t n = sizeof(fixed) / sizeof(fixed[0]);
+
+  srand(1);
+  for (int i = 0; i < SAMPLES; i++) {
+    if ((size_t)i < n) {
+      strcpy(numbers[i], fixed[i]);
+    } else {
+      int frac = rand() % 7;
+      double value = (rand() - RAND_MAX / 2) / 1000.0;
+      snprintf(numbers[i], sizeof(numbers[i]), "%.*f", frac, value);
+    }
+    values[i] = strtof(numbers[i], NULL);
+  }
+}
+
+static int check(void) {
+  int errors = 0;
+  char expected[64];
+  char actual[64];
+
+  for (int i = 0; i < SAMPLES; i++) {
+    size_t len = strlen(numbers[i]);
+    double d = 0;
+    float f = 0;
+    if (!decimal_parse(numbers[i], len, &d) || d != strtod(numbers[i], NULL)) {
+      printf("parse mismatch: %s -> %.17g\n", numbers[i], d);
+      errors++;
+    }
+    if (!decimal_parse_float(numbers[i], len, &f) || f != values[i]) {
+      printf("parse_float mismatch: %s -> %.9g\n", numbers[i], f);
+      errors++;
+    }
+
+    for (int frac = 0; frac <= DECIMAL_MAX_FRAC; frac++) {
+      snprintf(expected, sizeof(expected), "%.*f", frac, values[i]);
+      decimal_format_float(actual, sizeof(actual), values[i], frac);
+      if (strcmp(expected, actual) != 0) {
+        printf("format mismatch: %.9g %%.%df -> %s, printf %s\n", values[i],
+               frac, actual, expected);
+        errors++;
+      }
+    }
+  }
+  return errors;
+}
+
+int main(void) {
+  char buffer[64];
+  double start;
+  double total;
+
+  make_samples();
+  int errors = check();
+
+  start = now_ns();
+  total = 0;
+  for (int r = 0; r < ROUNDS; r++) {
+    for (int i = 0; i < SAMPLES; i++) {
+      total += strtod(numbers[i], NULL);
+    }
+  }
+  double strtod_ns = (now_ns() - start) / (ROUNDS * SAMPLES);
+  sink = total;
+
+  start = now_ns();
+  total = 0;
+  for (int r = 0; r < ROUNDS; r++) {
+    for (int i = 0; i < SAMPLES; i++) {
+      double value;
+      decimal_parse(numbers[i], strlen(numbers[i]), &value);
+      total += value;
+    }
+  }
+  double parse_ns = (now_ns() - start) / (ROUNDS * SAMPLES);
+  sink = total;
+
+  start = now_ns();
+  for (int r = 0; r < ROUNDS; r++) {
+    for (int i = 0; i < SAMPLES; i++) {
+      snprintf(buffer, sizeof(buffer), "%.3f", values[i]);
+    }
+  }
+  double snprintf_ns = (now_ns() - start) / (ROUNDS * SAMPLES);
+
+  start = now_ns();
+  for (int r = 0; r < ROUNDS; r++) {
+    for (int i = 0; i < SAMPLES; i++) {
+      decimal_format_float(buffer, sizeof(buffer), values[i], 3);
+    }
+  }
+  double format_ns = (now_ns() - start) / (ROUNDS * SAMPLES);
+  sink = buffer[0];
+
+  printf("parse:  strtod %6.1f ns  decimal_parse        %6.1f ns\n", strtod_ns,
+         parse_ns);
+  printf("format: snprintf %4.1f ns  decimal_format_float %6.1f ns\n",
+         snprintf_ns, format_ns);
+  printf("%d mismatches\n", errors);
+  return errors != 0;
+}
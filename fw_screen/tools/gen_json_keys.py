@@ -0,0 +1,148 @@
+#!/usr/bin/env python3
+"""Generate main/json_keys.h and main/json_keys.c.
+
+Every JSON key, topic and device name the firmware understands gets a
+JsonKey value and a slot in a minimal perfect hash (hash and displace): one
+FNV-1a pass picks a bucket, a second pass seeded with the bucket's
+displacement picks the slot, and a single memcmp verifies it.
+
+Add new names to KEYS and run this script again.
+"""
+
+import os
+import re
+
+KEYS = [
+    # topics
+    "anm", "sps", "imu", "status", "hello", "log_export",
+    # IMU devices
+    "acctop", "acc", "mag", "gyr",
+    # message fields
+    "topic", "type", "msg", "timestamp", "sensor_data",
+    # anemometer
+    "x_vout", "y_vout", "z_vout",
+    "autocalibrazione_asse_x", "autocalibrazione_asse_y",
+    "autocalibrazione_asse_z",
+    "autocalibrazione_misura_x", "autocalibrazione_misura_y",
+    "autocalibrazione_misura_z",
+    "temp_sonica_x", "temp_sonica_y", "temp_sonica_z",
+    # SPS30
+    "mass_density", "particle_count", "particle_size",
+    "mass_density_unit", "particle_count_unit", "particle_size_unit",
+    "pm0.5", "pm1.0", "pm2.5", "pm4.0", "pm10",
+    # IMU
+    "dev", "unit", "x", "y", "z",
+]
+
+MAIN = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "main")
+
+
+def fnv1a(key: bytes, seed: int) -> int:
+    h = (2166136261 ^ seed) & 0xFFFFFFFF
+    for c in key:
+        h ^= c
+        h = (h * 16777619) & 0xFFFFFFFF
+    return h
+
+
+def build(keys):
+    n = len(keys)
+    buckets_count = (n + 1) // 2
+    buckets = [[] for _ in range(buckets_count)]
+    for key in keys:
+        buckets[fnv1a(key.encode(), 0) % buckets_count].append(key)
+
+    slots = [None] * n
+    displacement = [0] * buckets_count
+    for index in sorted(range(buckets_count), key=lambda b: -len(buckets[b])):
+        bucket = buckets[index]
+        if not bucket:
+            continue
+        for seed in range(1, 65536):
+            taken = [fnv1a(key.encode(), seed) % n for key in bucket]
+            if len(set(taken)) == len(taken) and all(slots[t] is None for t in taken):
+                for key, t in zip(bucket, taken):
+                    slots[t] = key
+                displacement[index] = seed
+                break
+        else:
+            raise SystemExit("no displacement found for bucket %d" % index)
+    return displacement, slots
+
+
+def enum_name(key: str) -> str:
+    return "JSON_KEY_" + re.sub(r"[^A-Za-z0-9]", "_", key).upper()
+
+
+def main():
+    assert len(set(KEYS)) == len(KEYS), "duplicate key"
+    displacement, slots = build(KEYS)
+    header = "// Generated by tools/gen_json_keys.py, do not edit.\n"
+
+    with open(os.path.join(MAIN, "json_keys.h"), "w") as f:
+        f.write(header)
+        f.write("#pragma once\n\n#include <stddef.h>\n\n")
+        f.write("typedef enum {\n  JSON_KEY_NONE,\n")
+        for key in KEYS:
+            f.write("  %s, // \"%s\"\n" % (enum_name(key), key))
+        f.write("  JSON_KEY_COUNT,\n} JsonKey;\n\n")
+        f.write("JsonKey json_key_lookup(const char *key, size_t len);\n")
+        f.write("const char *json_key_name(JsonKey key);\n")
+
+    with open(os.path.join(MAIN, "json_keys.c"), "w") as f:
+        f.write(header)
+        f.write('#include "json_keys.h"\n#include <stdint.h>\n#include <string.h>\n\n')
+        f.write("#define JSON_KEY_BUCKETS %d\n\n" % len(displacement))
+        f.write("static const uint16_t displacement[JSON_KEY_BUCKETS] = {\n")
+        for i in range(0, len(displacement), 8):
+            f.write("    " + ", ".join("%d" % d for d in displacement[i:i + 8]) + ",\n")
+        f.write("};\n\n")
+        f.write("static const JsonKey slots[JSON_KEY_COUNT - 1] = {\n")
+        for key in slots:
+            f.write("    %s,\n" % enum_name(key))
+        f.write("};\n\n")
+        f.write("static const char *const names[JSON_KEY_COUNT] = {\n    \"\",\n")
+        for key in KEYS:
+            f.write("    \"%s\",\n" % key)
+        f.write("};\n\n")
+        f.write(LOOKUP)
+
+
+LOOKUP = """static uint32_t json_key_hash(const char *key, size_t len, uint32_t seed) {
+  uint32_t h = 2166136261u ^ seed;
+  for (size_t i = 0; i < len; i++) {
+    h ^= (uint8_t)key[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+/**
+ * @brief Map a key to its JsonKey with one hash, one displacement and one
+ *        verify
+ *
+ * @param[in] key Key bytes, not NUL-terminated
+ * @param[in] len Key length
+ *
+ * @return JSON_KEY_NONE for keys the firmware does not know
+ */
+JsonKey json_key_lookup(const char *key, size_t len) {
+  uint32_t bucket = json_key_hash(key, len, 0) % JSON_KEY_BUCKETS;
+  uint32_t slot =
+      json_key_hash(key, len, displacement[bucket]) % (JSON_KEY_COUNT - 1);
+
+  JsonKey found = slots[slot];
+  const char *name = names[found];
+  if (strncmp(name, key, len) != 0 || name[len] != '\\0') {
+    return JSON_KEY_NONE;
+  }
+  return found;
+}
+
+const char *json_key_name(JsonKey key) {
+  return key < JSON_KEY_COUNT ? names[key] : "";
+}
+"""
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,144 @@
+#!/usr/bin/env python3
+"""Export the sample log of the screen to CSV files.
+
+Stop the bridge first, then run against the data port of the screen:
+
+    tools/log_export.py /dev/ttyACM1 --from 1700000000 --to 1700086400 out
+
+It sends a log_export command, reads the stream described in
+main/sample_log.h and writes out_anm.csv, out_sps.csv and out_imu.csv, one
+row per record. Only the standard library is needed; the port is put in raw
+mode with termios.
+"""
+
+import argparse
+import csv
+import json
+import os
+import struct
+import termios
+import tty
+
+CRC_INIT = 0xFFFF
+
+
+def crc16_ccitt(data: bytes) -> int:
+    crc = CRC_INIT
+    for c in data:
+        crc ^= c << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+            crc &= 0xFFFF
+    return crc
+
+
+def decode_anm(p):
+    ts, ms, flags, *v = struct.unpack("<IHB6h", p)
+    return [ts, ms, flags] + [x / 100 for x in v]
+
+
+def decode_sps(p):
+    ts, ms, *rest = struct.unpack("<IH3B10f", p)
+    return [ts, ms] + rest
+
+
+def decode_imu(p):
+    ts, ms, *rest = struct.unpack("<IH4B12f", p)
+    return [ts, ms] + rest
+
+
+TYPES = {
+    0x01: ("anm", decode_anm,
+           ["ts", "ts_ms", "flags", "x_vout", "y_vout", "z_vout",
+            "temp_sonica_x", "temp_sonica_y", "temp_sonica_z"]),
+    0x02: ("sps", decode_sps,
+           ["ts", "ts_ms", "mass_density_unit", "particle_count_unit",
+            "particle_size_unit", "pm1.0", "pm2.5", "pm4.0", "pm10",
+            "count_pm0.5", "count_pm1.0", "count_pm2.5", "count_pm4.0",
+            "count_pm10", "particle_size"]),
+    0x03: ("imu", decode_imu,
+           ["ts", "ts_ms", "acctop_unit", "acc_unit", "mag_unit", "gyr_unit"]
+           + [dev + "_" + axis for dev in ("acctop", "acc", "mag", "gyr")
+              for axis in "xyz"]),
+}
+
+
+class Port:
+    def __init__(self, path):
+        self.fd = os.open(path, os.O_RDWR | os.O_NOCTTY)
+        tty.setraw(self.fd)
+        self.buf = b""
+
+    def write(self, data):
+        os.write(self.fd, data)
+
+    def read(self, n):
+        while len(self.buf) < n:
+            self.buf += os.read(self.fd, 65536)
+        data, self.buf = self.buf[:n], self.buf[n:]
+        return data
+
+    def readline(self):
+        while b"\n" not in self.buf:
+            self.buf += os.read(self.fd, 65536)
+        line, self.buf = self.buf.split(b"\n", 1)
+        return line
+
+    def close(self):
+        termios.tcflush(self.fd, termios.TCIOFLUSH)
+        os.close(self.fd)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("port")
+    parser.add_argument("prefix", help="output files are PREFIX_<topic>.csv")
+    parser.add_argument("--from", dest="start", type=int, default=0)
+    parser.add_argument("--to", dest="end", type=int, default=0xFFFFFFFF)
+    args = parser.parse_args()
+
+    port = Port(args.port)
+    port.write(json.dumps({"topic": "log_export", "from": args.start,
+                           "to": args.end}).encode() + b"\n")
+
+    # Skip whatever the screen was sending until the export starts
+    while True:
+        line = port.readline()
+        if line.startswith(b"{") and json.loads(line).get("type") == "log_export":
+            break
+
+    files = {}
+    writers = {}
+    records = 0
+    while True:
+        (length,) = struct.unpack("<H", port.read(2))
+        if length == 0:
+            break
+        chunk = port.read(length)
+        offset = 0
+        while offset < length:
+            rtype, plen = chunk[offset], chunk[offset + 1]
+            end = offset + 2 + plen
+            (crc,) = struct.unpack_from("<H", chunk, end)
+            if crc != crc16_ccitt(chunk[offset:end]) or rtype not in TYPES:
+                raise SystemExit("corrupt record at byte %d" % offset)
+            name, decode, header = TYPES[rtype]
+            if name not in writers:
+                files[name] = open("%s_%s.csv" % (args.prefix, name), "w",
+                                   newline="")
+                writers[name] = csv.writer(files[name])
+                writers[name].writerow(header)
+            writers[name].writerow(decode(chunk[offset + 2:end]))
+            records += 1
+            offset = end + 2
+
+    summary = json.loads(port.readline())
+    port.close()
+    for f in files.values():
+        f.close()
+    print("%d records%s" % (records,
+                            "" if summary.get("complete") else ", incomplete"))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,87 @@
+//! Per-topic sample batching for the binary link.
+
+use crate::protocol;
+use std::collections::HashMap;
+use tokio::time::{Duration, Instant};
+
+/// A batch frame ready to be sent.
+pub struct Batch {
+    pub kind: u8,
+    pub count: usize,
+    pub frame: Vec<u8>,
+}
+
+struct Pending {
+    samples: Vec<u8>,
+    count: usize,
+    since: Instant,
+}
+
+/// Collects samples of the same frame type for up to `window`, then sends
+/// them as a single batch frame.
+pub struct Batcher {
+    window: Duration,
+    pending: HashMap<u8, Pending>,
+}
+
+impl Batcher {
+    pub fn new(window: Duration) -> Self {
+        Batcher {
+            window,
+            pending: HashMap::new(),
+        }
+    }
+
+    pub fn enabled(&self) -> bool {
+        !self.window.is_zero()
+    }
+
+    /// Add a sample, returns the batch frame when it is full.
+    pub fn push(&mut self, kind: u8, payload: &[u8], max_samples: usize) -> Option<Batch> {
+        let pending = self.pending.entry(kind).or_insert_with(|| Pending {
+            samples: Vec::new(),
+            count: 0,
+            since: Instant::now(),
+        });
+        pending.samples.extend_from_slice(payload);
+        pending.count += 1;
+
+        if pending.count >= max_samples {
+            self.take(kind)
+        } else {
+            None
+        }
+    }
+
+    /// When the oldest pending batch has to be sent.
+    pub fn next_deadline(&self) -> Option<Instant> {
+        self.pending.values().map(|p| p.since + self.window).min()
+    }
+
+    /// Batch frames whose window is over.
+    pub fn flush_due(&mut self, now: Instant) -> Vec<Batch> {
+        let due: Vec<u8> = self
+            .pending
+            .iter()
+            .filter(|(_, p)| now >= p.since + self.window)
+            .map(|(kind, _)| *kind)
+            .collect();
+        due.into_iter().filter_map(|kind| self.take(kind)).collect()
+    }
+
+    /// Forget every pending sample, returns how many were dropped.
+    pub fn clear(&mut self) -> usize {
+        let dropped = self.pending.values().map(|p| p.count).sum();
+        self.pending.clear();
+        dropped
+    }
+
+    fn take(&mut self, kind: u8) -> Option<Batch> {
+        let pending = self.pending.remove(&kind)?;
+        Some(Batch {
+            kind,
+            count: pending.count,
+            frame: protocol::batch_frame(kind, pending.count as u8, &pending.samples),
+        })
+    }
+}
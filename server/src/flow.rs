@@ -0,0 +1,136 @@
+//! Credit based flow control towards the screen.
+//!
+//! The screen reports how many bytes it has consumed since the hello and how
+//! many it can buffer (`window`). The writer never has more than `window`
+//! bytes in flight; while it is out of credit, messages wait in an [`Outbox`]
+//! where newer sensor samples replace older ones of the same kind.
+
+use std::collections::VecDeque;
+use std::sync::atomic::{AtomicU32, Ordering};
+use tokio::sync::Notify;
+
+/// Entries kept while out of credit, on top of one per sensor kind.
+const OUTBOX_LIMIT: usize = 32;
+
+#[derive(Default)]
+pub struct Credit {
+    sent: AtomicU32,
+    consumed: AtomicU32,
+    window: AtomicU32,
+    notify: Notify,
+}
+
+impl Credit {
+    /// New connection: nothing in flight and no limit until the hello reply.
+    pub fn reset(&self) {
+        self.sent.store(0, Ordering::Relaxed);
+        self.consumed.store(0, Ordering::Relaxed);
+        self.window.store(0, Ordering::Relaxed);
+        self.notify.notify_one();
+    }
+
+    pub fn set_window(&self, window: u32) {
+        self.window.store(window, Ordering::Relaxed);
+        self.notify.notify_one();
+    }
+
+    pub fn on_sent(&self, len: usize) {
+        self.sent.fetch_add(len as u32, Ordering::Relaxed);
+    }
+
+    pub fn on_report(&self, consumed: u32) {
+        self.consumed.store(consumed, Ordering::Relaxed);
+        self.notify.notify_one();
+    }
+
+    /// Whether `len` more bytes can be sent now. Counters wrap like the
+    /// screen's, and a frame larger than the window goes out once the link
+    /// is idle.
+    pub fn allows(&self, len: usize) -> bool {
+        let window = self.window.load(Ordering::Relaxed) as usize;
+        if window == 0 {
+            return true;
+        }
+        let in_flight = self
+            .sent
+            .load(Ordering::Relaxed)
+            .wrapping_sub(self.consumed.load(Ordering::Relaxed)) as usize;
+        in_flight == 0 || in_flight + len <= window
+    }
+
+    pub async fn changed(&self) {
+        self.notify.notified().await
+    }
+}
+
+struct Outgoing {
+    kind: Option<u8>,
+    samples: usize,
+    bytes: Vec<u8>,
+}
+
+/// Encoded messages waiting for credit.
+#[derive(Default)]
+pub struct Outbox {
+    queue: VecDeque<Outgoing>,
+    dropped: u64,
+    dropped_samples: u64,
+}
+
+impl Outbox {
+    /// Queue `bytes` carrying `samples` samples of sensor `kind`. A pending
+    /// entry of the same kind is superseded in place; other messages are kept
+    /// in order up to a bound, oldest dropped first.
+    pub fn push(&mut self, kind: Option<u8>, samples: usize, bytes: Vec<u8>) {
+        if let Some(kind) = kind {
+            if let Some(pending) = self.queue.iter_mut().find(|o| o.kind == Some(kind)) {
+                self.dropped += 1;
+                self.dropped_samples += pending.samples as u64;
+                pending.samples = samples;
+                pending.bytes = bytes;
+                return;
+            }
+        }
+
+        self.queue.push_back(Outgoing {
+            kind,
+            samples,
+            bytes,
+        });
+        if self.queue.len() > OUTBOX_LIMIT {
+            if let Some(oldest) = self.queue.pop_front() {
+                self.dropped += 1;
+                self.dropped_samples += oldest.samples as u64;
+            }
+        }
+    }
+
+    pub fn front_len(&self) -> Option<usize> {
+        self.queue.front().map(|o| o.bytes.len())
+    }
+
+    pub fn pop(&mut self) -> Option<Vec<u8>> {
+        self.queue.pop_front().map(|o| o.bytes)
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.queue.is_empty()
+    }
+
+    /// Forget everything pending, counting it as dropped.
+    pub fn clear(&mut self) {
+        self.dropped += self.queue.len() as u64;
+        self.dropped_samples += self.queue.iter().map(|o| o.samples as u64).sum::<u64>();
+        self.queue.clear();
+    }
+
+    /// Messages dropped so far, sample or not; a batch counts once.
+    pub fn dropped(&self) -> u64 {
+        self.dropped
+    }
+
+    /// Samples carried by the dropped messages, one per non-sample message.
+    pub fn dropped_samples(&self) -> u64 {
+        self.dropped_samples
+    }
+}
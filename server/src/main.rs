@@ -1,11 +1,18 @@
+mod batch;
+mod flow;
+mod protocol;
+
+use batch::Batcher;
 use clap::Parser;
+use flow::{Credit, Outbox};
+use protocol::{Link, LinkFormat};
 use rumqttc::{AsyncClient, Event, EventLoop, MqttOptions, Packet, QoS, SubscribeFilter};
 use serde_json::json;
 use std::sync::Arc;
 use std::time::{Duration, Instant};
 use tokio::sync::mpsc::{self, Sender};
 use tokio::sync::{Mutex, watch};
-use tokio::time::sleep;
+use tokio::time::{sleep, sleep_until};
 use tokio_serial::SerialPort;
 
 #[derive(Parser, Debug)]
@@ -54,6 +61,20 @@ struct Args {
     #[arg(long, default_value_t = false)]
     swap_mean: bool,
 
+    #[arg(
+        long,
+        default_value_t = false,
+        help = "Do not offer the binary frame format to the screen."
+    )]
+    nobinary: bool,
+
+    #[arg(
+        long,
+        default_value_t = 0,
+        help = "Batch sensor samples on the binary link for up to this many ms (0 = off)."
+    )]
+    batch_window_ms: u64,
+
     #[arg(long, default_value_t = String::from("anemometer"),)]
     topic_vento: String,
 }
@@ -100,12 +121,15 @@ async fn main() {
     );
     println!("FLAG nopingpong: {}", args.nopingpong);
     println!("FLAG swap_mean: {}", args.swap_mean);
+    println!("FLAG nobinary: {}", args.nobinary);
+    println!("Batch window: {} ms", args.batch_window_ms);
     println!("Send Data to screen: {}", !args.nodata);
     println!("Topic Vento: {}", args.topic_vento);
 
     let (mqtt_watch_channel_tx, mqtt_watch_channel_rx) = watch::channel(false);
     let (serial_watch_channel_tx, serial_watch_channel_rx) = watch::channel(false);
-    let (mqtt_serial_queue_tx, mqtt_serial_queue_rx) = mpsc::channel::<String>(100);
+    let (link_format_tx, link_format_rx) = watch::channel(Link::default());
+    let (mqtt_serial_queue_tx, mqtt_serial_queue_rx) = mpsc::channel::<serde_json::Value>(100);
     let (serial_mqtt_queue_tx, serial_mqtt_queue_rx) = mpsc::channel::<String>(100);
 
     let mut mqttoptions = MqttOptions::new(args.mqtt_id, args.mqtt_host, args.mqtt_port);
@@ -116,6 +140,7 @@ async fn main() {
     let mqtt_eventloop = Arc::new(Mutex::new(eventloop));
 
     let serial_port = Arc::new(Mutex::new(None::<Box<dyn SerialPort>>));
+    let credit = Arc::new(Credit::default());
 
     // MQTT TASK
     let mqtt_eventloop_clone = mqtt_eventloop.clone();
@@ -141,12 +166,17 @@ async fn main() {
     let serial_port_clone: Arc<Mutex<Option<Box<dyn SerialPort>>>> = serial_port.clone();
     let serial_watch_channel_tx_clone = serial_watch_channel_tx.clone();
     let serial_watch_channel_rx_clone = serial_watch_channel_rx.clone();
+    let link_format_rx_clone = link_format_rx.clone();
+    let credit_clone = credit.clone();
     let serial_writer = tokio::spawn(async move {
         serial_writer_task(
             mqtt_serial_queue_rx,
             serial_port_clone,
             serial_watch_channel_tx_clone,
             serial_watch_channel_rx_clone,
+            link_format_rx_clone,
+            credit_clone,
+            Duration::from_millis(args.batch_window_ms),
         )
         .await
     });
@@ -156,6 +186,8 @@ async fn main() {
     let serial_port_clone = serial_port.clone();
     let serial_watch_channel_tx_clone = serial_watch_channel_tx.clone();
     let serial_watch_channel_rx_clone = serial_watch_channel_rx.clone();
+    let link_format_tx_clone = link_format_tx.clone();
+    let credit_clone = credit.clone();
     let serial_reconnect = tokio::spawn(async move {
         serial_reconnect_task(
             &args.port,
@@ -163,6 +195,9 @@ async fn main() {
             serial_port_clone,
             serial_watch_channel_tx_clone,
             serial_watch_channel_rx_clone,
+            link_format_tx_clone,
+            credit_clone,
+            !args.nobinary,
             Duration::from_millis(args.serial_reconnection_delay_ms),
         )
         .await;
@@ -172,12 +207,17 @@ async fn main() {
     let serial_port_clone: Arc<Mutex<Option<Box<dyn SerialPort>>>> = serial_port.clone();
     let serial_watch_channel_tx_clone = serial_watch_channel_tx.clone();
     let serial_watch_channel_rx_clone = serial_watch_channel_rx.clone();
+    let link_format_tx_clone = link_format_tx.clone();
+    let credit_clone = credit.clone();
     let serial_listener = tokio::spawn(async move {
         serial_listener_task(
             serial_port_clone,
             serial_mqtt_queue_tx,
             serial_watch_channel_tx_clone,
             serial_watch_channel_rx_clone,
+            link_format_tx_clone,
+            credit_clone,
+            !args.nobinary,
         )
         .await;
     });
@@ -208,7 +248,7 @@ async fn main() {
 
 async fn mqtt_anemometer_topic_callback(
     json: &serde_json::Value,
-    tx: &Sender<String>,
+    tx: &Sender<serde_json::Value>,
     swap_mean: bool,
 ) {
     let mut json = json.clone();
@@ -225,36 +265,33 @@ async fn mqtt_anemometer_topic_callback(
                 obj["z_vout"] = json!(z_vout);
             }
         }
-        let pretty_json_string = serde_json::to_string(&json).unwrap();
-        if let Err(e) = tx.send(pretty_json_string).await {
+        if let Err(e) = tx.send(json).await {
             eprintln!("Failed to send message: {e}");
         }
     }
 }
 
-async fn mqtt_sps30_topic_callback(json: &serde_json::Value, tx: &Sender<String>) {
+async fn mqtt_sps30_topic_callback(json: &serde_json::Value, tx: &Sender<serde_json::Value>) {
     let mut json = json.clone();
     if let Some(obj) = json.as_object_mut() {
         obj.insert("topic".to_string(), json!("sps"));
-        let pretty_json_string = serde_json::to_string(&json).unwrap();
-        if let Err(e) = tx.send(pretty_json_string).await {
+        if let Err(e) = tx.send(json).await {
             eprintln!("Failed to send message: {e}");
         }
     }
 }
 
-async fn mqtt_imu_topic_callback(json: &serde_json::Value, tx: &Sender<String>) {
+async fn mqtt_imu_topic_callback(json: &serde_json::Value, tx: &Sender<serde_json::Value>) {
     let mut json = json.clone();
     if let Some(obj) = json.as_object_mut() {
         obj.insert("topic".to_string(), json!("imu"));
-        let pretty_json_string = serde_json::to_string(&json).unwrap();
-        if let Err(e) = tx.send(pretty_json_string).await {
+        if let Err(e) = tx.send(json).await {
             eprintln!("Failed to send message: {e}");
         }
     }
 }
 
-async fn mqtt_status_topic_callback(text: &str, tx: &Sender<String>, nopingpong: bool) {
+async fn mqtt_status_topic_callback(text: &str, tx: &Sender<serde_json::Value>, nopingpong: bool) {
     if nopingpong {
         if text == "ping" || text == "pong" {
             return;
@@ -264,16 +301,16 @@ async fn mqtt_status_topic_callback(text: &str, tx: &Sender<String>, nopingpong:
         "topic": "status",
         "msg": text,
     });
-    if let Ok(pretty_json_string) = serde_json::to_string(&json_status_msg) {
-        if let Err(e) = tx.send(pretty_json_string).await {
-            eprintln!("Failed to send message: {e}");
-        }
-    } else {
-        eprintln!("Failed to stringify the json: {json_status_msg}");
+    if let Err(e) = tx.send(json_status_msg).await {
+        eprintln!("Failed to send message: {e}");
     }
 }
 
-async fn mqtt_command_topic_callback(command_msg: &str, tx: &Sender<String>, nopingpong: bool) {
+async fn mqtt_command_topic_callback(
+    command_msg: &str,
+    tx: &Sender<serde_json::Value>,
+    nopingpong: bool,
+) {
     if nopingpong && command_msg == "ping" || command_msg == "pong" {
         return;
     }
@@ -281,50 +318,133 @@ async fn mqtt_command_topic_callback(command_msg: &str, tx: &Sender<String>, nop
         "topic": "status",
         "msg": format!("COMMAND {}",command_msg),
     });
-    if let Ok(pretty_json_string) = serde_json::to_string(&json_status_msg) {
-        if let Err(e) = tx.send(pretty_json_string.clone()).await {
-            eprintln!("Failed to send message: {e}");
-        } else {
-            println!("MESSAGE SENT: {}", pretty_json_string.clone());
-        }
+    if let Err(e) = tx.send(json_status_msg.clone()).await {
+        eprintln!("Failed to send message: {e}");
     } else {
-        eprintln!("Failed to stringify the json: {json_status_msg}");
+        println!("MESSAGE SENT: {}", json_status_msg);
     }
 }
 
 async fn serial_writer_task(
-    mut serial_queue_rx: mpsc::Receiver<String>,
+    mut serial_queue_rx: mpsc::Receiver<serde_json::Value>,
     port: Arc<Mutex<Option<Box<dyn SerialPort>>>>,
     serial_flag_tx: watch::Sender<bool>,
     serial_flag_rx: watch::Receiver<bool>,
+    link_format_rx: watch::Receiver<Link>,
+    credit: Arc<Credit>,
+    batch_window: Duration,
 ) {
     println!("[TASK] SERIAL writer: START");
 
-    while let Some(message) = serial_queue_rx.recv().await {
-        println!("Writer sending: {}", &message);
+    let mut last_format = LinkFormat::Json;
+    let mut last_link = Link::default();
+    let mut batcher = Batcher::new(batch_window);
+    let mut outbox = Outbox::default();
+    let mut dropped_reported = 0;
 
-        loop {
-            while !*serial_flag_rx.borrow() {
-                sleep(Duration::from_millis(100)).await;
+    loop {
+        let deadline = batcher.next_deadline();
+        let message = tokio::select! {
+            message = serial_queue_rx.recv() => match message {
+                Some(message) => Some(message),
+                None => break,
+            },
+            _ = sleep_until(deadline.unwrap_or_else(tokio::time::Instant::now)), if deadline.is_some() => None,
+            _ = credit.changed(), if !outbox.is_empty() => None,
+        };
+
+        let link = *link_format_rx.borrow();
+        if link != last_link {
+            // Pending data was encoded for the previous link
+            let dropped = batcher.clear();
+            outbox.clear();
+            if dropped > 0 {
+                eprintln!("[SERIAL] Link changed, dropped {} batched samples", dropped);
             }
-
-            let mut should_break = false;
-            if let Some(port) = port.lock().await.as_mut() {
-                if let Err(e) = port.write_all((message.clone() + "\n").as_bytes()) {
-                    eprintln!("[ERROR] Failed to write: {}", e);
-                    let _ = serial_flag_tx.send(false);
-                } else {
-                    if let Err(e) = port.flush() {
-                        eprintln!("[ERROR] Failed to flush: {}", e);
-                    }
-                    println!("\n[SEND] to port\n{}", message.clone());
-                    should_break = true;
+            last_link = link;
+        }
+        let batching = batcher.enabled() && link.format == LinkFormat::Binary && link.batch;
+
+        if let Some(message) = message {
+            println!("Writer sending: {}", &message);
+            match link.format {
+                LinkFormat::Json => {
+                    let mut bytes = message.to_string().into_bytes();
+                    bytes.push(b'\n');
+                    outbox.push(protocol::sample_kind(&message), 1, bytes);
                 }
+                LinkFormat::Binary => match protocol::sample(&message) {
+                    Some((kind, payload)) if batching => {
+                        let max_samples = protocol::max_batch_samples(link.frame_max, kind);
+                        if let Some(batch) = batcher.push(kind, &payload, max_samples) {
+                            outbox.push(Some(batch.kind), batch.count, batch.frame);
+                        }
+                    }
+                    _ => outbox.push(
+                        protocol::sample_kind(&message),
+                        1,
+                        protocol::encode(&message),
+                    ),
+                },
             }
+        }
+        for batch in batcher.flush_due(tokio::time::Instant::now()) {
+            outbox.push(Some(batch.kind), batch.count, batch.frame);
+        }
 
-            if should_break {
+        while let Some(len) = outbox.front_len() {
+            // Terminate any JSON line sent before the switch
+            let prefix = link.format == LinkFormat::Binary && last_format != LinkFormat::Binary;
+            if !credit.allows(len + prefix as usize) {
                 break;
             }
+
+            let mut bytes = outbox.pop().unwrap_or_default();
+            if prefix {
+                bytes.insert(0, 0);
+            }
+            last_format = link.format;
+
+            serial_write(&bytes, &port, &serial_flag_tx, &serial_flag_rx, &credit).await;
+        }
+
+        if outbox.dropped() != dropped_reported {
+            dropped_reported = outbox.dropped();
+            eprintln!(
+                "[SERIAL] Screen out of credit, {} messages ({} samples) dropped so far",
+                dropped_reported,
+                outbox.dropped_samples()
+            );
+        }
+    }
+}
+
+async fn serial_write(
+    bytes: &[u8],
+    port: &Arc<Mutex<Option<Box<dyn SerialPort>>>>,
+    serial_flag_tx: &watch::Sender<bool>,
+    serial_flag_rx: &watch::Receiver<bool>,
+    credit: &Credit,
+) {
+    loop {
+        while !*serial_flag_rx.borrow() {
+            sleep(Duration::from_millis(100)).await;
+        }
+
+        if let Some(port) = port.lock().await.as_mut() {
+            if let Err(e) = port.write_all(bytes) {
+                eprintln!("[ERROR] Failed to write: {}", e);
+                let _ = serial_flag_tx.send(false);
+            } else {
+                // Counted under the port lock, so a reconnection resets it
+                // either before or after this write
+                credit.on_sent(bytes.len());
+                if let Err(e) = port.flush() {
+                    eprintln!("[ERROR] Failed to flush: {}", e);
+                }
+                println!("\n[SEND] to port ({} bytes)", bytes.len());
+                return;
+            }
         }
     }
 }
@@ -338,8 +458,6 @@ async fn mqtt_writer_task(
     println!("[TASK] MQTT Writer: START");
 
     while let Some(json_str) = mqtt_queue_rx.recv().await {
-        let topic = "command";
-
         println!("[TASK] MQTT QUEUE -> MQTT server.");
 
         loop {
@@ -350,24 +468,13 @@ async fn mqtt_writer_task(
 
             let json_parsed = serde_json::from_str::<serde_json::Value>(&json_str);
 
-            match json_parsed {
+            let (topic, mqtt_message) = match json_parsed {
                 Ok(json_value) => {
-                    if let Some(command_value) = json_value.get("command") {
+                    if let Some(topic) = protocol::derived_topic(&json_value) {
+                        (topic, json_str.clone())
+                    } else if let Some(command_value) = json_value.get("command") {
                         if let Some(command_str) = command_value.as_str() {
-                            let mqtt_message = format!("{}", command_str);
-
-                            let mqtt_client_guard = mqtt_client.lock().await;
-
-                            if let Err(e) = mqtt_client_guard
-                                .publish(topic, QoS::AtMostOnce, false, mqtt_message.clone())
-                                .await
-                            {
-                                eprintln!("Failed to publish MQTT message: {e}");
-                                let _ = flag_tx.send(false);
-                            } else {
-                                println!("Published to MQTT: {}", mqtt_message);
-                                break;
-                            }
+                            ("command", format!("{}", command_str))
                         } else {
                             eprintln!("'command' is not a string in JSON: {}", json_str);
                             break;
@@ -381,6 +488,19 @@ async fn mqtt_writer_task(
                     eprintln!("Failed to parse JSON: {e}, input: {}", json_str);
                     break;
                 }
+            };
+
+            let mqtt_client_guard = mqtt_client.lock().await;
+
+            if let Err(e) = mqtt_client_guard
+                .publish(topic, QoS::AtMostOnce, false, mqtt_message.clone())
+                .await
+            {
+                eprintln!("Failed to publish MQTT message: {e}");
+                let _ = flag_tx.send(false);
+            } else {
+                println!("Published to MQTT: {}", mqtt_message);
+                break;
             }
         }
     }
@@ -391,9 +511,13 @@ async fn serial_listener_task(
     tx: mpsc::Sender<String>,
     serial_flag_tx: watch::Sender<bool>,
     serial_flag_rx: watch::Receiver<bool>,
+    link_format_tx: watch::Sender<Link>,
+    credit: Arc<Credit>,
+    offer_binary: bool,
 ) {
     println!("[TASK] SERIAL Listener: START");
     let mut buffer = String::new();
+    let mut last_drops = (0, 0);
 
     loop {
         // Wait until we have a connection
@@ -425,6 +549,44 @@ async fn serial_listener_task(
 
                                 match json {
                                     Ok(json_val) => {
+                                        if let Some(link) = protocol::hello_reply(&json_val) {
+                                            println!("[SERIAL] Link: {:?}", link);
+                                            credit.set_window(link.window);
+                                            let _ = link_format_tx.send(link);
+                                            last_drops = (0, 0);
+                                            continue;
+                                        }
+                                        if protocol::hello_request(&json_val) {
+                                            println!("[SERIAL] Screen asked for a new hello");
+                                            let _ = link_format_tx.send(Link::default());
+                                            let hello =
+                                                protocol::hello(offer_binary).to_string() + "\n";
+                                            let mut port_guard = serial_port.lock().await;
+                                            if let Some(port) = port_guard.as_mut() {
+                                                if let Err(e) = port.write_all(hello.as_bytes()) {
+                                                    eprintln!(
+                                                        "[ERROR] Failed to send hello: {}",
+                                                        e
+                                                    );
+                                                }
+                                                credit.reset();
+                                            }
+                                            continue;
+                                        }
+                                        if let Some(report) = protocol::credit_report(&json_val) {
+                                            credit.on_report(report.consumed);
+                                            let drops = (report.oversized, report.invalid);
+                                            if drops != last_drops {
+                                                eprintln!(
+                                                    "[SERIAL] Screen dropped frames: {} oversized, {} invalid ({} superseded by newer samples)",
+                                                    report.oversized,
+                                                    report.invalid,
+                                                    report.superseded
+                                                );
+                                                last_drops = drops;
+                                            }
+                                            continue;
+                                        }
                                         match tx.send(json_val.to_string()).await {
                                             Ok(_) => {}
                                             Err(e) => {
@@ -477,6 +639,9 @@ async fn serial_reconnect_task(
     serial_port: Arc<Mutex<Option<Box<dyn SerialPort>>>>,
     serial_flag_tx: watch::Sender<bool>,
     serial_flag_rx: watch::Receiver<bool>,
+    link_format_tx: watch::Sender<Link>,
+    credit: Arc<Credit>,
+    offer_binary: bool,
     reconnection_delay: Duration,
 ) {
     println!("[TASK] SERIAL Reconnect: START");
@@ -490,9 +655,20 @@ async fn serial_reconnect_task(
         println!("[SERIAL] 🔄 Reconnection Task: Active - attempting to connect...");
 
         match open_serial_port(serial_option_port, serial_option_baud_rate) {
-            Ok(port) => {
+            Ok(mut port) => {
                 println!("[SERIAL] Connected to port: {}", serial_option_port);
-                *serial_port.lock().await = Some(port);
+
+                // Every connection starts in JSON until the screen answers
+                let _ = link_format_tx.send(Link::default());
+                let hello = protocol::hello(offer_binary).to_string() + "\n";
+                if let Err(e) = port.write_all(hello.as_bytes()) {
+                    eprintln!("[ERROR] Failed to send hello: {}", e);
+                }
+
+                let mut port_guard = serial_port.lock().await;
+                credit.reset();
+                *port_guard = Some(port);
+                drop(port_guard);
                 let _ = serial_flag_tx.send(true);
             }
             Err(e) => {
@@ -521,7 +697,7 @@ fn open_serial_port(
 async fn mqtt_task(
     mqtt_eventloop: Arc<Mutex<EventLoop>>,
     mqtt_client: Arc<Mutex<AsyncClient>>,
-    mqtt_queue_channel_tx: &Sender<String>,
+    mqtt_queue_channel_tx: &Sender<serde_json::Value>,
     mqtt_flag_tx: watch::Sender<bool>,
     filter_duration: Duration,
     reconnection_delay: Duration,
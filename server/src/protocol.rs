@@ -0,0 +1,338 @@
+//! Binary telemetry frames for the serial link (bridge -> screen).
+//!
+//! Every frame is `version | type | payload | crc16`, COBS encoded and
+//! terminated by `0x00`. The layouts mirror `fw_screen/main/protocol.h`: all
+//! fields are little-endian and a NaN float means "field not present".
+
+use serde_json::{Value, json};
+
+pub const PROTO_VERSION: u8 = 1;
+
+pub const FRAME_ANEMOMETER: u8 = 0x01;
+pub const FRAME_PARTICULATE_MATTER: u8 = 0x02;
+pub const FRAME_IMU: u8 = 0x03;
+pub const FRAME_STATUS: u8 = 0x04;
+pub const FRAME_BATCH: u8 = 0x10;
+pub const FRAME_JSON: u8 = 0x7F;
+
+/// Keep in sync with `unit_names` in `fw_screen/main/data.c`.
+const UNITS: [&str; 11] = [
+    "", "ug/m3", "#/cm3", "um", "g", "m/s2", "uT", "dps", "rad/s", "mg", "gauss",
+];
+
+const IMU_DEVICES: [&str; 4] = ["acctop", "acc", "mag", "gyr"];
+
+#[derive(Clone, Copy, Debug, PartialEq)]
+pub enum LinkFormat {
+    Json,
+    Binary,
+}
+
+/// What the screen accepts on the current connection.
+#[derive(Clone, Copy, Debug, PartialEq)]
+pub struct Link {
+    pub format: LinkFormat,
+    pub batch: bool,
+    pub frame_max: usize,
+    /// Credit window in bytes, 0 when the screen does no flow control.
+    pub window: u32,
+}
+
+impl Default for Link {
+    fn default() -> Self {
+        Link {
+            format: LinkFormat::Json,
+            batch: false,
+            frame_max: 0,
+            window: 0,
+        }
+    }
+}
+
+/// Hello sent on every new serial connection; the screen answers with the
+/// format it picked. Old firmware does not answer and the link stays JSON.
+pub fn hello(binary: bool) -> Value {
+    let formats = if binary {
+        json!(["bin", "json"])
+    } else {
+        json!(["json"])
+    };
+    json!({
+        "topic": "hello",
+        "proto": PROTO_VERSION,
+        "formats": formats,
+    })
+}
+
+/// Whether `json` asks for a new hello. The screen sends it when it only
+/// received garbage for a while, e.g. after the bridge restarted on a link
+/// without a line state.
+pub fn hello_request(json: &Value) -> bool {
+    json.get("type").and_then(Value::as_str) == Some("hello_request")
+}
+
+/// Link picked by the screen, if `json` is its hello reply.
+pub fn hello_reply(json: &Value) -> Option<Link> {
+    if json.get("type").and_then(Value::as_str) != Some("hello") {
+        return None;
+    }
+    let format = match json.get("format").and_then(Value::as_str) {
+        Some("bin") => LinkFormat::Binary,
+        _ => LinkFormat::Json,
+    };
+    Some(Link {
+        format,
+        batch: json.get("batch").and_then(Value::as_bool).unwrap_or(false),
+        frame_max: json.get("frame_max").and_then(Value::as_u64).unwrap_or(0) as usize,
+        window: json.get("window").and_then(Value::as_u64).unwrap_or(0) as u32,
+    })
+}
+
+/// Credit report sent periodically by the screen.
+#[derive(Clone, Copy, Debug, PartialEq)]
+pub struct CreditReport {
+    pub consumed: u32,
+    pub oversized: u32,
+    pub invalid: u32,
+    pub superseded: u32,
+}
+
+pub fn credit_report(json: &Value) -> Option<CreditReport> {
+    if json.get("type").and_then(Value::as_str) != Some("credit") {
+        return None;
+    }
+    let field = |key| json.get(key).and_then(Value::as_u64).unwrap_or(0) as u32;
+    Some(CreditReport {
+        consumed: field("consumed"),
+        oversized: field("oversized"),
+        invalid: field("invalid"),
+        superseded: field("superseded"),
+    })
+}
+
+/// MQTT topic of a result computed by the screen, if `json` is one. These are
+/// published whole, unlike commands.
+pub fn derived_topic(json: &Value) -> Option<&'static str> {
+    match json.get("type").and_then(Value::as_str) {
+        Some("wind_stats") => Some("wind_stats"),
+        Some("pm_stats") => Some("pm_stats"),
+        _ => None,
+    }
+}
+
+/// CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF).
+pub fn crc16(data: &[u8]) -> u16 {
+    let mut crc: u16 = 0xFFFF;
+    for &byte in data {
+        crc ^= (byte as u16) << 8;
+        for _ in 0..8 {
+            crc = if crc & 0x8000 != 0 {
+                (crc << 1) ^ 0x1021
+            } else {
+                crc << 1
+            };
+        }
+    }
+    crc
+}
+
+pub fn cobs_encode(data: &[u8], out: &mut Vec<u8>) {
+    let mut code_pos = out.len();
+    let mut code: u8 = 1;
+    out.push(0);
+
+    for &byte in data {
+        if byte != 0 {
+            out.push(byte);
+            code += 1;
+        }
+        if byte == 0 || code == 0xFF {
+            out[code_pos] = code;
+            code_pos = out.len();
+            code = 1;
+            out.push(0);
+        }
+    }
+    out[code_pos] = code;
+}
+
+fn frame(kind: u8, payload: &[u8]) -> Vec<u8> {
+    let mut raw = Vec::with_capacity(payload.len() + 4);
+    raw.push(PROTO_VERSION);
+    raw.push(kind);
+    raw.extend_from_slice(payload);
+    let crc = crc16(&raw);
+    raw.extend_from_slice(&crc.to_le_bytes());
+
+    let mut out = Vec::with_capacity(raw.len() + raw.len() / 254 + 2);
+    cobs_encode(&raw, &mut out);
+    out.push(0);
+    out
+}
+
+fn unit_code(unit: Option<&Value>) -> u8 {
+    unit.and_then(Value::as_str)
+        .and_then(|unit| UNITS.iter().position(|u| *u == unit))
+        .unwrap_or(0) as u8
+}
+
+fn put_f32(out: &mut Vec<u8>, value: Option<&Value>) {
+    let value = value.and_then(Value::as_f64).map_or(f32::NAN, |v| v as f32);
+    out.extend_from_slice(&value.to_le_bytes());
+}
+
+fn put_timestamp(out: &mut Vec<u8>, obj: &Value) {
+    let timestamp = obj.get("timestamp").and_then(Value::as_f64).unwrap_or(0.0);
+    let seconds = timestamp.floor();
+    let millis = (((timestamp - seconds) * 1000.0) as u16).min(999);
+    out.extend_from_slice(&(seconds as u32).to_le_bytes());
+    out.extend_from_slice(&millis.to_le_bytes());
+}
+
+fn anemometer_payload(obj: &Value) -> Vec<u8> {
+    const FLAGS: [&str; 6] = [
+        "autocalibrazione_asse_x",
+        "autocalibrazione_asse_y",
+        "autocalibrazione_asse_z",
+        "autocalibrazione_misura_x",
+        "autocalibrazione_misura_y",
+        "autocalibrazione_misura_z",
+    ];
+
+    let mut out = Vec::with_capacity(32);
+    put_timestamp(&mut out, obj);
+
+    let mut flags: u16 = 0;
+    for (bit, key) in FLAGS.iter().enumerate() {
+        if let Some(value) = obj.get(*key).and_then(Value::as_bool) {
+            flags |= 1 << (bit + 8);
+            if value {
+                flags |= 1 << bit;
+            }
+        }
+    }
+    out.extend_from_slice(&flags.to_le_bytes());
+
+    for key in [
+        "x_vout",
+        "y_vout",
+        "z_vout",
+        "temp_sonica_x",
+        "temp_sonica_y",
+        "temp_sonica_z",
+    ] {
+        put_f32(&mut out, obj.get(key));
+    }
+    out
+}
+
+fn particulate_matter_payload(obj: &Value) -> Vec<u8> {
+    let sensor_data = &obj["sensor_data"];
+    let mass_density = &sensor_data["mass_density"];
+    let particle_count = &sensor_data["particle_count"];
+
+    let mut out = Vec::with_capacity(50);
+    put_timestamp(&mut out, obj);
+    out.push(unit_code(sensor_data.get("mass_density_unit")));
+    out.push(unit_code(sensor_data.get("particle_count_unit")));
+    out.push(unit_code(sensor_data.get("particle_size_unit")));
+    out.push(0);
+
+    for key in ["pm1.0", "pm2.5", "pm4.0", "pm10"] {
+        put_f32(&mut out, mass_density.get(key));
+    }
+    for key in ["pm0.5", "pm1.0", "pm2.5", "pm4.0", "pm10"] {
+        put_f32(&mut out, particle_count.get(key));
+    }
+    put_f32(&mut out, sensor_data.get("particle_size"));
+    out
+}
+
+fn imu_payload(obj: &Value) -> Vec<u8> {
+    let mut present: u8 = 0;
+    let mut units = [0u8; 4];
+    let mut values = Vec::with_capacity(48);
+
+    let sensor_data = obj.get("sensor_data").and_then(Value::as_array);
+    for (index, dev) in IMU_DEVICES.iter().enumerate() {
+        let sample = sensor_data.and_then(|samples| {
+            samples
+                .iter()
+                .find(|s| s.get("dev").and_then(Value::as_str) == Some(*dev))
+        });
+        if let Some(sample) = sample {
+            present |= 1 << index;
+            units[index] = unit_code(sample.get("unit"));
+        }
+        for axis in ["x", "y", "z"] {
+            put_f32(&mut values, sample.and_then(|s| s.get(axis)));
+        }
+    }
+
+    let mut out = Vec::with_capacity(60);
+    put_timestamp(&mut out, obj);
+    out.push(present);
+    out.push(0);
+    out.extend_from_slice(&units);
+    out.extend_from_slice(&values);
+    out
+}
+
+/// Frame type of a sensor sample, `None` for other messages.
+pub fn sample_kind(message: &Value) -> Option<u8> {
+    match message.get("topic").and_then(Value::as_str) {
+        Some("anm") => Some(FRAME_ANEMOMETER),
+        Some("sps") => Some(FRAME_PARTICULATE_MATTER),
+        Some("imu") => Some(FRAME_IMU),
+        _ => None,
+    }
+}
+
+/// Frame type and payload of a sensor sample, `None` for other messages.
+pub fn sample(message: &Value) -> Option<(u8, Vec<u8>)> {
+    let kind = sample_kind(message)?;
+    let payload = match kind {
+        FRAME_ANEMOMETER => anemometer_payload(message),
+        FRAME_PARTICULATE_MATTER => particulate_matter_payload(message),
+        _ => imu_payload(message),
+    };
+    Some((kind, payload))
+}
+
+fn sample_len(kind: u8) -> usize {
+    match kind {
+        FRAME_ANEMOMETER => 32,
+        FRAME_PARTICULATE_MATTER => 50,
+        _ => 60,
+    }
+}
+
+/// Number of `kind` samples that fit a batch frame the screen can receive.
+pub fn max_batch_samples(frame_max: usize, kind: u8) -> usize {
+    // COBS adds at most one byte every 254, plus header, batch header and CRC
+    let usable = (frame_max * 254 / 255).saturating_sub(8);
+    (usable / sample_len(kind)).clamp(1, u8::MAX as usize)
+}
+
+pub fn batch_frame(kind: u8, count: u8, samples: &[u8]) -> Vec<u8> {
+    let mut payload = Vec::with_capacity(samples.len() + 2);
+    payload.push(kind);
+    payload.push(count);
+    payload.extend_from_slice(samples);
+    frame(FRAME_BATCH, &payload)
+}
+
+/// Encode a message queued for the screen. Topics without a binary layout are
+/// carried as a JSON frame.
+pub fn encode(message: &Value) -> Vec<u8> {
+    if let Some((kind, payload)) = sample(message) {
+        return frame(kind, &payload);
+    }
+    match message.get("topic").and_then(Value::as_str) {
+        Some("status") => {
+            let text = message.get("msg").and_then(Value::as_str).unwrap_or("");
+            frame(FRAME_STATUS, text.as_bytes())
+        }
+        _ => frame(FRAME_JSON, message.to_string().as_bytes()),
+    }
+}